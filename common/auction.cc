@@ -23,6 +23,8 @@
 #include <ace/High_Res_Timer.h>
 #include <ace/Dev_Poll_Reactor.h>
 #include <set>
+#include <cstring>
+#include <sched.h>
 
 using namespace std;
 using namespace ML;
@@ -210,10 +212,27 @@ createDescription(AuctionResponseDescription & d) {
     d.addField("wcm", &Response::wcm, "");
 }
 
+namespace {
+
+/** Maps a float to an unsigned integer with the same ordering. */
+inline uint32_t orderedBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x80000000U) ? ~bits : bits | 0x80000000U;
+}
+
+const uint64_t NoWinner = ~0ULL;
+
+} // file scope
+
 Auction::
 Auction()
-    : isZombie(false), exchangeConnector(nullptr), data(new Data())
+    : isZombie(false), exchangeConnector(nullptr),
+      logState(0), logWritten(0), winnersSize(0), data(new Data())
 {
+    for (auto & chunk: logChunks)
+        chunk = nullptr;
 }
 
 Auction::
@@ -230,10 +249,18 @@ Auction(ExchangeConnector * exchangeConnector,
       requestStrFormat(requestStrFormat),
       exchangeConnector(exchangeConnector),
       handleAuction(handleAuction),
+      logState(0), logWritten(0),
+      winners(new std::atomic<uint64_t>[numSpots()]),
+      winnersSize(numSpots()),
       data(new Data(numSpots()))
 {
     ML::atomic_add(created, 1);
 
+    for (auto & chunk: logChunks)
+        chunk = nullptr;
+    for (unsigned i = 0;  i < winnersSize;  ++i)
+        winners[i] = NoWinner;
+
     this->id = request->auctionId;
     this->requestSerialized = request->serializeToString();
 }
@@ -249,6 +276,12 @@ Auction::
         d = d2;
     }
 
+    unsigned numLogged = logState & ~Closed;
+    for (unsigned i = 0;  i < numLogged;  ++i)
+        logEntry(i)->~LogEntry();
+    for (auto & chunk: logChunks)
+        ::operator delete(chunk.load());
+
     ML::atomic_add(destroyed, 1);
 }
 
@@ -269,13 +302,46 @@ timeUsed(Date now) const
     return start.secondsUntil(now);
 }
 
+unsigned
+Auction::
+chunkOf(unsigned index, unsigned & offset)
+{
+    unsigned n = index / FirstChunkSize + 1;
+    unsigned chunkNum = 31 - __builtin_clz(n);
+    offset = index - FirstChunkSize * ((1U << chunkNum) - 1);
+    return chunkNum;
+}
+
+void
+Auction::
+allocateChunk(unsigned index)
+{
+    unsigned offset;
+    unsigned chunkNum = chunkOf(index, offset);
+
+    LogEntry * chunk = logChunks[chunkNum].load();
+    if (chunk) return;
+
+    size_t size = FirstChunkSize << chunkNum;
+    LogEntry * newChunk = (LogEntry *)::operator new(size * sizeof(LogEntry));
+    if (!logChunks[chunkNum].compare_exchange_strong(chunk, newChunk))
+        ::operator delete(newChunk);
+}
+
+Auction::LogEntry *
+Auction::
+logEntry(unsigned index) const
+{
+    unsigned offset;
+    unsigned chunkNum = chunkOf(index, offset);
+    return logChunks[chunkNum].load() + offset;
+}
+
 Auction::WinLoss
 Auction::
 setResponse(int spotNum, Response newResponse)
 {
-    Data * current = this->data;
-
-    if (spotNum < 0 || spotNum >= current->responses.size())
+    if (spotNum < 0 || spotNum >= int(winnersSize))
         throw ML::Exception("invalid spot number in response");
 
     if (newResponse.price.maxPrice.isNegative()
@@ -283,40 +349,122 @@ setResponse(int spotNum, Response newResponse)
         || newResponse.creativeId == -1)
         return WinLoss::INVALID;
 
-    if (current->tooLate)
-        return WinLoss::TOOLATE;
+    // Take the next place in the log, unless the auction is over.  Once we
+    // have it, every path must write the entry and bump logWritten or
+    // closeLog() will wait forever.
+    unsigned index = logState;
+    do {
+        if (index & Closed)
+            return WinLoss::TOOLATE;
+        if (index >= FirstChunkSize * ((1U << MaxChunks) - 1))
+            throw ML::Exception("too many responses in auction");
+        allocateChunk(index);
+    } while (!logState.compare_exchange_weak(index, index + 1));
+
+    newResponse.localStatus = WinLoss::PENDING;
+    uint64_t key
+        = (uint64_t(orderedBits(newResponse.price.priority)) << 32) | index;
+
+    // Can't throw: the chunk was allocated before the index was taken
+    LogEntry * entry = logEntry(index);
+    try {
+        new (entry) LogEntry(spotNum, std::move(newResponse));
+    } catch (...) {
+        // Leave a placeholder so that the log stays complete
+        new (entry) LogEntry(-1, Response());
+        ++logWritten;
+        throw;
+    }
 
+    // The first response with the highest priority wins the spot
+    std::atomic<uint64_t> & winner = winners[spotNum];
+    uint64_t current = winner;
+    while ((current == NoWinner || (key >> 32) > (current >> 32))
+           && !winner.compare_exchange_weak(current, key))
+        ;
 
-    WinLoss result;
+    ++logWritten;
 
-    auto_ptr<Data> newData(new Data());
+    return WinLoss::PENDING;
+}
 
-    for (;;) {
-        if (current->tooLate)
-            return WinLoss::TOOLATE;
-        
-        *newData = *current;
+Auction::Data *
+Auction::
+buildData(unsigned numLogged, WinLoss winnerStatus) const
+{
+    std::unique_ptr<Data> result(new Data(winnersSize));
+    result->numLogged = numLogged;
+
+    // Winner of each spot amongst the entries we're looking at.  It's the
+    // one in the spot's slot unless a newer response took it over.
+    const unsigned NoIndex = -1;
+    std::vector<unsigned> winning(winnersSize, NoIndex);
+    for (unsigned spot = 0;  spot < winnersSize;  ++spot) {
+        uint64_t key = winners[spot];
+        if (key != NoWinner && (key & 0xffffffff) < numLogged) {
+            winning[spot] = key & 0xffffffff;
+            continue;
+        }
+
+        uint32_t best = 0;
+        for (unsigned i = 0;  i < numLogged;  ++i) {
+            const LogEntry * entry = logEntry(i);
+            if (entry->spotNum != int(spot)) continue;
+            uint32_t priority = orderedBits(entry->response.price.priority);
+            if (winning[spot] == NoIndex || priority > best) {
+                winning[spot] = i;
+                best = priority;
+            }
+        }
+    }
 
-        bool hasExisting = current->hasValidResponse(spotNum);
+    for (unsigned spot = 0;  spot < winnersSize;  ++spot) {
+        if (winning[spot] == NoIndex) continue;
+        result->responses[spot].push_back(logEntry(winning[spot])->response);
+        result->responses[spot].back().localStatus = winnerStatus;
+    }
 
-        result = newResponse.localStatus = WinLoss::PENDING;
-        newData->responses[spotNum].push_back(newResponse);
+    for (unsigned i = 0;  i < numLogged;  ++i) {
+        const LogEntry * entry = logEntry(i);
+        if (entry->spotNum < 0 || winning[entry->spotNum] == i) continue;
+        result->responses[entry->spotNum].push_back(entry->response);
+        result->responses[entry->spotNum].back().localStatus = WinLoss::LOSS;
+    }
 
-        if (hasExisting) {
-            auto & spot = newData->responses[spotNum];
-            if (newResponse.price.priority >
-                current->winningResponse(spotNum).price.priority) {
-                std::swap(spot.front(), spot.back());
-            }
+    {
+        std::lock_guard<ML::Spinlock> guard(dataSourcesLock);
+        result->dataSources = dataSources;
+    }
 
-            spot.back().localStatus = WinLoss::LOSS;
+    return result.release();
+}
+
+const Auction::Data *
+Auction::
+getCurrentData() const
+{
+    for (;;) {
+        Data * current = this->data;
+        if (current->tooLate)
+            return current;
+
+        // Wait for the writers in progress, or for the final view if the
+        // auction is being finished.
+        unsigned written = logWritten;
+        unsigned state = logState;
+        if ((state & Closed) || written != state) {
+            sched_yield();
+            continue;
         }
 
-        newData->oldData = current;
+        if (current->numLogged == written)
+            return current;
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
-        return result;
+        Data * newData = buildData(written, WinLoss::PENDING);
+        newData->oldData = current;
+        if (ML::cmp_xchg(this->data, current, newData))
+            return newData;
+        delete newData;
     }
 }
 
@@ -324,8 +472,7 @@ const std::vector<std::vector<Auction::Response> > &
 Auction::
 getResponses() const
 {
-    const Data * current = this->data;
-    return current->responses;
+    return getCurrentData()->responses;
 }
 
 void
@@ -334,94 +481,73 @@ addDataSources(const std::set<std::string> & sources)
 {
     if (sources.empty()) return;
 
-    Data * current = this->data;
-    unique_ptr<Data> newData(new Data);
-
-    for (;;) {
-
-        std::set<std::string> newSources = current->dataSources;
-        newSources.insert(sources.begin(), sources.end());
-
-        // Nothing new was added, just bail.
-        if (newSources.size() == current->dataSources.size()) return;
-
-        if (!newData) newData.reset(new Data);
-        *newData = *current;
-        std::swap(newData->dataSources, newSources);
-
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
-        return;
-    }
+    std::lock_guard<ML::Spinlock> guard(dataSourcesLock);
+    dataSources.insert(sources.begin(), sources.end());
 }
 
 const std::set<std::string> &
 Auction::
 getDataSources() const
 {
-    const Data * current = this->data;
-    return current->dataSources;
+    return getCurrentData()->dataSources;
 }
 
 bool
 Auction::
-finish()
+closeLog(unsigned & numLogged)
 {
-    Data * current = this->data;
+    unsigned state = logState.fetch_or(Closed);
+    if (state & Closed)
+        return false;
 
-    for (;;) {
-        if (current->tooLate)
-            return false;
+    // Nobody can take a place anymore; wait for those who did
+    while (logWritten != state)
+        sched_yield();
 
-        auto_ptr<Data> newData(new Data(*current));
+    numLogged = state;
+    return true;
+}
 
-        for (unsigned spotNum = 0;  spotNum < numSpots(); ++spotNum) {
-            if (newData->hasValidResponse(spotNum))
-                newData->responses[spotNum][0].localStatus = WinLoss::WIN;
-        }
-        
-        newData->oldData = current;
-        newData->tooLate = true;
+void
+Auction::
+publishFinal(Data * newData)
+{
+    newData->tooLate = true;
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
-        break;
-    }
+    Data * current = this->data;
+    do {
+        newData->oldData = current;
+    } while (!ML::cmp_xchg(this->data, current, newData));
 
     handleAuction(shared_from_this());
-
-    return true;
 }
 
 bool
 Auction::
-setError(const std::string & error, const std::string & details)
+finish()
 {
-    Data * current = this->data;
+    unsigned numLogged;
+    if (!closeLog(numLogged))
+        return false;
 
-    for (;;) {
-        if (current->tooLate)
-            return false;
+    publishFinal(buildData(numLogged, WinLoss::WIN));
 
-        auto_ptr<Data> newData(new Data(*current));
-        
-        newData->error = error;
-        newData->details = details;
+    return true;
+}
 
-        for (unsigned spotNum = 0;  spotNum < numSpots();  ++spotNum) {
-            if (newData->hasValidResponse(spotNum)) {
-                newData->responses[spotNum][0].localStatus = WinLoss::LOSS;
-            }
-        }
-        newData->oldData = current;
-        newData->tooLate = true;
+bool
+Auction::
+setError(const std::string & error, const std::string & details)
+{
+    unsigned numLogged;
+    if (!closeLog(numLogged))
+        return false;
 
-        if (!ML::cmp_xchg(this->data, current, newData.get())) continue;
-        newData.release();
-        break;
-    }
+    Data * newData = buildData(numLogged, WinLoss::LOSS);
+    newData->error = error;
+    newData->details = details;
 
-    handleAuction(shared_from_this());
+    publishFinal(newData);
     
     return true;
 }
@@ -437,7 +563,7 @@ std::string
 Auction::
 status() const
 {
-    Data * current = this->data;
+    const Data * current = getCurrentData();
 
     string result = ML::format("Auction: %d imp", (int)numSpots());
     if (current->tooLate) result += " tooLate";
@@ -461,7 +587,7 @@ getResponseJson(int spotNum) const
 {
     Json::Value result;
 
-    Data * current = this->data;
+    const Data * current = getCurrentData();
 
     if (!current->error.empty()) {
         result["error"] = current->error;
@@ -16,9 +16,12 @@
 #include "rtbkit/common/win_cost_model.h"
 #include <boost/function.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <atomic>
+#include <memory>
 #include "soa/jsoncpp/json.h"
 #include "soa/types/date.h"
 #include "jml/arch/atomic_ops.h"
+#include "jml/arch/spinlock.h"
 #include "jml/arch/exception.h"
 #include "jml/utils/compact_vector.h"
 #include "jml/db/persistent_fwd.h"
@@ -202,6 +205,9 @@ struct Auction : public std::enable_shared_from_this<Auction> {
 
         Returns the (local) status of the response.
 
+        The response is appended to a log and the spot's winner is updated
+        with a compare and swap; nothing else is copied.
+
         Thread safe.
     */
     WinLoss setResponse(int spotNum, Response newResponse);
@@ -250,13 +256,13 @@ struct Auction : public std::enable_shared_from_this<Auction> {
 
     struct Data {
         Data()
-            : tooLate(false), oldData(0)
+            : tooLate(false), oldData(0), numLogged(0)
         {
             responses.reserve(8);
         }
 
         Data(int numSpots)
-            : tooLate(false), responses(numSpots), oldData(0)
+            : tooLate(false), responses(numSpots), oldData(0), numLogged(0)
         {
         }
 
@@ -286,15 +292,78 @@ struct Auction : public std::enable_shared_from_this<Auction> {
         std::set<std::string> dataSources; // data sources used to make the bid decissions.
         Data * oldData;  ///< GC list
         std::string error, details;
+        unsigned numLogged;  ///< Responses of the log included in this view
     };
 
-    const Data * getCurrentData() const
-    {
-        return data;
-    }
+    /** Consistent view of the auction.  Once the auction is finished this is
+        its final state; before that, a view of the responses received so
+        far is built when it is asked for.
+    */
+    const Data * getCurrentData() const;
 
 private:
-    Data * data;
+    /** Responses in the order they were received.  They live in chunks of
+        doubling size that never move, so entries can be appended without a
+        lock while others are being read.
+    */
+    struct LogEntry {
+        LogEntry(int spotNum, Response && response)
+            : spotNum(spotNum), response(std::move(response))
+        {
+        }
+
+        int spotNum;
+        Response response;
+    };
+
+    enum {
+        FirstChunkSize = 8,
+        MaxChunks = 24,
+        Closed = 1U << 31       ///< Set in logState once the auction is over
+    };
+
+    /** Number of log entries handed out, and the Closed bit. */
+    std::atomic<unsigned> logState;
+
+    /** Number of log entries fully written. */
+    std::atomic<unsigned> logWritten;
+
+    std::atomic<LogEntry *> logChunks[MaxChunks];
+
+    /** Chunk holding the given index of the log, and the offset in it. */
+    static unsigned chunkOf(unsigned index, unsigned & offset);
+
+    /** Make sure the chunk holding the given index of the log exists.  Done
+        before the index is handed out, so that nothing can fail between
+        taking a place in the log and writing it.
+    */
+    void allocateChunk(unsigned index);
+
+    /** Entry at the given index of the log, whose chunk must exist. */
+    LogEntry * logEntry(unsigned index) const;
+
+    /** Winner of each spot, as its priority (in the top 32 bits, ordered
+        like the float) and its index in the log.
+    */
+    std::unique_ptr<std::atomic<uint64_t>[]> winners;
+    unsigned winnersSize;
+
+    mutable ML::Spinlock dataSourcesLock;
+    std::set<std::string> dataSources;
+
+    /** Close the log and wait for the responses already admitted to be
+        written.  Returns false if it was already closed, or the number of
+        responses in the log in numLogged otherwise.
+    */
+    bool closeLog(unsigned & numLogged);
+
+    /** Publish the final view of the auction and call the handler. */
+    void publishFinal(Data * newData);
+
+    /** Build a view of the first numLogged entries of the log. */
+    Data * buildData(unsigned numLogged, WinLoss winnerStatus) const;
+
+    mutable Data * data;
 
 public:
     /// Memory leak tracking
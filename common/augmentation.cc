@@ -48,6 +48,18 @@ void mergeAugmentationData(Json::Value& lhs, const Json::Value& rhs)
     else lhs = rhs;
 }
 
+/** Orders an account against the first n components of another account. */
+bool lessThanPrefix(const AccountKey& key, const AccountKey& account, size_t n)
+{
+    return lexicographical_compare(
+            key.begin(), key.end(), account.begin(), account.begin() + n);
+}
+
+bool equalsPrefix(const AccountKey& key, const AccountKey& account, size_t n)
+{
+    return key.size() == n && equal(key.begin(), key.end(), account.begin());
+}
+
 } // namespace anonymous
 
 
@@ -99,10 +111,77 @@ fromJson(const Json::Value& json)
 }
 
 
+/******************************************************************************/
+/* AGENT AUGMENTATIONS                                                        */
+/******************************************************************************/
+
+const string&
+AgentAugmentations::
+operator[](const string& agent) const
+{
+    static const string none;
+
+    auto it = agents.find(agent);
+    return it != agents.end() && it->second ? *it->second : none;
+}
+
+void
+AgentAugmentations::
+set(const string& agent, shared_ptr<const string> augmentations)
+{
+    agents[agent] = std::move(augmentations);
+}
+
+
 /******************************************************************************/
 /* AUGMENTATION LIST                                                          */
 /******************************************************************************/
 
+AugmentationList::iterator
+AugmentationList::
+find(const AccountKey& account)
+{
+    auto it = lower_bound(begin(), end(), account,
+            [] (const value_type& entry, const AccountKey& account) {
+                return lessThanPrefix(entry.first, account, account.size());
+            });
+
+    if (it == end() || !equalsPrefix(it->first, account, account.size()))
+        return end();
+    return it;
+}
+
+AugmentationList::const_iterator
+AugmentationList::
+find(const AccountKey& account) const
+{
+    return const_cast<AugmentationList*>(this)->find(account);
+}
+
+pair<AugmentationList::iterator, bool>
+AugmentationList::
+insert(const value_type& entry)
+{
+    const AccountKey& account = entry.first;
+
+    auto it = lower_bound(begin(), end(), account,
+            [] (const value_type& entry, const AccountKey& account) {
+                return lessThanPrefix(entry.first, account, account.size());
+            });
+
+    if (it != end() && equalsPrefix(it->first, account, account.size()))
+        return make_pair(it, false);
+
+    return make_pair(AugmentationListBase::insert(it, entry), true);
+}
+
+Augmentation&
+AugmentationList::
+operator[](const AccountKey& account)
+{
+    return insert(make_pair(account, Augmentation())).first->second;
+}
+
 void
 AugmentationList::
 mergeWith(const AugmentationList& other)
@@ -111,19 +190,39 @@ mergeWith(const AugmentationList& other)
         (*this)[it->first].mergeWith(it->second);
 }
 
+void
+AugmentationList::
+matchAccount(const AccountKey& account, vector<unsigned>& indexes) const
+{
+    size_t first = indexes.size();
+
+    // The prefixes of an account are sorted by length so each search can
+    // start where the previous one left off.
+    auto it = begin();
+    for (size_t n = 0; n <= account.size() && it != end(); ++n) {
+        it = lower_bound(it, end(), n,
+                [&] (const value_type& entry, size_t n) {
+                    return lessThanPrefix(entry.first, account, n);
+                });
+
+        if (it != end() && equalsPrefix(it->first, account, n))
+            indexes.push_back(it - begin());
+    }
+
+    reverse(indexes.begin() + first, indexes.end());
+}
+
 Augmentation
 AugmentationList::
 filterForAccount(AccountKey account) const
 {
     Augmentation result;
 
-    while(true) {
-        auto it = find(account);
-        if (it != end()) result.mergeWith(it->second);
+    vector<unsigned> indexes;
+    matchAccount(account, indexes);
 
-        if (account.empty()) break;
-        account.pop_back();
-    }
+    for (unsigned i : indexes)
+        result.mergeWith((begin() + i)->second);
 
     return result;
 }
@@ -134,15 +233,12 @@ tagsForAccount(AccountKey account) const
 {
     vector<string> tags;
 
-    while(true) {
-        auto it = find(account);
-        if (it != end()) {
-            const auto& aug = it->second;
-            tags.insert(tags.end(), aug.tags.begin(), aug.tags.end());
-        }
+    vector<unsigned> indexes;
+    matchAccount(account, indexes);
 
-        if (account.empty()) break;
-        account.pop_back();
+    for (unsigned i : indexes) {
+        const auto& aug = (begin() + i)->second;
+        tags.insert(tags.end(), aug.tags.begin(), aug.tags.end());
     }
 
     sort(tags.begin(), tags.end());
@@ -12,8 +12,11 @@
 #include "rtbkit/common/account_key.h"
 #include "soa/jsoncpp/value.h"
 
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace RTBKIT {
 
@@ -47,20 +50,53 @@ struct Augmentation
 
 /** Agent name to stringified augemntation.
     In other words, it's a collapsed version of the AumgnetationList structure.
+
+    Agents that are entitled to the same augmentations share the same string.
 */
-typedef std::map<std::string, std::string> AgentAugmentations;
+struct AgentAugmentations
+{
+    /** Stringified augmentations of the agent or an empty string. */
+    const std::string& operator[](const std::string& agent) const;
+
+    void set(const std::string& agent,
+             std::shared_ptr<const std::string> augmentations);
+
+private:
+    std::map<std::string, std::shared_ptr<const std::string> > agents;
+};
 
 
 /******************************************************************************/
 /* AUGMENTATION LIST                                                          */
 /******************************************************************************/
 
-// \todo may want to change this to unordered_map.
-typedef std::map<AccountKey, Augmentation> AugmentationListBase;
+typedef std::vector< std::pair<AccountKey, Augmentation> > AugmentationListBase;
+
+/** Aggregation of the filtering rules on a per account prefix basis.
 
-/** Aggregation of the filtering rules on a per account prefix basis. */
-struct AugmentationList : public AugmentationListBase
+    The entries are kept sorted by account in a vector so that the prefixes of
+    an account can be found with a few binary searches over contiguous memory.
+ */
+struct AugmentationList : private AugmentationListBase
 {
+    typedef AugmentationListBase::value_type value_type;
+    typedef AugmentationListBase::iterator iterator;
+    typedef AugmentationListBase::const_iterator const_iterator;
+
+    using AugmentationListBase::begin;
+    using AugmentationListBase::end;
+    using AugmentationListBase::size;
+    using AugmentationListBase::empty;
+    using AugmentationListBase::clear;
+
+    iterator find(const AccountKey& account);
+    const_iterator find(const AccountKey& account) const;
+
+    /** Returns the augmentation of the account, inserting it if missing. */
+    Augmentation& operator[](const AccountKey& account);
+
+    /** Inserts the entry unless its account is already present. */
+    std::pair<iterator, bool> insert(const value_type& entry);
 
     void insertGlobal(const Augmentation& aug)
     {
@@ -82,6 +118,14 @@ struct AugmentationList : public AugmentationListBase
     std::vector<std::string> tagsForAccount(AccountKey account) const;
 
 
+    /** Appends the index of the entries whose account is a prefix of the
+        given account, from the longest prefix to the global entry. Accounts
+        with the same matches have the same filterForAccount() result.
+     */
+    void matchAccount(
+            const AccountKey& account, std::vector<unsigned>& indexes) const;
+
+
     Json::Value toJson() const;
     static AugmentationList fromJson(const Json::Value& json);
 };
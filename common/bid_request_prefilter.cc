@@ -0,0 +1,64 @@
+/* bid_request_prefilter.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Cheap summary of what the agents configured on an exchange could bid on.
+*/
+
+#include "bid_request_prefilter.h"
+
+using namespace std;
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* BID REQUEST PRE FILTER                                                    */
+/*****************************************************************************/
+
+BidRequestPreFilter::
+BidRequestPreFilter()
+    : agents(0), anyFormat(false)
+{
+}
+
+void
+BidRequestPreFilter::
+addAgent(const AgentConfig & config)
+{
+    ++agents;
+    hours |= config.hourOfWeekFilter.hourBitmap;
+
+    for (auto & creative: config.creatives) {
+        if (creative.format == Format(0, 0))
+            anyFormat = true;
+        else formats.insert(formatKey(creative.format));
+    }
+}
+
+bool
+BidRequestPreFilter::
+accept(const BidRequest & request) const
+{
+    if (agents == 0)
+        return false;
+
+    if (!(request.timestamp == Date())
+        && !hours[request.timestamp.hourOfWeek()])
+        return false;
+
+    if (anyFormat)
+        return true;
+
+    for (auto & imp: request.imp) {
+        // Spots without formats (video...) are left to the full filters
+        if (imp.formats.empty())
+            return true;
+        for (auto & format: imp.formats)
+            if (formats.count(formatKey(format)))
+                return true;
+    }
+
+    return false;
+}
+
+} // namespace RTBKIT
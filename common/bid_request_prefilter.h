@@ -0,0 +1,55 @@
+/* bid_request_prefilter.h                                         -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Cheap summary of what the agents configured on an exchange could bid on.
+*/
+
+#pragma once
+
+#include "rtbkit/common/bid_request.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include <bitset>
+#include <unordered_set>
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* BID REQUEST PRE FILTER                                                    */
+/*****************************************************************************/
+
+/** Union of the hours of the week and creative formats of every agent that
+    can bid on a given exchange.  A request that fails it can't be bid on by
+    any agent and can be answered with a no bid straight away; one that
+    passes may still be filtered out later on.
+
+    It's built by the router and is immutable once published to an exchange
+    connector, so it can be used from any connector thread.
+*/
+struct BidRequestPreFilter {
+
+    BidRequestPreFilter();
+
+    /** Widen the filter to accept what the given agent could bid on. */
+    void addAgent(const AgentConfig & config);
+
+    /** Tells if any agent could bid on the given request. */
+    bool accept(const BidRequest & request) const;
+
+    size_t numAgents() const { return agents; }
+
+private:
+    size_t agents;
+    std::bitset<168> hours;
+    bool anyFormat;                         ///< A creative accepts 0x0
+    std::unordered_set<uint32_t> formats;
+
+    static uint32_t formatKey(const Format & format)
+    {
+        return uint32_t(format.width) << 16 | uint16_t(format.height);
+    }
+};
+
+} // namespace RTBKIT
@@ -11,6 +11,10 @@
 #include "jml/utils/exc_check.h"
 #include "jml/utils/json_parsing.h"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
 using namespace std;
 using namespace ML;
 
@@ -259,6 +263,148 @@ fromJson(const std::string& raw)
     return result;
 }
 
+namespace {
+
+/** Values are written little endian whatever the host's byte order. */
+template<typename T>
+void writeBinary(std::string& out, T val)
+{
+    char bytes[sizeof(T)];
+    memcpy(bytes, &val, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::reverse(bytes, bytes + sizeof(T));
+#endif
+    out.append(bytes, sizeof(T));
+}
+
+void writeBinaryString(std::string& out, const std::string& str)
+{
+    ExcCheckLessEqual(str.size(), 0xffff, "string too long for binary bids");
+    writeBinary<uint16_t>(out, str.size());
+    out.append(str);
+}
+
+template<typename T>
+T readBinary(const char * & p, const char * end)
+{
+    if (end - p < (ptrdiff_t)sizeof(T))
+        throw ML::Exception("truncated binary bids");
+    char bytes[sizeof(T)];
+    memcpy(bytes, p, sizeof(T));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::reverse(bytes, bytes + sizeof(T));
+#endif
+    p += sizeof(T);
+
+    T result;
+    memcpy(&result, bytes, sizeof(T));
+    return result;
+}
+
+std::string readBinaryString(const char * & p, const char * end)
+{
+    uint16_t size = readBinary<uint16_t>(p, end);
+    if (end - p < size)
+        throw ML::Exception("truncated binary bids");
+    std::string result(p, size);
+    p += size;
+    return result;
+}
+
+} // file scope
+
+std::string
+Bids::
+toBinary() const
+{
+    std::string result;
+    result.reserve(4 + size() * 27);
+
+    writeBinary<uint8_t>(result, BinaryMagic);
+    writeBinary<uint8_t>(result, BinaryVersion);
+
+    ExcCheckLessEqual(size(), 0xffff, "too many bids for binary bids");
+    writeBinary<uint16_t>(result, size());
+    for (const Bid& bid : *this) {
+        bool isNull = bid.isNullBid();
+        int creativeIndex = isNull ? -1 : bid.creativeIndex;
+        if (creativeIndex < numeric_limits<int16_t>::min()
+            || creativeIndex > numeric_limits<int16_t>::max())
+            throw ML::Exception("creative index %d too large for binary bids",
+                                creativeIndex);
+        if (bid.spotIndex < numeric_limits<int16_t>::min()
+            || bid.spotIndex > numeric_limits<int16_t>::max())
+            throw ML::Exception("spot index %d too large for binary bids",
+                                bid.spotIndex);
+
+        writeBinary<uint8_t>(result, isNull ? BF_NULL : 0);
+        writeBinary<int16_t>(result, creativeIndex);
+        writeBinary<int16_t>(result, bid.spotIndex);
+        writeBinary<uint32_t>(result, uint32_t(bid.price.currencyCode));
+        writeBinary<int64_t>(result, bid.price.value);
+        writeBinary<double>(result, bid.priority);
+        writeBinaryString(result, isNull || bid.account.empty()
+                                  ? std::string() : bid.account.toString());
+    }
+
+    writeBinary<uint16_t>(result, dataSources.size());
+    for (const string& dataSource : dataSources)
+        writeBinaryString(result, dataSource);
+
+    return result;
+}
+
+Bids
+Bids::
+fromBinary(const char * data, size_t size)
+{
+    const char * p = data;
+    const char * end = data + size;
+
+    if (readBinary<uint8_t>(p, end) != BinaryMagic)
+        throw ML::Exception("not a binary bids message");
+    uint8_t version = readBinary<uint8_t>(p, end);
+    if (version != BinaryVersion)
+        throw ML::Exception("unknown binary bids version %d", int(version));
+
+    Bids result;
+
+    uint16_t numBids = readBinary<uint16_t>(p, end);
+    result.reserve(numBids);
+    for (unsigned i = 0;  i < numBids;  ++i) {
+        Bid bid;
+        uint8_t flags = readBinary<uint8_t>(p, end);
+        int16_t creativeIndex = readBinary<int16_t>(p, end);
+        bid.spotIndex = readBinary<int16_t>(p, end);
+        auto currency = CurrencyCode(readBinary<uint32_t>(p, end));
+        int64_t value = readBinary<int64_t>(p, end);
+        double priority = readBinary<double>(p, end);
+        string account = readBinaryString(p, end);
+
+        // A bid without a creative keeps its price, so that the router
+        // rejects it like it does the same bid sent as JSON.
+        if (!(flags & BF_NULL)) {
+            bid.creativeIndex = creativeIndex;
+            bid.price = Amount(currency, value);
+            bid.priority = priority;
+            if (!account.empty())
+                bid.account = AccountKey(account);
+        }
+
+        result.push_back(bid);
+    }
+
+    uint16_t numSources = readBinary<uint16_t>(p, end);
+    for (unsigned i = 0;  i < numSources;  ++i)
+        result.dataSources.insert(readBinaryString(p, end));
+
+    if (p != end)
+        throw ML::Exception("extra data after binary bids");
+
+    return result;
+}
+
+
 
 /******************************************************************************/
 /* BID RESULT                                                                 */
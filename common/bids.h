@@ -111,6 +111,33 @@ struct Bids : public ML::compact_vector<Bid, 4>
 
     Json::Value toJson() const;
     static Bids fromJson(const std::string& raw);
+
+    /** Compact binary encoding sent by agents that opt into it; see
+        BiddingAgent::setBinaryBids().  Layout, little endian:
+
+        - magic byte and version
+        - number of bids (uint16), then for each bid its flags (uint8,
+          BF_NULL for a null bid), creative index (int16), spot index
+          (int16), price currency code (uint32) and micro-units (int64),
+          priority (double) and account (uint16 length and bytes)
+        - number of data sources (uint16), each as a length and bytes
+
+        The magic byte can't start a JSON document.
+    */
+    std::string toBinary() const;
+    static Bids fromBinary(const char * data, size_t size);
+
+    static bool isBinary(const std::string& raw)
+    {
+        return raw.size() >= 2 && uint8_t(raw[0]) == BinaryMagic;
+    }
+
+    static constexpr uint8_t BinaryMagic = 0xbd;
+    static constexpr uint8_t BinaryVersion = 2;
+
+    enum BinaryFlags : uint8_t {
+        BF_NULL = 1     ///< Null bid; only the spot index is meaningful
+    };
 };
 
 
@@ -270,6 +270,20 @@ bool
 CurrencyPool::
 operator == (const CurrencyPool & other) const
 {
+    // Both pools are sorted by currency code so identical entries can be
+    // compared pairwise; a zero entry matches a missing one, which needs the
+    // full check below.
+    if (currencyAmounts.size() == other.currencyAmounts.size()) {
+        bool same = true;
+        for (unsigned i = 0;  same && i < currencyAmounts.size();  ++i) {
+            const Amount & am1 = currencyAmounts[i];
+            const Amount & am2 = other.currencyAmounts[i];
+            same = am1.currencyCode == am2.currencyCode
+                && am1.value == am2.value;
+        }
+        if (same) return true;
+    }
+
     auto checkContains = [] (const CurrencyPool & pool1,
                              const CurrencyPool & pool2)
         {
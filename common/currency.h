@@ -8,12 +8,14 @@
 #define __types__currency_h__
 
 
+#include "jml/compiler/compiler.h"
 #include "jml/utils/exc_assert.h"
 #include "jml/utils/compact_vector.h"
 #include "jml/utils/unnamed_bool.h"
 #include "jml/db/persistent.h"
 #include "soa/jsoncpp/json.h"
 #include "soa/types/value_description.h"
+#include <algorithm>
 
 namespace RTBKIT {
 
@@ -265,27 +267,39 @@ struct CurrencyPool {
     }
 
     CurrencyPool(const Amount & amount)
-        : currencyAmounts(1, amount)
     {
-        if (!amount)
-            currencyAmounts.clear();
+        if (amount)
+            currencyAmounts.push_back(amount);
     }
 
     CurrencyPool & operator += (const Amount & amount)
     {
         if (!amount) return *this;
 
-        for (auto & am: currencyAmounts) {
-            if (am.currencyCode == amount.currencyCode) {
-                am += amount;
-                return *this;
-            }
+        // Single currency deployments only ever hit the first entry.
+        if (JML_LIKELY(!currencyAmounts.empty()
+                       && currencyAmounts[0].currencyCode
+                          == amount.currencyCode)) {
+            currencyAmounts[0].value += amount.value;
+            return *this;
+        }
+
+        // Keep the entries sorted by currency code.
+        unsigned i = 0;
+        while (i < currencyAmounts.size()
+               && currencyAmounts[i].currencyCode < amount.currencyCode)
+            ++i;
+
+        if (i < currencyAmounts.size()
+            && currencyAmounts[i].currencyCode == amount.currencyCode) {
+            currencyAmounts[i].value += amount.value;
+            return *this;
         }
 
         currencyAmounts.push_back(amount);
-        std::sort(currencyAmounts.begin(), currencyAmounts.end(),
-                  [] (Amount am1, Amount am2)
-                  { return am1.currencyCode < am2.currencyCode; });
+        std::rotate(currencyAmounts.begin() + i,
+                    currencyAmounts.end() - 1,
+                    currencyAmounts.end());
 
         return *this;
     }
@@ -408,7 +422,9 @@ struct CurrencyPool {
     void serialize(ML::DB::Store_Writer & store) const;
     void reconstitute(ML::DB::Store_Reader & store);
 
-    ML::compact_vector<Amount, 1> currencyAmounts;  /// Amounts per currency
+    /// Amounts per currency, sorted by currency code.  Deployments rarely
+    /// use more than two currencies so they are kept inline.
+    ML::compact_vector<Amount, 2> currencyAmounts;
 
     Json::Value toJson() const;
     std::string toString() const;
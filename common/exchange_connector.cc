@@ -26,7 +26,8 @@ CampaignCompatibility(const AgentConfig & config)
 ExchangeConnector::
 ExchangeConnector(const std::string & name,
                   ServiceBase & parent)
-    : ServiceBase(name, parent)
+    : ServiceBase(name, parent),
+      metrics(*this)
 {
     onNewAuction  = [=] (std::shared_ptr<Auction> a) {
         cerr << "WARNING: an auction was lost into the void.  exchange=" << name <<
@@ -36,12 +37,15 @@ ExchangeConnector(const std::string & name,
     numRequests = 0;
     numAuctions = 0;
     acceptAuctionProbability = 1.0;
+
+    metrics.start();
 }
 
 ExchangeConnector::
 ExchangeConnector(const std::string & name,
                   std::shared_ptr<ServiceProxies> proxies)
-    : ServiceBase(name, proxies)
+    : ServiceBase(name, proxies),
+      metrics(*this)
 {
     onNewAuction  = [=] (std::shared_ptr<Auction> a) {
         cerr << "WARNING: an auction was lost into the void.  exchange=" << name <<
@@ -51,6 +55,8 @@ ExchangeConnector(const std::string & name,
     numRequests = 0;
     numAuctions = 0;
     acceptAuctionProbability = 1.0;
+
+    metrics.start();
 }
 
 ExchangeConnector::
@@ -68,6 +74,7 @@ void
 ExchangeConnector::
 shutdown()
 {
+    metrics.shutdown();
 }
 
 WinCostModel
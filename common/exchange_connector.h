@@ -10,12 +10,16 @@
 #include "soa/service/service_base.h"
 #include "rtbkit/common/auction.h"
 #include "rtbkit/common/win_cost_model.h"
+#include "rtbkit/common/bid_request_prefilter.h"
+#include "rtbkit/common/metric_registry.h"
+#include "jml/arch/spinlock.h"
 #include "jml/utils/unnamed_bool.h"
 
 namespace RTBKIT {
 
 class AgentConfig;
 class Creative;
+struct CreativeConstraint;
 class BidSource;
 
 /*****************************************************************************/
@@ -59,6 +63,17 @@ struct ExchangeConnector: public ServiceBase {
     /** Probability that we will accept a given auction. */
     double acceptAuctionProbability;
 
+    /** Metrics of the hot paths.  They are flushed from construction until
+        shutdown(), so connectors that override start() needn't chain to it.
+    */
+    MetricRegistry metrics;
+
+private:
+    mutable ML::Spinlock preFilterLock;
+    std::shared_ptr<const BidRequestPreFilter> preFilter;
+
+public:
+
     /*************************************************************************/
     /* METHODS CALLED BY THE ROUTER TO CONTROL THE EXCHANGE CONNECTOR        */
     /*************************************************************************/
@@ -100,6 +115,23 @@ struct ExchangeConnector: public ServiceBase {
         this->acceptAuctionProbability = prob;
     }
 
+    /** Set the summary of what the agents configured on this exchange could
+        bid on.  While requests are being shed, those it rejects are dropped
+        first and random shedding only applies to the others.  Passing a
+        null pointer restores plain random shedding.
+    */
+    void setPreFilter(std::shared_ptr<const BidRequestPreFilter> filter)
+    {
+        std::lock_guard<ML::Spinlock> guard(preFilterLock);
+        preFilter = std::move(filter);
+    }
+
+    std::shared_ptr<const BidRequestPreFilter> getPreFilter() const
+    {
+        std::lock_guard<ML::Spinlock> guard(preFilterLock);
+        return preFilter;
+    }
+
     /** Returns a function that can be used to sample the load of the exchange
         connector. See LoopMonitor documentation for more details.
      */
@@ -185,6 +217,12 @@ struct ExchangeConnector: public ServiceBase {
             computed values for bidding.
         */
         std::shared_ptr<void> info;
+
+        /** For a creative, the exchange's constraints on it if they can be
+            expressed as CreativeConstraint.  The router then indexes them
+            and doesn't call bidRequestCreativeFilter() for the creative.
+        */
+        std::shared_ptr<const std::vector<CreativeConstraint> > constraints;
     };
 
     /** Structure that tells whether a campaign itself, and each of its
@@ -0,0 +1,244 @@
+/* log_record.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Binary encoding of the log channel messages.
+*/
+
+#include "rtbkit/common/log_record.h"
+#include "jml/arch/exception.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+namespace RTBKIT {
+
+namespace {
+
+const char * channelNames[LC_NUM_CHANNELS] = {
+    "",
+    "AUCTION",
+    "BID",
+    "NOBUDGET",
+    "MATCHEDWIN",
+    "MATCHEDLOSS",
+    "CONFIG",
+    "USAGE",
+    "MARK",
+    "BEHAVIOUR",
+    "ERROR",
+    "ROUTERERROR",
+    "PAERROR"
+};
+
+void writeVarint(std::string & out, uint64_t val)
+{
+    while (val >= 0x80) {
+        out.push_back(char((val & 0x7f) | 0x80));
+        val >>= 7;
+    }
+    out.push_back(char(val));
+}
+
+uint64_t readVarint(const char * & p, const char * end)
+{
+    uint64_t result = 0;
+    for (int shift = 0;  shift < 64;  shift += 7) {
+        if (p == end)
+            throw ML::Exception("truncated log record");
+        uint8_t c = *p++;
+        result |= uint64_t(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return result;
+    }
+    throw ML::Exception("invalid varint in log record");
+}
+
+void writeFixed64(std::string & out, uint64_t val)
+{
+    for (unsigned i = 0;  i < 8;  ++i)
+        out.push_back(char(val >> (8 * i)));
+}
+
+uint64_t readFixed64(const char * & p, const char * end)
+{
+    if (end - p < 8)
+        throw ML::Exception("truncated log record");
+    uint64_t result = 0;
+    for (unsigned i = 0;  i < 8;  ++i)
+        result |= uint64_t(uint8_t(p[i])) << (8 * i);
+    p += 8;
+    return result;
+}
+
+std::string readString(const char * & p, const char * end)
+{
+    uint64_t size = readVarint(p, end);
+    if (size > uint64_t(end - p))
+        throw ML::Exception("truncated log record");
+    std::string result(p, size);
+    p += size;
+    return result;
+}
+
+} // file scope
+
+LogChannel
+logChannelFromString(const std::string & channel)
+{
+    for (unsigned i = 1;  i < LC_NUM_CHANNELS;  ++i)
+        if (channel == channelNames[i])
+            return LogChannel(i);
+    return LC_OTHER;
+}
+
+const char *
+logChannelToChar(LogChannel channel)
+{
+    if (channel >= LC_NUM_CHANNELS)
+        throw ML::Exception("unknown log channel %d", int(channel));
+    return channelNames[channel];
+}
+
+
+/*****************************************************************************/
+/* LOG RECORD                                                                */
+/*****************************************************************************/
+
+void
+LogRecord::
+startRecord(std::string & out, const std::string & channel,
+            Date timestamp, size_t numFields)
+{
+    out.reserve(64);
+    out.push_back(char(Magic));
+    out.push_back(char(Version));
+
+    LogChannel id = logChannelFromString(channel);
+    out.push_back(char(id));
+    if (id == LC_OTHER) {
+        writeVarint(out, channel.size());
+        out.append(channel);
+    }
+
+    int64_t micros = llround(timestamp.secondsSinceEpoch() * 1000000.0);
+    writeFixed64(out, micros);
+
+    writeVarint(out, numFields);
+}
+
+void
+LogRecord::
+addField(std::string & out, FieldType type, const char * data, size_t size)
+{
+    out.push_back(char(type));
+    writeVarint(out, size);
+    out.append(data, size);
+}
+
+void
+LogRecord::
+addInt(std::string & out, int64_t val)
+{
+    out.push_back(char(FT_INT));
+    writeVarint(out, (uint64_t(val) << 1) ^ uint64_t(val >> 63));
+}
+
+void
+LogRecord::
+addUInt(std::string & out, uint64_t val)
+{
+    out.push_back(char(FT_UINT));
+    writeVarint(out, val);
+}
+
+void
+LogRecord::
+addDouble(std::string & out, double val)
+{
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    out.push_back(char(FT_DOUBLE));
+    writeFixed64(out, bits);
+}
+
+LogRecord
+LogRecord::
+decode(const char * data, size_t size)
+{
+    const char * p = data;
+    const char * end = data + size;
+
+    if (!isRecord(data, size))
+        throw ML::Exception("not a binary log record");
+    p += 2;
+    // Version 1 is version 2 without the number types
+    if (uint8_t(data[1]) != Version && uint8_t(data[1]) != 1)
+        throw ML::Exception("unknown log record version %d", int(data[1]));
+
+    LogRecord result;
+
+    if (p == end)
+        throw ML::Exception("truncated log record");
+    uint8_t channel = *p++;
+    if (channel >= LC_NUM_CHANNELS)
+        throw ML::Exception("unknown log channel %d", int(channel));
+    result.channel = LogChannel(channel);
+    result.channelName = channel == LC_OTHER
+        ? readString(p, end)
+        : std::string(channelNames[channel]);
+
+    int64_t micros = readFixed64(p, end);
+    result.timestamp = Date::fromSecondsSinceEpoch(micros / 1000000.0);
+
+    uint64_t numFields = readVarint(p, end);
+    result.fields.reserve(numFields);
+    for (uint64_t i = 0;  i < numFields;  ++i) {
+        if (p == end)
+            throw ML::Exception("truncated log record");
+        uint8_t type = *p++;
+        switch (type) {
+        case FT_STRING:
+        case FT_ID:
+        case FT_JSON:
+            result.fields.emplace_back(FieldType(type), readString(p, end));
+            break;
+        case FT_INT: {
+            uint64_t val = readVarint(p, end);
+            int64_t decoded = int64_t(val >> 1) ^ -int64_t(val & 1);
+            result.fields.emplace_back(FT_INT, logField(decoded));
+            break;
+        }
+        case FT_UINT:
+            result.fields.emplace_back(FT_UINT, logField(readVarint(p, end)));
+            break;
+        case FT_DOUBLE: {
+            uint64_t bits = readFixed64(p, end);
+            double val;
+            memcpy(&val, &bits, sizeof(val));
+            result.fields.emplace_back(FT_DOUBLE, logField(val));
+            break;
+        }
+        default:
+            throw ML::Exception("unknown log record field type %d", int(type));
+        }
+    }
+
+    return result;
+}
+
+std::vector<std::string>
+LogRecord::
+toText() const
+{
+    std::vector<std::string> result;
+    result.reserve(fields.size() + 2);
+    result.push_back(channelName);
+    result.push_back(timestamp.print(5));
+    for (auto & f: fields)
+        result.push_back(f.second);
+    return result;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,250 @@
+/* log_record.h                                                    -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Binary encoding of the messages published on the router and post auction
+   loop logging channels.
+*/
+
+#pragma once
+
+#include "soa/types/date.h"
+#include "soa/types/id.h"
+#include "soa/jsoncpp/value.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* LOG CHANNEL                                                               */
+/*****************************************************************************/
+
+/** Well known logging channels.  Records on any other channel carry the
+    name of the channel instead.
+*/
+enum LogChannel : uint8_t {
+    LC_OTHER = 0,
+    LC_AUCTION,
+    LC_BID,
+    LC_NOBUDGET,
+    LC_MATCHEDWIN,
+    LC_MATCHEDLOSS,
+    LC_CONFIG,
+    LC_USAGE,
+    LC_MARK,
+    LC_BEHAVIOUR,
+    LC_ERROR,
+    LC_ROUTERERROR,
+    LC_PAERROR,
+    LC_NUM_CHANNELS
+};
+
+LogChannel logChannelFromString(const std::string & channel);
+const char * logChannelToChar(LogChannel channel);
+
+
+/*****************************************************************************/
+/* LOG FIELD                                                                 */
+/*****************************************************************************/
+
+/** Text form of a log message field.  Text messages are published through
+    this and binary records are rendered through it, so both give the same
+    text for the same field.  Strings and ids are passed through as is.
+*/
+template<typename T>
+typename std::enable_if<std::is_arithmetic<T>::value, std::string>::type
+logField(T val)
+{
+    return std::to_string(val);
+}
+
+inline std::string logField(const Json::Value & val)
+{
+    return val.toString();
+}
+
+template<typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value, const T &>::type
+logField(const T & val)
+{
+    return val;
+}
+
+
+/*****************************************************************************/
+/* LOG RECORD                                                                */
+/*****************************************************************************/
+
+/** Self describing binary log record.  Layout:
+
+    - magic byte and version
+    - channel id, followed by the channel name for LC_OTHER
+    - timestamp as microseconds since the epoch
+    - field count, then for each field its type and value
+
+    String, id and json values are a length followed by their bytes.
+    Integers are varints, zigzag encoded when signed, and doubles are 8
+    bytes.  Lengths and counts are varints and fixed size values are little
+    endian.  The magic byte can't start a text message, whose first field is
+    a printed date.
+*/
+struct LogRecord {
+
+    enum FieldType : uint8_t {
+        FT_STRING,
+        FT_ID,
+        FT_JSON,
+        FT_INT,
+        FT_UINT,
+        FT_DOUBLE
+    };
+
+    static constexpr uint8_t Magic = 0xdb;
+    static constexpr uint8_t Version = 2;
+
+    LogRecord() : channel(LC_OTHER)
+    {
+    }
+
+    LogChannel channel;
+    std::string channelName;
+    Date timestamp;
+
+    /** Type and text of each field.  Numbers are rendered with logField()
+        when the record is decoded.
+    */
+    std::vector<std::pair<FieldType, std::string> > fields;
+
+    /** Tells if the given message part holds a binary record. */
+    static bool isRecord(const char * data, size_t size)
+    {
+        return size >= 2 && uint8_t(data[0]) == Magic;
+    }
+
+    /** Encode the given fields into a record. */
+    template<typename... Args>
+    static std::string encode(const std::string & channel, Date timestamp,
+                              Args&&... args)
+    {
+        std::string result;
+        startRecord(result, channel, timestamp, countFields(args...));
+        addFields(result, std::forward<Args>(args)...);
+        return result;
+    }
+
+    static LogRecord decode(const char * data, size_t size);
+    static LogRecord decode(const std::string & str)
+    {
+        return decode(str.c_str(), str.size());
+    }
+
+    /** Render the record as the parts of the equivalent text message: the
+        channel name, the printed timestamp then every field.
+    */
+    std::vector<std::string> toText() const;
+
+private:
+    static void startRecord(std::string & out, const std::string & channel,
+                            Date timestamp, size_t numFields);
+    static void addField(std::string & out, FieldType type,
+                         const char * data, size_t size);
+    static void addInt(std::string & out, int64_t val);
+    static void addUInt(std::string & out, uint64_t val);
+    static void addDouble(std::string & out, double val);
+
+    static size_t countFields()
+    {
+        return 0;
+    }
+
+    template<typename First, typename... Rest>
+    static size_t countFields(const First & first, const Rest &... rest)
+    {
+        return fieldCount(first) + countFields(rest...);
+    }
+
+    template<typename T>
+    static size_t fieldCount(const T &)
+    {
+        return 1;
+    }
+
+    /** A list of strings is spread over one field per element, like it is
+        over the parts of a text message.
+    */
+    static size_t fieldCount(const std::vector<std::string> & strs)
+    {
+        return strs.size();
+    }
+
+    static void addFields(std::string & out)
+    {
+    }
+
+    template<typename First, typename... Rest>
+    static void addFields(std::string & out, First && first, Rest&&... rest)
+    {
+        addValue(out, first);
+        addFields(out, std::forward<Rest>(rest)...);
+    }
+
+    static void addValue(std::string & out, const std::string & str)
+    {
+        addField(out, FT_STRING, str.c_str(), str.size());
+    }
+
+    static void addValue(std::string & out, const char * str)
+    {
+        addField(out, FT_STRING, str, strlen(str));
+    }
+
+    static void addValue(std::string & out, const Id & id)
+    {
+        std::string str = id.toString();
+        addField(out, FT_ID, str.c_str(), str.size());
+    }
+
+    static void addValue(std::string & out, const Json::Value & json)
+    {
+        std::string str = json.toString();
+        addField(out, FT_JSON, str.c_str(), str.size());
+    }
+
+    static void addValue(std::string & out,
+                         const std::vector<std::string> & strs)
+    {
+        for (auto & str: strs)
+            addValue(out, str);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value
+                                   && std::is_signed<T>::value>::type
+    addValue(std::string & out, T val)
+    {
+        addInt(out, val);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value
+                                   && !std::is_signed<T>::value>::type
+    addValue(std::string & out, T val)
+    {
+        addUInt(out, val);
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    addValue(std::string & out, T val)
+    {
+        addDouble(out, val);
+    }
+};
+
+} // namespace RTBKIT
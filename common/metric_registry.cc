@@ -0,0 +1,261 @@
+/* metric_registry.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Metrics whose key is resolved once into a handle.
+*/
+
+#include "metric_registry.h"
+
+#include <chrono>
+
+using namespace std;
+
+namespace RTBKIT {
+
+namespace {
+
+std::atomic<uint64_t> nextRegistryId(1);
+
+/** Counters of the registries the thread has recorded into.  Registry ids
+    are never reused, so an entry can't be mistaken for the one of a
+    registry that was destroyed.
+*/
+enum { ThreadCacheSize = 8 };
+
+struct ThreadCacheEntry {
+    uint64_t id;
+    void * counters;
+};
+
+static __thread ThreadCacheEntry threadCache[ThreadCacheSize];
+static __thread unsigned threadCacheNext;
+
+} // file scope
+
+
+/*****************************************************************************/
+/* THREAD COUNTERS                                                           */
+/*****************************************************************************/
+
+MetricRegistry::ThreadCounters::
+ThreadCounters()
+{
+    for (auto & chunk: chunks)
+        chunk.store(nullptr, std::memory_order_relaxed);
+}
+
+MetricRegistry::ThreadCounters::
+~ThreadCounters()
+{
+    for (auto & chunk: chunks)
+        delete[] chunk.load(std::memory_order_relaxed);
+}
+
+std::atomic<uint64_t> *
+MetricRegistry::ThreadCounters::
+addChunk(unsigned chunk)
+{
+    std::atomic<uint64_t> * result = new std::atomic<uint64_t>[CounterChunkSize];
+    for (unsigned i = 0;  i < CounterChunkSize;  ++i)
+        result[i].store(0, std::memory_order_relaxed);
+    chunks[chunk].store(result, std::memory_order_release);
+    return result;
+}
+
+uint64_t
+MetricRegistry::ThreadCounters::
+load(unsigned index) const
+{
+    std::atomic<uint64_t> * chunk
+        = chunks[index / CounterChunkSize].load(std::memory_order_acquire);
+    if (!chunk) return 0;
+    return chunk[index % CounterChunkSize].load(std::memory_order_relaxed);
+}
+
+
+/*****************************************************************************/
+/* METRIC REGISTRY                                                           */
+/*****************************************************************************/
+
+MetricRegistry::
+MetricRegistry(EventRecorder & events, double flushPeriod)
+    : events(events),
+      flushPeriod(flushPeriod),
+      id(nextRegistryId.fetch_add(1)),
+      gauges(new GaugeValue[MaxGauges]),
+      shutdownRequested(false)
+{
+    for (unsigned i = 0;  i < MaxGauges;  ++i) {
+        gauges[i].value = 0.0;
+        gauges[i].updated = false;
+    }
+
+    counterKeys.push_back("metrics.overflow");
+    counterIndex[counterKeys.back()] = 0;
+    flushed.push_back(0);
+}
+
+MetricRegistry::
+~MetricRegistry()
+{
+    shutdown();
+}
+
+MetricRegistry::Counter
+MetricRegistry::
+counter(const std::string & key)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    Counter result;
+    result.registry = this;
+
+    auto it = counterIndex.find(key);
+    if (it != counterIndex.end()) {
+        result.index = it->second;
+        return result;
+    }
+
+    if (counterKeys.size() == MaxCounters)
+        return result;
+
+    result.index = counterKeys.size();
+    counterIndex[key] = result.index;
+    counterKeys.push_back(key);
+    flushed.push_back(0);
+    return result;
+}
+
+MetricRegistry::Gauge
+MetricRegistry::
+gauge(const std::string & key)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    Gauge result;
+
+    auto it = gaugeIndex.find(key);
+    if (it != gaugeIndex.end()) {
+        result.registry = this;
+        result.index = it->second;
+        return result;
+    }
+
+    // Gauges past the capacity record nothing
+    if (gaugeKeys.size() == MaxGauges)
+        return result;
+
+    result.registry = this;
+    result.index = gaugeKeys.size();
+    gaugeIndex[key] = result.index;
+    gaugeKeys.push_back(key);
+    return result;
+}
+
+MetricRegistry::ThreadCounters &
+MetricRegistry::
+threadCounters()
+{
+    for (unsigned i = 0;  i < ThreadCacheSize;  ++i)
+        if (threadCache[i].id == id)
+            return *(ThreadCounters *)threadCache[i].counters;
+    return addThread();
+}
+
+MetricRegistry::ThreadCounters &
+MetricRegistry::
+addThread()
+{
+    ThreadCounters * counters;
+
+    {
+        // A thread whose cache entry was evicted finds its counters here.
+        // Thread ids can be reused once a thread exits, in which case the
+        // new thread carries on with the counters of the old one.
+        std::lock_guard<std::mutex> guard(lock);
+        auto & slot = threads[std::this_thread::get_id()];
+        if (!slot)
+            slot.reset(new ThreadCounters());
+        counters = slot.get();
+    }
+
+    ThreadCacheEntry & entry = threadCache[threadCacheNext++ % ThreadCacheSize];
+    entry.id = id;
+    entry.counters = counters;
+
+    return *counters;
+}
+
+void
+MetricRegistry::
+start()
+{
+    flusher = std::thread([=] ()
+        {
+            std::unique_lock<std::mutex> guard(flushLock);
+            auto period = std::chrono::duration<double>(flushPeriod);
+            while (!flushCondition.wait_for(guard, period,
+                                            [&] { return shutdownRequested; }))
+                flush();
+        });
+}
+
+void
+MetricRegistry::
+shutdown()
+{
+    {
+        std::lock_guard<std::mutex> guard(flushLock);
+        shutdownRequested = true;
+    }
+    flushCondition.notify_all();
+
+    // The last flush is done here, once nothing else is flushing
+    if (flusher.joinable()) {
+        flusher.join();
+        flush();
+    }
+}
+
+size_t
+MetricRegistry::
+numThreads()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return threads.size();
+}
+
+void
+MetricRegistry::
+flush()
+{
+    std::vector<std::pair<std::string, uint64_t> > counts;
+    std::vector<std::pair<std::string, float> > levels;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        for (unsigned i = 0;  i < counterKeys.size();  ++i) {
+            uint64_t total = 0;
+            for (auto & thread: threads)
+                total += thread.second->load(i);
+            if (total == flushed[i]) continue;
+            counts.emplace_back(counterKeys[i], total - flushed[i]);
+            flushed[i] = total;
+        }
+
+        for (unsigned i = 0;  i < gaugeKeys.size();  ++i) {
+            if (!gauges[i].updated.exchange(false, std::memory_order_acquire))
+                continue;
+            levels.emplace_back(gaugeKeys[i],
+                                gauges[i].value.load(std::memory_order_relaxed));
+        }
+    }
+
+    for (auto & count: counts)
+        events.recordEvent(count.first.c_str(), ET_COUNT, count.second);
+    for (auto & level: levels)
+        events.recordEvent(level.first.c_str(), ET_LEVEL, level.second);
+}
+
+} // namespace RTBKIT
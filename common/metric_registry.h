@@ -0,0 +1,177 @@
+/* metric_registry.h                                               -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Metrics whose key is resolved once into a handle.
+*/
+
+#pragma once
+
+#include "soa/service/service_base.h"
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* METRIC REGISTRY                                                           */
+/*****************************************************************************/
+
+/** Counters and gauges for the hot paths, as a replacement for recordHit()
+    and recordLevel() with a key formatted on every call.
+
+    The key of a metric is looked up once, when its handle is created, and
+    recording through the handle is a plain store: counters are kept per
+    thread, so there is no contention nor atomic read-modify-write, and
+    gauges hold their last value.  A background thread sums the counters
+    every flush period and hands the deltas to the EventRecorder under the
+    same keys as before, so the published metrics don't change.
+
+    The number of keys is bounded; those past the capacity are all counted
+    under "metrics.overflow".
+*/
+struct MetricRegistry {
+
+    enum {
+        MaxCounters = 16384,
+        MaxGauges = 1024,
+        CounterChunkSize = 256
+    };
+
+    MetricRegistry(EventRecorder & events, double flushPeriod = 1.0);
+    ~MetricRegistry();
+
+    /** Handle of a counter; a default constructed one records nothing. */
+    struct Counter {
+        Counter()
+            : registry(nullptr), index(0)
+        {
+        }
+
+        void hit(uint64_t count = 1) const
+        {
+            if (!registry) return;
+            std::atomic<uint64_t> & value
+                = registry->threadCounters().value(index);
+            value.store(value.load(std::memory_order_relaxed) + count,
+                        std::memory_order_relaxed);
+        }
+
+    private:
+        friend struct MetricRegistry;
+        MetricRegistry * registry;
+        unsigned index;
+    };
+
+    /** Handle of a gauge; a default constructed one records nothing. */
+    struct Gauge {
+        Gauge()
+            : registry(nullptr), index(0)
+        {
+        }
+
+        void set(float value) const
+        {
+            if (!registry) return;
+            registry->gauges[index].value.store
+                (value, std::memory_order_relaxed);
+            registry->gauges[index].updated.store
+                (true, std::memory_order_release);
+        }
+
+    private:
+        friend struct MetricRegistry;
+        MetricRegistry * registry;
+        unsigned index;
+    };
+
+    /** Handle of the counter with the given key.  Asking twice for the same
+        key returns the same counter.
+    */
+    Counter counter(const std::string & key);
+
+    /** Handle of the gauge with the given key. */
+    Gauge gauge(const std::string & key);
+
+    /** Start the background flusher. */
+    void start();
+
+    /** Stop the background flusher; it flushes one last time. */
+    void shutdown();
+
+    /** Publish what was recorded since the last flush. */
+    void flush();
+
+    /** Number of threads that have counters in this registry. */
+    size_t numThreads();
+
+private:
+    /** Counters of one thread.  They are allocated in chunks as the
+        thread first records into them, so a thread only pays for the
+        counters it uses.  Only the owning thread adds chunks.
+    */
+    struct ThreadCounters {
+        enum { NumChunks = MaxCounters / CounterChunkSize };
+
+        ThreadCounters();
+        ~ThreadCounters();
+
+        std::atomic<uint64_t> & value(unsigned index)
+        {
+            std::atomic<uint64_t> * chunk
+                = chunks[index / CounterChunkSize].load
+                    (std::memory_order_relaxed);
+            if (!chunk)
+                chunk = addChunk(index / CounterChunkSize);
+            return chunk[index % CounterChunkSize];
+        }
+
+        /** Value of the given counter, read from any thread. */
+        uint64_t load(unsigned index) const;
+
+    private:
+        std::atomic<std::atomic<uint64_t> *> chunks[NumChunks];
+        std::atomic<uint64_t> * addChunk(unsigned chunk);
+    };
+
+    /** Counters of the calling thread, created on first use. */
+    ThreadCounters & threadCounters();
+    ThreadCounters & addThread();
+
+    struct GaugeValue {
+        std::atomic<float> value;
+        std::atomic<bool> updated;
+    };
+
+    EventRecorder & events;
+    double flushPeriod;
+    uint64_t id;                ///< Unique for the life of the process
+
+    std::mutex lock;            ///< Protects keys and threads
+    std::map<std::string, unsigned> counterIndex;
+    std::vector<std::string> counterKeys;
+    std::vector<uint64_t> flushed;
+    std::map<std::string, unsigned> gaugeIndex;
+    std::vector<std::string> gaugeKeys;
+    /** Counters of each thread that recorded into the registry.  A thread
+        that finds the registry gone from its cache gets the same counters
+        back from here.
+    */
+    std::map<std::thread::id, std::unique_ptr<ThreadCounters> > threads;
+    std::unique_ptr<GaugeValue[]> gauges;
+
+    std::mutex flushLock;
+    std::condition_variable flushCondition;
+    bool shutdownRequested;
+    std::thread flusher;
+};
+
+} // namespace RTBKIT
@@ -0,0 +1,41 @@
+/* allocation_counter.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Counts the allocations made by a benchmark.
+*/
+
+#include "allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+/** Per thread, so that counting doesn't make every allocation in the
+    program contend on one cache line.
+*/
+__thread uint64_t allocations = 0;
+
+} // file scope
+
+void * operator new(std::size_t size)
+{
+    ++allocations;
+    void * result = malloc(size ? size : 1);
+    if (!result) throw std::bad_alloc();
+    return result;
+}
+
+void operator delete(void * ptr) noexcept
+{
+    free(ptr);
+}
+
+namespace RTBKIT {
+
+uint64_t numAllocations()
+{
+    return allocations;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,21 @@
+/* allocation_counter.h                                            -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Counts the allocations made by a benchmark.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+namespace RTBKIT {
+
+/** Number of calls to the global operator new made so far by the calling
+    thread.
+
+    Linking the allocation_counter library replaces the global operator new
+    and delete of the whole program, so it is meant for benchmarks only.
+*/
+uint64_t numAllocations();
+
+} // namespace RTBKIT
@@ -0,0 +1,239 @@
+/* auction_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the resolution of the responses to an auction.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/auction.h"
+#include <thread>
+#include <atomic>
+#include <set>
+
+using namespace std;
+using namespace RTBKIT;
+
+namespace {
+
+typedef Auction::WinLoss WinLoss;
+
+struct AuctionFixture {
+    AuctionFixture(int numSpots = 1)
+        : numHandled(0)
+    {
+        auto request = std::make_shared<BidRequest>();
+        request->imp.resize(numSpots);
+
+        Date now = Date::now();
+        auction = std::make_shared<Auction>(
+                nullptr,
+                [&] (std::shared_ptr<Auction>) { ++numHandled; },
+                request, "", "", now, now.plusSeconds(0.1));
+    }
+
+    Auction::Response response(const string & agent, float priority,
+                                int price = 1000)
+    {
+        return Auction::Response(
+                Auction::Price(MicroUSD(price), priority), 1,
+                AccountKey("campaign:" + agent), false, agent);
+    }
+
+    std::shared_ptr<Auction> auction;
+    std::atomic<int> numHandled;
+};
+
+/** Agents of the responses to the given spot, in the order they're listed. */
+vector<string> agents(const Auction & auction, int spot)
+{
+    vector<string> result;
+    for (auto & response: auction.getResponses().at(spot))
+        result.push_back(response.agent);
+    return result;
+}
+
+typedef vector<string> Agents;
+
+} // file scope
+
+
+BOOST_FIXTURE_TEST_CASE( test_highest_priority_wins, AuctionFixture )
+{
+    BOOST_CHECK_EQUAL(auction->setResponse(0, response("low", 0.1)).val,
+                      WinLoss::PENDING);
+    BOOST_CHECK_EQUAL(auction->setResponse(0, response("high", 0.9)).val,
+                      WinLoss::PENDING);
+    BOOST_CHECK_EQUAL(auction->setResponse(0, response("mid", 0.5)).val,
+                      WinLoss::PENDING);
+
+    // Negative priorities sort below positive ones
+    auction->setResponse(0, response("negative", -1.0));
+
+    BOOST_CHECK(auction->finish());
+    BOOST_CHECK_EQUAL(numHandled, 1);
+
+    auto & responses = auction->getResponses()[0];
+    BOOST_REQUIRE_EQUAL(responses.size(), 4);
+    BOOST_CHECK_EQUAL(responses[0].agent, "high");
+    BOOST_CHECK_EQUAL(responses[0].localStatus.val, WinLoss::WIN);
+    for (unsigned i = 1;  i < responses.size();  ++i)
+        BOOST_CHECK_EQUAL(responses[i].localStatus.val, WinLoss::LOSS);
+}
+
+BOOST_FIXTURE_TEST_CASE( test_tie_goes_to_first, AuctionFixture )
+{
+    auction->setResponse(0, response("first", 0.5));
+    auction->setResponse(0, response("second", 0.5));
+    auction->setResponse(0, response("third", 0.5));
+    auction->finish();
+
+    BOOST_CHECK(agents(*auction, 0) == Agents({ "first", "second", "third" }));
+}
+
+BOOST_FIXTURE_TEST_CASE( test_losers_in_arrival_order, AuctionFixture )
+{
+    auction->setResponse(0, response("a", 0.3));
+    auction->setResponse(0, response("b", 0.1));
+    auction->setResponse(0, response("winner", 0.9));
+    auction->setResponse(0, response("c", 0.2));
+    auction->setResponse(0, response("d", 0.5));
+    auction->finish();
+
+    BOOST_CHECK(agents(*auction, 0)
+                == Agents({ "winner", "a", "b", "c", "d" }));
+}
+
+BOOST_AUTO_TEST_CASE( test_spots_are_separate )
+{
+    AuctionFixture fixture(2);
+    auto & auction = fixture.auction;
+
+    auction->setResponse(1, fixture.response("b", 0.5));
+    auction->setResponse(0, fixture.response("a", 0.1));
+    auction->setResponse(1, fixture.response("c", 0.7));
+
+    BOOST_CHECK_THROW(auction->setResponse(2, fixture.response("d", 1.0)),
+                      ML::Exception);
+
+    auction->finish();
+
+    BOOST_CHECK(agents(*auction, 0) == Agents({ "a" }));
+    BOOST_CHECK(agents(*auction, 1) == Agents({ "c", "b" }));
+}
+
+BOOST_FIXTURE_TEST_CASE( test_pending_view, AuctionFixture )
+{
+    auction->setResponse(0, response("a", 0.1));
+    BOOST_CHECK(agents(*auction, 0) == Agents({ "a" }));
+    BOOST_CHECK_EQUAL(auction->getResponses()[0][0].localStatus.val,
+                      WinLoss::PENDING);
+
+    auction->setResponse(0, response("b", 0.2));
+    BOOST_CHECK(agents(*auction, 0) == Agents({ "b", "a" }));
+}
+
+BOOST_FIXTURE_TEST_CASE( test_too_late_after_finish, AuctionFixture )
+{
+    auction->setResponse(0, response("early", 0.1));
+    BOOST_CHECK(auction->finish());
+    BOOST_CHECK(auction->tooLate());
+
+    BOOST_CHECK_EQUAL(auction->setResponse(0, response("late", 0.9)).val,
+                      WinLoss::TOOLATE);
+
+    // Only finished once
+    BOOST_CHECK(!auction->finish());
+    BOOST_CHECK(!auction->setError("error"));
+    BOOST_CHECK_EQUAL(numHandled, 1);
+
+    BOOST_CHECK(agents(*auction, 0) == Agents({ "early" }));
+}
+
+BOOST_FIXTURE_TEST_CASE( test_invalid_responses, AuctionFixture )
+{
+    BOOST_CHECK_EQUAL(auction->setResponse(0, response("", 0.5)).val,
+                      WinLoss::INVALID);
+    BOOST_CHECK_EQUAL(auction->setResponse(0, response("a", 0.5, -1)).val,
+                      WinLoss::INVALID);
+
+    auction->finish();
+    BOOST_CHECK(agents(*auction, 0).empty());
+}
+
+BOOST_FIXTURE_TEST_CASE( test_set_error, AuctionFixture )
+{
+    auction->setResponse(0, response("a", 0.1));
+    auction->setResponse(0, response("b", 0.9));
+
+    BOOST_CHECK(auction->setError("timeout", "no response"));
+    BOOST_CHECK_EQUAL(numHandled, 1);
+    BOOST_CHECK(!auction->finish());
+
+    const Auction::Data * data = auction->getCurrentData();
+    BOOST_CHECK(data->tooLate);
+    BOOST_CHECK(data->hasError());
+    BOOST_CHECK_EQUAL(data->error, "timeout");
+    BOOST_CHECK_EQUAL(data->details, "no response");
+
+    // Nobody wins an auction that errored
+    BOOST_CHECK(agents(*auction, 0) == Agents({ "b", "a" }));
+    for (auto & response: data->responses[0])
+        BOOST_CHECK_EQUAL(response.localStatus.val, WinLoss::LOSS);
+
+    BOOST_CHECK_EQUAL(auction->getResponseJson(0)["error"].asString(),
+                      "timeout");
+}
+
+BOOST_FIXTURE_TEST_CASE( test_concurrent_responses_and_finish, AuctionFixture )
+{
+    enum { NumThreads = 8, PerThread = 1000 };
+
+    std::atomic<bool> go(false);
+    std::atomic<int> accepted(0), tooLate(0);
+
+    auto runThread = [&] (int thread)
+        {
+            while (!go) ;
+
+            for (int i = 0;  i < PerThread;  ++i) {
+                string agent = to_string(thread) + ":" + to_string(i);
+                float priority = (thread * PerThread + i) % 997;
+                int status
+                    = auction->setResponse(0, response(agent, priority)).val;
+                if (status == WinLoss::PENDING) ++accepted;
+                else if (status == WinLoss::TOOLATE) ++tooLate;
+            }
+        };
+
+    vector<thread> threads;
+    for (int i = 0;  i < NumThreads;  ++i)
+        threads.emplace_back(runThread, i);
+
+    go = true;
+
+    // Let some responses in before closing the auction
+    while (accepted < NumThreads * PerThread / 4) ;
+    BOOST_CHECK(auction->finish());
+
+    for (auto & th: threads)
+        th.join();
+
+    BOOST_CHECK_EQUAL(accepted + tooLate, NumThreads * PerThread);
+    BOOST_CHECK_EQUAL(numHandled, 1);
+
+    // Every accepted response is in the final view, exactly once, and the
+    // winner has the highest priority amongst them.
+    auto & responses = auction->getResponses()[0];
+    BOOST_REQUIRE_EQUAL(responses.size(), accepted);
+
+    set<string> seen;
+    for (auto & response: responses) {
+        BOOST_CHECK(seen.insert(response.agent).second);
+        BOOST_CHECK_LE(response.price.priority,
+                       responses[0].price.priority);
+    }
+    BOOST_CHECK_EQUAL(responses[0].localStatus.val, WinLoss::WIN);
+}
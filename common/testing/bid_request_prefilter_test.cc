@@ -0,0 +1,66 @@
+/* bid_request_prefilter_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the load shedding pre-filter.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/bid_request_prefilter.h"
+
+using namespace std;
+using namespace RTBKIT;
+
+namespace {
+
+BidRequest makeRequest(Date timestamp, Format format)
+{
+    BidRequest request;
+    request.timestamp = timestamp;
+    AdSpot spot;
+    spot.formats.push_back(format);
+    request.imp.push_back(spot);
+    return request;
+}
+
+} // file scope
+
+BOOST_AUTO_TEST_CASE( test_prefilter_formats )
+{
+    Date now = Date::now();
+    BidRequestPreFilter filter;
+
+    // No agent: nothing can be bid on
+    BOOST_CHECK(!filter.accept(makeRequest(now, Format(300, 250))));
+
+    AgentConfig config;
+    config.creatives.push_back(Creative(300, 250));
+    filter.addAgent(config);
+
+    BOOST_CHECK(filter.accept(makeRequest(now, Format(300, 250))));
+    BOOST_CHECK(!filter.accept(makeRequest(now, Format(728, 90))));
+
+    // A 0x0 creative fits every spot
+    AgentConfig any;
+    any.creatives.push_back(Creative(0, 0));
+    filter.addAgent(any);
+    BOOST_CHECK(filter.accept(makeRequest(now, Format(728, 90))));
+}
+
+BOOST_AUTO_TEST_CASE( test_prefilter_hour_of_week )
+{
+    Date now = Date::now();
+    BidRequestPreFilter filter;
+
+    AgentConfig config;
+    config.creatives.push_back(Creative(300, 250));
+    config.hourOfWeekFilter.hourBitmap.reset();
+    config.hourOfWeekFilter.hourBitmap.set(now.hourOfWeek());
+    filter.addAgent(config);
+
+    BOOST_CHECK(filter.accept(makeRequest(now, Format(300, 250))));
+    BOOST_CHECK(!filter.accept(makeRequest(now.plusSeconds(3600),
+                                           Format(300, 250))));
+}
@@ -0,0 +1,76 @@
+/* bids_binary_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the binary encoding of bid responses.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/bids.h"
+
+using namespace std;
+using namespace RTBKIT;
+
+BOOST_AUTO_TEST_CASE( test_bids_binary_round_trip )
+{
+    Bids bids;
+
+    Bid bid;
+    bid.spotIndex = 0;
+    bid.availableCreatives.push_back(2);
+    bid.bid(2, USD_CPM(1.5), 0.25);
+    bid.account = AccountKey("campaign:strategy");
+    bids.push_back(bid);
+
+    Bid pass;
+    pass.spotIndex = 1;
+    bids.push_back(pass);
+
+    bids.dataSources.insert("redis");
+
+    string encoded = bids.toBinary();
+    BOOST_CHECK(Bids::isBinary(encoded));
+    BOOST_CHECK(!Bids::isBinary(bids.toJson().toString()));
+
+    Bids decoded = Bids::fromBinary(encoded.data(), encoded.size());
+    BOOST_CHECK_EQUAL(decoded.toJson().toString(), bids.toJson().toString());
+
+    BOOST_REQUIRE_EQUAL(decoded.size(), 2);
+    BOOST_CHECK_EQUAL(decoded[0].creativeIndex, 2);
+    BOOST_CHECK_EQUAL(decoded[0].price, USD_CPM(1.5));
+    BOOST_CHECK_EQUAL(decoded[0].priority, 0.25);
+    BOOST_CHECK(decoded[1].isNullBid());
+    BOOST_CHECK_EQUAL(decoded[1].spotIndex, 1);
+
+    // Truncated messages are rejected
+    BOOST_CHECK_THROW(Bids::fromBinary(encoded.data(), encoded.size() - 1),
+                      std::exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_bids_binary_invalid_bids )
+{
+    // A priced bid without a creative isn't a pass; it has to reach the
+    // router as is so that it gets rejected there.
+    Bids bids;
+    Bid bid;
+    bid.spotIndex = 0;
+    bid.price = USD_CPM(2);
+    bids.push_back(bid);
+
+    string encoded = bids.toBinary();
+    Bids decoded = Bids::fromBinary(encoded.data(), encoded.size());
+    BOOST_REQUIRE_EQUAL(decoded.size(), 1);
+    BOOST_CHECK(!decoded[0].isNullBid());
+    BOOST_CHECK_EQUAL(decoded[0].creativeIndex, -1);
+    BOOST_CHECK_EQUAL(decoded[0].price, USD_CPM(2));
+
+    // Indexes that don't fit in the encoding are refused
+    bids[0].spotIndex = 40000;
+    BOOST_CHECK_THROW(bids.toBinary(), ML::Exception);
+
+    bids[0].spotIndex = 0;
+    bids[0].creativeIndex = -40000;
+    BOOST_CHECK_THROW(bids.toBinary(), ML::Exception);
+}
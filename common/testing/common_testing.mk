@@ -1,6 +1,12 @@
 $(eval $(call library,bid_test_utils,exchange_source.cc,bid_request rtb))
+$(eval $(call library,allocation_counter,allocation_counter.cc,))
 
 $(eval $(call library,bid_request_synth,bid_request_synth.cc,arch utils jsoncpp))
 $(eval $(call test,bid_request_synth_test,bid_request_synth,boost))
 $(eval $(call test,currency_test,bid_request,boost))
 $(eval $(call test,filter_test,filter_registry,boost))
+$(eval $(call test,log_record_test,rtb,boost))
+$(eval $(call test,bid_request_prefilter_test,rtb agent_configuration,boost))
+$(eval $(call test,bids_binary_test,rtb,boost))
+$(eval $(call test,auction_test,rtb,boost))
+$(eval $(call test,metric_registry_test,rtb services,boost))
@@ -59,3 +59,29 @@ BOOST_AUTO_TEST_CASE( currencyValues )
     // precision issue i.e. the value is rounded to the closed 1K
     BOOST_CHECK_EQUAL(1000, (double) MicroUSD_CPM(1000));
 }
+
+BOOST_AUTO_TEST_CASE( currencyPool )
+{
+    CurrencyPool pool;
+    pool += Amount(CurrencyCode::CC_USD, 10);
+    pool += Amount(CurrencyCode::CC_IMP, 2);
+    pool += Amount(CurrencyCode::CC_USD, 5);
+    pool -= Amount(CurrencyCode::CC_IMP, 1);
+
+    // Entries are kept sorted by currency code whatever the insertion order.
+    BOOST_CHECK_EQUAL(pool.currencyAmounts.size(), 2u);
+    BOOST_CHECK(pool.currencyAmounts[0].currencyCode == CurrencyCode::CC_IMP);
+    BOOST_CHECK_EQUAL(pool.getAvailable(CurrencyCode::CC_IMP).value, 1);
+    BOOST_CHECK_EQUAL(pool.getAvailable(CurrencyCode::CC_USD).value, 15);
+
+    CurrencyPool other(Amount(CurrencyCode::CC_IMP, 1));
+    other += Amount(CurrencyCode::CC_USD, 15);
+    BOOST_CHECK_EQUAL(pool, other);
+
+    // A zero entry is the same as a missing one.
+    other -= Amount(CurrencyCode::CC_IMP, 1);
+    BOOST_CHECK_EQUAL(other, MicroUSD(15));
+    BOOST_CHECK_NE(pool, other);
+
+    BOOST_CHECK_EQUAL(CurrencyPool::fromJson(pool.toJson()), pool);
+}
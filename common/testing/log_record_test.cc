@@ -0,0 +1,114 @@
+/* log_record_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the binary log record encoding.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/log_record.h"
+#include "jml/arch/exception.h"
+
+using namespace std;
+using namespace RTBKIT;
+
+BOOST_AUTO_TEST_CASE( test_log_record_round_trip )
+{
+    Date now = Date::fromSecondsSinceEpoch(1368153863.008756);
+    Id auctionId("85885bb0-b91b-11e2-c4cf-7fba90171555");
+    Json::Value meta;
+    meta["foo"] = "bar";
+
+    string encoded = LogRecord::encode("BID", now, "agent", auctionId,
+                                       meta, 42);
+    BOOST_CHECK(LogRecord::isRecord(encoded.c_str(), encoded.size()));
+
+    LogRecord record = LogRecord::decode(encoded);
+    BOOST_CHECK_EQUAL(record.channel, LC_BID);
+    BOOST_CHECK_EQUAL(record.channelName, "BID");
+    BOOST_CHECK_EQUAL(record.timestamp.print(5), now.print(5));
+    BOOST_REQUIRE_EQUAL(record.fields.size(), 4);
+    BOOST_CHECK_EQUAL(record.fields[0].first, LogRecord::FT_STRING);
+    BOOST_CHECK_EQUAL(record.fields[0].second, "agent");
+    BOOST_CHECK_EQUAL(record.fields[1].first, LogRecord::FT_ID);
+    BOOST_CHECK_EQUAL(record.fields[1].second, auctionId.toString());
+    BOOST_CHECK_EQUAL(record.fields[2].first, LogRecord::FT_JSON);
+    BOOST_CHECK_EQUAL(record.fields[2].second, meta.toString());
+    BOOST_CHECK_EQUAL(record.fields[3].first, LogRecord::FT_INT);
+    BOOST_CHECK_EQUAL(record.fields[3].second, "42");
+
+    vector<string> text = record.toText();
+    BOOST_REQUIRE_EQUAL(text.size(), 6);
+    BOOST_CHECK_EQUAL(text[0], "BID");
+    BOOST_CHECK_EQUAL(text[1], now.print(5));
+    BOOST_CHECK_EQUAL(text[2], "agent");
+}
+
+BOOST_AUTO_TEST_CASE( test_log_record_other_channel )
+{
+    string encoded = LogRecord::encode("MATCHEDCLICK", Date::now(),
+                                       string(300, 'x'));
+    LogRecord record = LogRecord::decode(encoded);
+    BOOST_CHECK_EQUAL(record.channel, LC_OTHER);
+    BOOST_CHECK_EQUAL(record.channelName, "MATCHEDCLICK");
+    BOOST_REQUIRE_EQUAL(record.fields.size(), 1);
+    BOOST_CHECK_EQUAL(record.fields[0].second, string(300, 'x'));
+
+    // Text messages start with a printed date and are never records
+    string text = Date::now().print(5);
+    BOOST_CHECK(!LogRecord::isRecord(text.c_str(), text.size()));
+
+    // Truncated records are rejected
+    BOOST_CHECK_THROW(LogRecord::decode(encoded.substr(0, encoded.size() - 1)),
+                      ML::Exception);
+}
+
+BOOST_AUTO_TEST_CASE( test_log_record_string_list )
+{
+    Date now = Date::fromSecondsSinceEpoch(1368153863.008756);
+    vector<string> message = { "BID", "auction", "{}" };
+
+    string encoded = LogRecord::encode("ROUTERERROR", now, "handleAgentMessage",
+                                       "unknown agent", message);
+    LogRecord record = LogRecord::decode(encoded);
+
+    // One field per element, so the text is the same as the text message's
+    BOOST_REQUIRE_EQUAL(record.fields.size(), 5);
+    vector<string> text = record.toText();
+    vector<string> expected = { "ROUTERERROR", now.print(5),
+                                "handleAgentMessage", "unknown agent",
+                                "BID", "auction", "{}" };
+    BOOST_CHECK(text == expected);
+
+    encoded = LogRecord::encode("ERROR", now, vector<string>(), "end");
+    record = LogRecord::decode(encoded);
+    BOOST_REQUIRE_EQUAL(record.fields.size(), 1);
+    BOOST_CHECK_EQUAL(record.fields[0].second, "end");
+}
+
+BOOST_AUTO_TEST_CASE( test_log_record_numbers )
+{
+    // Numbers are encoded with their type and render like the text
+    // messages do, through logField()
+    Date now = Date::fromSecondsSinceEpoch(1368153863.008756);
+    uint64_t count = 12345678901234ULL;
+    float probability = 0.25;
+
+    string encoded = LogRecord::encode("USAGE", now, "ROUTER", count, -3,
+                                       probability, 1.5);
+    LogRecord record = LogRecord::decode(encoded);
+    BOOST_REQUIRE_EQUAL(record.fields.size(), 5);
+    BOOST_CHECK_EQUAL(record.fields[1].first, LogRecord::FT_UINT);
+    BOOST_CHECK_EQUAL(record.fields[2].first, LogRecord::FT_INT);
+    BOOST_CHECK_EQUAL(record.fields[3].first, LogRecord::FT_DOUBLE);
+
+    vector<string> text = record.toText();
+    vector<string> expected = { "USAGE", now.print(5), "ROUTER",
+                                logField(count), logField(-3),
+                                logField(probability), logField(1.5) };
+    BOOST_CHECK(text == expected);
+    BOOST_CHECK_EQUAL(text[3], "12345678901234");
+    BOOST_CHECK_EQUAL(text[4], "-3");
+}
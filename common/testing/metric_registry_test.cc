@@ -0,0 +1,225 @@
+/* metric_registry_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the metric registry.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/common/metric_registry.h"
+#include "jml/arch/format.h"
+#include <thread>
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+/** Keeps the total of the counts and the last level of every key. */
+struct RecordingEventService : public EventService {
+
+    virtual void onEvent(const std::string & name,
+                         const char * event,
+                         EventType type,
+                         float value,
+                         std::initializer_list<int> extra)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (type == ET_COUNT) counts[event] += value;
+        else if (type == ET_LEVEL) levels[event].push_back(value);
+    }
+
+    virtual std::map<std::string, double> get(std::ostream & output) const
+    {
+        return std::map<std::string, double>();
+    }
+
+    double count(const std::string & key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return counts.count(key) ? counts[key] : 0.0;
+    }
+
+    vector<float> levelsOf(const std::string & key)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return levels[key];
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        counts.clear();
+        levels.clear();
+    }
+
+    std::mutex lock;
+    std::map<std::string, double> counts;
+    std::map<std::string, vector<float> > levels;
+};
+
+std::shared_ptr<ServiceProxies>
+makeProxies(std::shared_ptr<EventService> service)
+{
+    auto proxies = std::make_shared<ServiceProxies>();
+    proxies->events = service;
+    return proxies;
+}
+
+struct RegistryFixture {
+    RegistryFixture()
+        : service(std::make_shared<RecordingEventService>()),
+          proxies(makeProxies(service)),
+          events("test", proxies)
+    {
+    }
+
+    std::shared_ptr<RecordingEventService> service;
+    std::shared_ptr<ServiceProxies> proxies;
+    EventRecorder events;
+};
+
+} // file scope
+
+
+BOOST_FIXTURE_TEST_CASE( test_counter_from_many_threads, RegistryFixture )
+{
+    enum { NumThreads = 8, NumHits = 100000 };
+
+    MetricRegistry registry(events);
+
+    // Asking twice for a key gives the same counter
+    auto counter = registry.counter("hits");
+    auto sameCounter = registry.counter("hits");
+    auto other = registry.counter("other");
+
+    vector<thread> threads;
+    for (int i = 0;  i < NumThreads;  ++i) {
+        threads.emplace_back([&] ()
+            {
+                for (int j = 0;  j < NumHits;  ++j) {
+                    counter.hit();
+                    sameCounter.hit(2);
+                }
+                other.hit();
+            });
+    }
+
+    // Flushes while the threads are running don't lose anything
+    registry.flush();
+
+    for (auto & th: threads)
+        th.join();
+    registry.flush();
+
+    BOOST_CHECK_EQUAL(service->count("hits"), NumThreads * NumHits * 3);
+    BOOST_CHECK_EQUAL(service->count("other"), NumThreads);
+
+    // Only the deltas are published
+    service->clear();
+    registry.flush();
+    BOOST_CHECK(service->counts.empty());
+
+    counter.hit(5);
+    registry.flush();
+    BOOST_CHECK_EQUAL(service->count("hits"), 5);
+}
+
+BOOST_FIXTURE_TEST_CASE( test_gauge, RegistryFixture )
+{
+    MetricRegistry registry(events);
+    auto gauge = registry.gauge("level");
+
+    gauge.set(1.0);
+    gauge.set(2.5);
+    registry.flush();
+    registry.flush();
+
+    // Only the last value, and only once
+    BOOST_CHECK(service->levelsOf("level") == vector<float>({ 2.5 }));
+}
+
+BOOST_FIXTURE_TEST_CASE( test_registry_recreated, RegistryFixture )
+{
+    // More registries than the per thread cache holds, each one likely to
+    // land where the previous one was; none may see another's counts.
+    for (int i = 0;  i < 20;  ++i) {
+        MetricRegistry registry(events);
+        string key = ML::format("registry%d", i);
+        auto counter = registry.counter(key);
+
+        counter.hit(i + 1);
+        std::thread([&] () { counter.hit(100); }).join();
+        registry.flush();
+
+        BOOST_CHECK_EQUAL(service->count(key), i + 101);
+    }
+
+    // A registry flushes when it shuts down
+    {
+        MetricRegistry registry(events, 3600);
+        registry.start();
+        registry.counter("last").hit();
+    }
+    BOOST_CHECK_EQUAL(service->count("last"), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE( test_thread_rotating_registries, RegistryFixture )
+{
+    // A thread going round more registries than its cache holds keeps one
+    // set of counters per registry instead of a new one per eviction.
+    enum { NumRegistries = 12, NumRounds = 50 };
+
+    vector<std::unique_ptr<MetricRegistry> > registries;
+    vector<MetricRegistry::Counter> counters;
+    for (int i = 0;  i < NumRegistries;  ++i) {
+        registries.emplace_back(new MetricRegistry(events));
+        counters.push_back(registries.back()->counter
+                           (ML::format("rotating%d", i)));
+    }
+
+    std::thread([&] ()
+        {
+            for (int round = 0;  round < NumRounds;  ++round)
+                for (auto & counter: counters)
+                    counter.hit();
+        }).join();
+
+    for (int i = 0;  i < NumRegistries;  ++i) {
+        registries[i]->flush();
+        BOOST_CHECK_EQUAL(registries[i]->numThreads(), 1);
+        BOOST_CHECK_EQUAL(service->count(ML::format("rotating%d", i)),
+                          NumRounds);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE( test_capacity, RegistryFixture )
+{
+    MetricRegistry registry(events);
+
+    // The overflow counter takes up one of the places
+    for (int i = 1;  i < MetricRegistry::MaxCounters;  ++i)
+        registry.counter(ML::format("counter%d", i)).hit();
+
+    auto tooMany = registry.counter("tooMany");
+    tooMany.hit(3);
+    registry.counter("tooManyAgain").hit(4);
+
+    for (int i = 0;  i < MetricRegistry::MaxGauges;  ++i)
+        registry.gauge(ML::format("gauge%d", i)).set(i);
+    registry.gauge("tooManyGauges").set(1.0);
+
+    registry.flush();
+
+    BOOST_CHECK_EQUAL(service->count("counter1"), 1);
+    BOOST_CHECK_EQUAL(service->count(ML::format("counter%d",
+                                       MetricRegistry::MaxCounters - 1)), 1);
+    BOOST_CHECK_EQUAL(service->count("tooMany"), 0);
+    BOOST_CHECK_EQUAL(service->count("metrics.overflow"), 7);
+
+    BOOST_CHECK_EQUAL(service->levelsOf("gauge1").size(), 1);
+    BOOST_CHECK(service->levelsOf("tooManyGauges").empty());
+}
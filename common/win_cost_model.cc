@@ -9,6 +9,7 @@
 #include "jml/arch/format.h"
 #include "jml/arch/spinlock.h"
 
+#include <boost/algorithm/string/trim.hpp>
 #include <dlfcn.h>
 #include <unordered_map>
 #include <mutex>
@@ -24,6 +25,14 @@ std::unordered_map<std::string, WinCostModel::Model> models;
 typedef ML::Spinlock lock_type;
 ML::Spinlock lock;
 
+/// Returns the registered model or null, without trying to load it.  Entries
+/// are never removed so the pointer stays valid.
+WinCostModel::Model const * findModel(std::string const & name) {
+    std::lock_guard<lock_type> guard(lock);
+    auto i = models.find(name);
+    return i == models.end() ? nullptr : &i->second;
+}
+
 WinCostModel::Model const & getModel(std::string const & name) {
     // see if it's already existing
     {
@@ -66,15 +75,26 @@ struct AtInit {
 } // file scope
 
 WinCostModel::
-WinCostModel()
+WinCostModel() :
+    impl(nullptr)
 {
 }
 
 WinCostModel::
 WinCostModel(std::string name, Json::Value data) :
     name(std::move(name)),
-    data(std::move(data))
+    data(std::move(data)),
+    impl(nullptr)
+{
+    resolve();
+}
+
+void
+WinCostModel::
+resolve()
 {
+    impl = name.empty() ? nullptr : findModel(name);
+    implName = name;
 }
 
 Amount
@@ -85,7 +105,11 @@ evaluate(Bid const & bid, Amount const & price) const
         return NoWinCostModel::evaluate(*this, bid, price);
     }
 
-    auto model = getModel(name);
+    if(impl && implName == name) {
+        return (*impl)(*this, bid, price);
+    }
+
+    auto const & model = getModel(name);
     if(!model) {
         throw ML::Exception("win cost model '%s' not found", name.c_str());
     }
@@ -107,6 +131,20 @@ toJson() const
     return result;
 }
 
+std::string
+WinCostModel::
+toJsonStr() const
+{
+    if(name.empty()) {
+        return "null";
+    }
+
+    Json::FastWriter writer;
+    std::string result = writer.write(toJson());
+    boost::trim(result);
+    return result;
+}
+
 WinCostModel
 WinCostModel::
 fromJson(Json::Value const & json)
@@ -124,6 +162,7 @@ fromJson(Json::Value const & json)
                                 i.memberName());
     }
 
+    result.resolve();
     return result;
 }
 
@@ -146,6 +185,7 @@ reconstitute(ML::DB::Store_Reader & store)
         if(!text.empty()) {
             data = Json::parse(text);
         }
+        resolve();
     }
     else {
         ML::Exception("reconstituting wrong version");
@@ -33,6 +33,11 @@ struct WinCostModel {
     Json::Value toJson() const;
     static WinCostModel fromJson(Json::Value const & json);
 
+    /// Compact JSON string used on the wire between the router and the
+    /// agents.  It is stable so that a model echoed back unchanged by an
+    /// agent can be recognized with a string comparison.
+    std::string toJsonStr() const;
+
     void serialize(ML::DB::Store_Writer & store) const;
     void reconstitute(ML::DB::Store_Reader & store);
 
@@ -51,6 +56,18 @@ struct WinCostModel {
 public:
     std::string name;
     Json::Value data;
+
+private:
+    /// Model function resolved from the registry when the model is built so
+    /// that evaluate doesn't need to look it up under the lock.  Null if the
+    /// name was unknown at that time; evaluate then does the full lookup.
+    Model const * impl;
+
+    /// Name that impl was resolved from.  name is public and may be assigned
+    /// after construction, in which case impl is stale and isn't used.
+    std::string implName;
+
+    void resolve();
 };
 
 IMPL_SERIALIZE_RECONSTITUTE(WinCostModel);
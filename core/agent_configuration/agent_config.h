@@ -25,6 +25,40 @@ struct AgentStats;
 struct ExchangeConnector;
 
 
+/*****************************************************************************/
+/* CREATIVE CONSTRAINT                                                       */
+/*****************************************************************************/
+
+/** Restriction that an exchange puts on a creative, expressed as values of
+    the creative checked against a list carried by each impression of the
+    bid request (in AdSpot::restrictions).
+
+    Exchange connectors that describe their creative filtering this way have
+    the creatives indexed by the router when the agent is configured, rather
+    than bidRequestCreativeFilter() called on every creative of every
+    request.
+*/
+struct CreativeConstraint {
+    enum Type {
+        EXCLUDED,           ///< Fails if any value is in the list
+        ALLOWED,            ///< Fails if any value is missing from the list
+        ALLOWED_IF_LISTED   ///< As ALLOWED, but an empty list allows all
+    };
+
+    CreativeConstraint(const std::string & restriction = "",
+                       Type type = EXCLUDED)
+        : restriction(restriction), type(type)
+    {
+    }
+
+    std::string restriction;    ///< Key of the list in AdSpot::restrictions
+    Type type;
+    SegmentList values;         ///< Values of the creative
+};
+
+typedef std::vector<CreativeConstraint> CreativeConstraints;
+
+
 /*****************************************************************************/
 /* CREATIVE                                                                  */
 /*****************************************************************************/
@@ -70,6 +104,11 @@ struct Creative {
         return reinterpret_cast<const T *>(it->second.get());
     }
 
+    /// Constraints of the providers which can express them; see
+    /// CreativeConstraint.  Protected by the same lock as providerData.
+    std::map<std::string, std::shared_ptr<const CreativeConstraints> >
+        providerConstraints;
+
     /// Tags set on the creative for elibibility filtering
     Tags tags;
 
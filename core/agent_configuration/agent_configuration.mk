@@ -15,4 +15,5 @@ $(eval $(call library,agent_configuration,$(LIBAGENT_CONFIGURATION_SOURCES),$(LI
 $(eval $(call program,agent_configuration_service_runner,agent_configuration boost_program_options opstats))
 
 #$(eval $(call include_sub_make,rtb_router_testing,testing,rtb_router_testing.mk))
+$(eval $(call include_sub_make,agent_configuration_testing,testing,agent_configuration_testing.mk))
 
@@ -17,9 +17,9 @@ add(const BidRequest & bidRequest,
     const AgentConfig & config)
 {
     Entry entry;
-    entry.agent = agent;
-    entry.account = config.account;
-    entry.site = bidRequest.url.toString();
+    entry.agent = hashAgent(agent);
+    entry.account = config.account.hash();
+    entry.site = hashSite(bidRequest);
     entry.expiry = Date::now().plusSeconds(config.blacklistTime);
 
     entries.push_back(entry);
@@ -53,46 +53,59 @@ expire(Date now)
     return result;
 }
 
+uint64_t
+BlacklistInfo::
+hashSite(const BidRequest & request)
+{
+    std::string site = request.url.toString();
+    if (site.empty()) return 0;
+    uint64_t result = std::hash<std::string>()(site);
+    return result ? result : 1;
+}
+
 bool
 BlacklistInfo::
-matches(const BidRequest & bidRequest,
+matches(uint64_t site,
         const std::string & agent,
         const AgentConfig & config) const
 {
-    auto matchesEntry = [&] (const Entry & entry) -> bool
-        {
-            switch (config.blacklistScope) {
-                case BL_AGENT:
-                    return entry.agent == agent;
-                case BL_ACCOUNT:
-                    return entry.account == config.account;
-            default:
-                throw ML::Exception("invalid blacklist scope");
-            }
-        };
+    uint64_t key;
+    bool byAgent;
+
+    switch (config.blacklistScope) {
+    case BL_AGENT:
+        key = hashAgent(agent);
+        byAgent = true;
+        break;
+    case BL_ACCOUNT:
+        key = config.account.hash();
+        byAgent = false;
+        break;
+    default:
+        throw ML::Exception("invalid blacklist scope");
+    }
 
+    bool checkSite;
     switch (config.blacklistType) {
     case BL_OFF:
         return false;  // shouldn't happen
-
-    case BL_USER:  // fall through
-        for (unsigned i = 0;  i < entries.size();  ++i) {
-            const Entry & entry = entries[i];
-            if (matchesEntry(entry)) return true;
-        }
-
+    case BL_USER:
+        checkSite = false;
+        break;
     case BL_USER_SITE:
-        for (unsigned i = 0;  i < entries.size();  ++i) {
-            const Entry & entry = entries[i];
-            if (!matchesEntry(entry)) continue;
-            if (entry.site != "" && entry.site == bidRequest.url.toString())
-                return true;
-        }
-        return false;
-
+        if (site == 0) return false;
+        checkSite = true;
+        break;
     default:
         throw ML::Exception("unknown blacklist type");
     }
+
+    for (const Entry & entry: entries) {
+        if ((byAgent ? entry.agent : entry.account) != key) continue;
+        if (!checkSite || entry.site == site) return true;
+    }
+
+    return false;
 }
 
 void
@@ -110,34 +123,55 @@ doExpiries()
     entries.expire(onBlacklistFinished, start);
 }
 
-bool
+Blacklist::Lookup
 Blacklist::
-matches(const BidRequest & bidRequest, const std::string & agentName,
-        const AgentConfig & config) const
-{  
-    bool blocked = false;
+lookup(const BidRequest & bidRequest) const
+{
+    Lookup result;
+
+    // TODO: read lock
     const Id & exchangeId = bidRequest.userIds.exchangeId;
-    if (!blocked && exchangeId) {
-        // TODO: read lock
+    if (exchangeId) {
         auto bit = entries.find(exchangeId);
-        if (bit != entries.end()) {
-            const BlacklistInfo & binfo = bit->second;
-            if (binfo.matches(bidRequest, agentName, config))
-                blocked = true;
-        }
+        if (bit != entries.end())
+            result.exchangeUser = &bit->second;
     }
+
     const Id & providerId = bidRequest.userIds.providerId;
-    if (!blocked && providerId) {
-        // TODO: read lock
+    if (providerId) {
         auto bit = entries.find(providerId);
-        if (bit != entries.end()) {
-            const BlacklistInfo & binfo = bit->second;
-            if (binfo.matches(bidRequest, agentName, config))
-                blocked = true;
-        }
+        if (bit != entries.end())
+            result.providerUser = &bit->second;
     }
 
-    return blocked;
+    if (!result.empty())
+        result.site = BlacklistInfo::hashSite(bidRequest);
+
+    return result;
+}
+
+bool
+Blacklist::
+matches(const Lookup & lookup, const std::string & agentName,
+        const AgentConfig & config) const
+{
+    if (lookup.exchangeUser
+        && lookup.exchangeUser->matches(lookup.site, agentName, config))
+        return true;
+    if (lookup.providerUser
+        && lookup.providerUser->matches(lookup.site, agentName, config))
+        return true;
+    return false;
+}
+
+bool
+Blacklist::
+matches(const BidRequest & bidRequest, const std::string & agentName,
+        const AgentConfig & config) const
+{  
+    Lookup lookup = this->lookup(bidRequest);
+    if (lookup.empty()) return false;
+    return matches(lookup, agentName, config);
 }
 
 void
@@ -10,6 +10,7 @@
 
 #include <string>
 #include <vector>
+#include <functional>
 #include "rtbkit/common/bid_request.h"
 #include "rtbkit/core/router/router_types.h"
 #include "soa/service/timeout_map.h"
@@ -26,21 +27,40 @@ struct AgentConfig;
 
 /** For the given user, contains information on who has blacklisted them
     for how much time.
+
+    Entries only hold hashes of the agent, account and site so that a check
+    is a few integer compares per entry.  Two names with the same 64 bit
+    hash are therefore taken to be the same; that is rare enough to accept,
+    and it only makes an agent skip a user for the blacklist time.
 */
 struct BlacklistInfo {
     struct Entry {
-        std::string agent;
-        AccountKey account;
-        std::string site;
+        uint64_t agent;
+        uint64_t account;
+        uint64_t site;      ///< 0 if the request had no url
         Date expiry;
     };
     std::vector<Entry> entries;
     Date earliestExpiry;
 
-    /* Does the given agent and bid request match the blacklist? */
-    bool matches(const BidRequest & request,
+    static uint64_t hashAgent(const std::string & agent)
+    {
+        return std::hash<std::string>()(agent);
+    }
+
+    static uint64_t hashSite(const BidRequest & request);
+
+    /* Does the given agent and site match the blacklist? */
+    bool matches(uint64_t site,
                  const std::string & agent,
                  const AgentConfig & agentConfig) const;
+
+    bool matches(const BidRequest & request,
+                 const std::string & agent,
+                 const AgentConfig & agentConfig) const
+    {
+        return matches(hashSite(request), agent, agentConfig);
+    }
         
     /** Add the given entry to the blacklist.  Returns Date() if the
         entry is not the earliest expiring entry, or the date of the
@@ -71,6 +91,26 @@ struct Blacklist {
                  const std::string & agentName,
                  const AgentConfig & config) const;
 
+    /** The part of a check that only depends on the request: the entries of
+        its users and the hash of its site.  Done once per auction rather
+        than once per bidder.
+    */
+    struct Lookup {
+        Lookup() : exchangeUser(0), providerUser(0), site(0) {}
+
+        const BlacklistInfo * exchangeUser;
+        const BlacklistInfo * providerUser;
+        uint64_t site;
+
+        bool empty() const { return !exchangeUser && !providerUser; }
+    };
+
+    Lookup lookup(const BidRequest & request) const;
+
+    bool matches(const Lookup & lookup,
+                 const std::string & agentName,
+                 const AgentConfig & config) const;
+
     void add(const BidRequest & bidRequest,
              const std::string & agent,
              const AgentConfig & agentConfig);
@@ -0,0 +1,3 @@
+# agent_configuration_testing.mk
+
+$(eval $(call test,blacklist_test,agent_configuration,boost))
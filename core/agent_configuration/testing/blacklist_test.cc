@@ -0,0 +1,142 @@
+/* blacklist_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the hashed blacklist entries and the per auction lookup.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/agent_configuration/blacklist.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include <thread>
+#include <chrono>
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+BidRequest makeRequest(const string & user, const string & url = "")
+{
+    BidRequest request;
+    request.userIds.add(Id(user), ID_EXCHANGE);
+    if (!url.empty())
+        request.url = Url(url);
+    return request;
+}
+
+AgentConfig makeConfig(const string & account,
+                       BlacklistType type = BL_USER,
+                       BlacklistScope scope = BL_AGENT,
+                       double time = 60.0)
+{
+    AgentConfig config;
+    config.account = AccountKey(account);
+    config.blacklistType = type;
+    config.blacklistScope = scope;
+    config.blacklistTime = time;
+    return config;
+}
+
+} // file scope
+
+
+BOOST_AUTO_TEST_CASE( test_blacklist_hit_and_miss )
+{
+    Blacklist blacklist;
+    AgentConfig config = makeConfig("campaign:strategy");
+    AgentConfig otherAccount = makeConfig("campaign:other");
+
+    BidRequest request = makeRequest("user1", "http://example.com/");
+    blacklist.add(request, "agent1", config);
+    BOOST_CHECK_EQUAL(blacklist.size(), 1);
+
+    // Same user and agent
+    BOOST_CHECK(blacklist.matches(request, "agent1", config));
+
+    // The lookup done once per auction gives the same answers
+    Blacklist::Lookup lookup = blacklist.lookup(request);
+    BOOST_CHECK(!lookup.empty());
+    BOOST_CHECK(blacklist.matches(lookup, "agent1", config));
+    BOOST_CHECK(!blacklist.matches(lookup, "agent2", config));
+
+    // Other agent, other user
+    BOOST_CHECK(!blacklist.matches(request, "agent2", config));
+    BidRequest otherUser = makeRequest("user2", "http://example.com/");
+    BOOST_CHECK(blacklist.lookup(otherUser).empty());
+    BOOST_CHECK(!blacklist.matches(otherUser, "agent1", config));
+
+    // Account scope matches any agent of the account
+    AgentConfig byAccount = makeConfig("campaign:strategy", BL_USER,
+                                       BL_ACCOUNT);
+    BOOST_CHECK(blacklist.matches(request, "agent2", byAccount));
+    AgentConfig otherByAccount = makeConfig("campaign:other", BL_USER,
+                                            BL_ACCOUNT);
+    BOOST_CHECK(!blacklist.matches(request, "agent1", otherByAccount));
+    BOOST_CHECK(!blacklist.matches(request, "agent2", otherAccount));
+
+    // User and site: only the same site matches, and never without a url
+    AgentConfig bySite = makeConfig("campaign:strategy", BL_USER_SITE);
+    BOOST_CHECK(blacklist.matches(request, "agent1", bySite));
+    BOOST_CHECK(!blacklist.matches(makeRequest("user1", "http://other.com/"),
+                                   "agent1", bySite));
+    BOOST_CHECK(!blacklist.matches(makeRequest("user1"), "agent1", bySite));
+}
+
+BOOST_AUTO_TEST_CASE( test_blacklist_expiry )
+{
+    Blacklist blacklist;
+    AgentConfig shortConfig = makeConfig("campaign:strategy", BL_USER,
+                                         BL_AGENT, 0.01);
+    AgentConfig longConfig = makeConfig("campaign:strategy", BL_USER,
+                                        BL_AGENT, 60.0);
+
+    BidRequest request = makeRequest("user1");
+    blacklist.add(request, "agent1", shortConfig);
+    blacklist.add(request, "agent2", longConfig);
+    blacklist.add(makeRequest("user2"), "agent1", shortConfig);
+    BOOST_CHECK_EQUAL(blacklist.size(), 2);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    blacklist.doExpiries();
+
+    // user2 only had the short entry; user1 keeps the long one
+    BOOST_CHECK_EQUAL(blacklist.size(), 1);
+    BOOST_CHECK(!blacklist.matches(request, "agent1", shortConfig));
+    BOOST_CHECK(blacklist.matches(request, "agent2", longConfig));
+    BOOST_CHECK(blacklist.lookup(makeRequest("user2")).empty());
+
+    // Expiring an info returns its next expiry, or Date() once empty
+    BlacklistInfo info;
+    Date expiry = info.add(request, "agent1", longConfig);
+    BOOST_CHECK(expiry != Date());
+    BOOST_CHECK_EQUAL(info.expire(Date::now()), expiry);
+    BOOST_CHECK_EQUAL(info.expire(expiry.plusSeconds(1)), Date());
+    BOOST_CHECK(info.entries.empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_blacklist_hash_collision )
+{
+    // Entries only keep hashes, so a different agent whose name hashes to
+    // the same value is treated as blacklisted too.  This is accepted: with
+    // 64 bit hashes it is vanishingly rare and only costs a skipped bid.
+    AgentConfig config = makeConfig("campaign:strategy");
+    BidRequest request = makeRequest("user1");
+
+    BlacklistInfo info;
+    info.add(request, "agent1", config);
+    BOOST_REQUIRE_EQUAL(info.entries.size(), 1);
+    uint64_t site = BlacklistInfo::hashSite(request);
+
+    BOOST_CHECK(info.matches(site, "agent1", config));
+    BOOST_CHECK(!info.matches(site, "agent2", config));
+
+    // Make the entry look like it was added by an agent whose name collides
+    // with agent2's
+    info.entries[0].agent = BlacklistInfo::hashAgent("agent2");
+    BOOST_CHECK(info.matches(site, "agent2", config));
+    BOOST_CHECK(!info.matches(site, "agent1", config));
+}
@@ -247,6 +247,7 @@ PostAuctionLoop(std::shared_ptr<ServiceProxies> proxies,
                 const std::string & serviceName)
     : ServiceBase(serviceName, proxies),
       logger(getZmqContext()),
+      binaryLogs(false),
       monitorProviderClient(getZmqContext(), *this),
       auctions(65536),
       events(65536),
@@ -254,8 +255,10 @@ PostAuctionLoop(std::shared_ptr<ServiceProxies> proxies,
       router(!!getZmqContext()),
       toAgents(getZmqContext()),
       configListener(getZmqContext()),
-      loopMonitor(*this)
+      loopMonitor(*this),
+      metrics(*this)
 {
+    initMetrics();
 }
 
 PostAuctionLoop::
@@ -263,6 +266,7 @@ PostAuctionLoop(ServiceBase & parent,
                 const std::string & serviceName)
     : ServiceBase(serviceName, parent),
       logger(getZmqContext()),
+      binaryLogs(false),
       monitorProviderClient(getZmqContext(), *this),
       auctions(65536),
       events(65536),
@@ -270,8 +274,33 @@ PostAuctionLoop(ServiceBase & parent,
       router(!!getZmqContext()),
       toAgents(getZmqContext()),
       configListener(getZmqContext()),
-      loopMonitor(*this)
+      loopMonitor(*this),
+      metrics(*this)
 {
+    initMetrics();
+}
+
+void
+PostAuctionLoop::
+initMetrics()
+{
+    counters.auctionMessages = metrics.counter("messages.AUCTION");
+    counters.winMessages = metrics.counter("messages.WIN");
+    counters.lossMessages = metrics.counter("messages.LOSS");
+    counters.processedAuction = metrics.counter("processedAuction");
+    counters.processedWin = metrics.counter("processedWin");
+    counters.processedLoss = metrics.counter("processedLoss");
+
+    auto initBidResult = [&] (BidResultCounters & result, const char * type)
+        {
+            string prefix = string("bidResult.") + type + ".";
+            result.messagesReceived = metrics.counter(prefix + "messagesReceived");
+            result.messagesReplayed = metrics.counter(prefix + "messagesReplayed");
+            result.delivered = metrics.counter(prefix + "delivered");
+        };
+
+    initBidResult(counters.winResult, print(PAE_WIN));
+    initBidResult(counters.lossResult, print(PAE_LOSS));
 }
 
 void
@@ -373,6 +402,7 @@ start(std::function<void ()> onStop)
     loop.start(onStop);
     monitorProviderClient.start();
     loopMonitor.start();
+    metrics.start();
 }
 
 void
@@ -386,6 +416,7 @@ shutdown()
     endpoint.shutdown();
     configListener.shutdown();
     monitorProviderClient.shutdown();
+    metrics.shutdown();
 }
 
 Json::Value
@@ -495,7 +526,7 @@ void
 PostAuctionLoop::
 doAuctionMessage(const std::vector<std::string> & message)
 {
-    recordHit("messages.AUCTION");
+    counters.auctionMessages.hit();
     //cerr << "doAuctionMessage " << message << endl;
 
     auto event = Message<SubmittedAuctionEvent>::fromString(message.at(2));
@@ -508,7 +539,7 @@ void
 PostAuctionLoop::
 doWinMessage(const std::vector<std::string> & message)
 {
-    recordHit("messages.WIN");
+    counters.winMessages.hit();
     auto event = std::make_shared<PostAuctionEvent>
         (ML::DB::reconstituteFromString<PostAuctionEvent>(message.at(2)));
     doWinLoss(event, false /* replay */);
@@ -518,7 +549,7 @@ void
 PostAuctionLoop::
 doLossMessage(const std::vector<std::string> & message)
 {
-    recordHit("messages.LOSS");
+    counters.lossMessages.hit();
     auto event = std::make_shared<PostAuctionEvent>
         (ML::DB::reconstituteFromString<PostAuctionEvent>(message.at(2)));
     doWinLoss(event, false /* replay */);
@@ -777,7 +808,7 @@ PostAuctionLoop::
 doAuction(const SubmittedAuctionEvent & event)
 {
     try {
-        recordHit("processedAuction");
+        counters.processedAuction.hit();
 
         const Id & auctionId = event.auctionId;
 
@@ -886,20 +917,22 @@ doWinLoss(const std::shared_ptr<PostAuctionEvent> & event, bool isReplay)
     if (event->type == PAE_WIN) {
         ML::atomic_inc(numWins);
         status = BS_WIN;
-        recordHit("processedWin");
+        counters.processedWin.hit();
     }
     else {
         status = BS_LOSS;
         ML::atomic_inc(numLosses);
-        recordHit("processedLoss");
+        counters.processedLoss.hit();
     }
 
     const char * typeStr = print(event->type);
+    const BidResultCounters & bidResult
+        = event->type == PAE_WIN ? counters.winResult : counters.lossResult;
 
     if (!isReplay)
-        recordHit("bidResult.%s.messagesReceived", typeStr);
+        bidResult.messagesReceived.hit();
     else
-        recordHit("bidResult.%s.messagesReplayed", typeStr);
+        bidResult.messagesReplayed.hit();
 
     //cerr << "doWinLoss 1" << endl;
 
@@ -1067,7 +1100,7 @@ doWinLoss(const std::shared_ptr<PostAuctionEvent> & event, bool isReplay)
         return;
     }
 
-    recordHit("bidResult.%s.delivered", typeStr);
+    bidResult.delivered.hit();
 
     //cerr << "event.metadata = " << event->metadata << endl;
     //cerr << "event.winPrice = " << event->winPrice << endl;
@@ -13,6 +13,8 @@
 #include "soa/service/typed_message_channel.h"
 #include "rtbkit/common/auction.h"
 #include "rtbkit/common/auction_events.h"
+#include "rtbkit/common/log_record.h"
+#include "rtbkit/common/metric_registry.h"
 #include "soa/service/loop_monitor.h"
 #include "soa/service/zmq_endpoint.h"
 #include "soa/service/zmq_message_router.h"
@@ -219,13 +221,19 @@ struct PostAuctionLoop : public ServiceBase, public MonitorProvider
     
     ZmqNamedPublisher logger;
 
+    /** Publish log messages as binary LogRecords instead of text. */
+    bool binaryLogs;
+
     /** Log a given message to the given channel. */
     template<typename... Args>
     void logMessage(const std::string & channel, Args... args)
     {
         using namespace std;
         //cerr << "********* logging message to " << channel << endl;
-        logger.publish(channel, Date::now().print(5), args...);
+        if (binaryLogs)
+            logger.publish(channel,
+                           LogRecord::encode(channel, Date::now(), args...));
+        else logger.publish(channel, Date::now().print(5), logField(args)...);
     }
 
     /** Log a router error. */
@@ -234,8 +242,7 @@ struct PostAuctionLoop : public ServiceBase, public MonitorProvider
                     const std::string & exception,
                     Args... args)
     {
-        logger.publish("PAERROR", Date::now().print(5),
-                       function, exception, args...);
+        logMessage("PAERROR", function, exception, args...);
         recordHit("error.%s", function);
     }
 
@@ -467,6 +474,30 @@ private:
 
     AgentConfigurationListener configListener;
     LoopMonitor loopMonitor;
+
+    /** Metrics recorded for every message, with their handles resolved
+        once by initMetrics().
+    */
+    MetricRegistry metrics;
+
+    struct BidResultCounters {
+        MetricRegistry::Counter messagesReceived;
+        MetricRegistry::Counter messagesReplayed;
+        MetricRegistry::Counter delivered;
+    };
+
+    struct Counters {
+        MetricRegistry::Counter auctionMessages;
+        MetricRegistry::Counter winMessages;
+        MetricRegistry::Counter lossMessages;
+        MetricRegistry::Counter processedAuction;
+        MetricRegistry::Counter processedWin;
+        MetricRegistry::Counter processedLoss;
+        BidResultCounters winResult;
+        BidResultCounters lossResult;
+    } counters;
+
+    void initMetrics();
 };
 
 
@@ -22,10 +22,13 @@ using namespace RTBKIT;
 int main(int argc, char ** argv)
 {
     ServiceProxyArguments proxyArgs;
+    bool binaryLogs = false;
 
     options_description all_opt;
     all_opt.add(proxyArgs.makeProgramOptions());
     all_opt.add_options()
+        ("log-binary", value<bool>(&binaryLogs)->zero_tokens(),
+         "publish logs as binary records")
         ("help,h", "print this message");
     
     variables_map vm;
@@ -51,6 +54,7 @@ int main(int argc, char ** argv)
                                            + ".slaveBanker");
     banker->start();
 
+    service.binaryLogs = binaryLogs;
     service.init();
     service.setBanker(banker);
     service.bindTcp();
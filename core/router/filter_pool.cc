@@ -13,6 +13,7 @@
 #include "soa/service/service_base.h"
 #include "jml/utils/exc_check.h"
 #include "jml/arch/tick_counter.h"
+#include "jml/arch/format.h"
 
 
 using namespace std;
@@ -42,6 +43,21 @@ FilterPool::
 init(EventRecorder* events)
 {
     this->events = events;
+    if (!events) return;
+
+    metrics.reset(new MetricRegistry(*events));
+    metrics->start();
+
+    // Nothing is filtered before init so the current data can be updated in
+    // place.
+    resolveMetrics(*data.load());
+}
+
+void
+FilterPool::
+resolveMetrics(Data& data)
+{
+    if (metrics) data.resolveMetrics(*metrics);
 }
 
 
@@ -76,24 +92,22 @@ FilterPool::
 
 void
 FilterPool::
-recordDiff(const Data* data, const FilterBase* filter, const ConfigSet& diff)
+recordDiff(const FilterMetrics& metrics, const ConfigSet& diff)
 {
     for (size_t cfg = diff.next(); cfg < diff.size(); cfg = diff.next(cfg+1)) {
-        const AgentConfig& config = *data->configs[cfg].config;
-
-        events->recordHit("accounts.%s.filter.static.%s",
-                config.account.toString('.'), filter->name());
+        if (cfg < metrics.filtered.size())
+            metrics.filtered[cfg].hit();
     }
 }
 
 uint64_t
 FilterPool::
-recordTime(uint64_t start, const FilterBase* filter)
+recordTime(uint64_t start, const FilterMetrics& metrics)
 {
     uint64_t now = ticks();
     double us = ((now - start) / ticks_per_second) * 1000000.0;
 
-    events->recordLevel(us, "filters.timingUs.%s", filter->name());
+    events->recordEvent(metrics.timingKey.c_str(), ET_LEVEL, us);
 
     return now;
 }
@@ -113,23 +127,27 @@ filter(const BidRequest& br, const ExchangeConnector* conn, const ConfigSet& mas
 
     ConfigSet configs = state.configs();
 
-    bool sampleStats = events && (random() % 10 == 0);
-    uint64_t ticksStart = sampleStats ? ticks() : 0;
+    // Recording through the metric handles is cheap enough to be done on
+    // every request.  Timings still go to the EventRecorder as levels, so
+    // they stay sampled.
+    bool recordStats = !current->filterMetrics.empty();
+    bool sampleTiming = recordStats && (random() % 10 == 0);
+    uint64_t ticksStart = sampleTiming ? ticks() : 0;
 
-    for (FilterBase* filter : current->filters) {
-        filter->filter(state);
+    for (size_t i = 0; i < current->filters.size(); ++i) {
+        current->filters[i]->filter(state);
 
         const ConfigSet& filtered = state.configs();
 
-        if (sampleStats) {
-            ticksStart = recordTime(ticksStart, filter);
-            recordDiff(current, filter, configs ^ filtered);
+        if (recordStats) {
+            const FilterMetrics& metrics = current->filterMetrics[i];
+            if (sampleTiming) ticksStart = recordTime(ticksStart, metrics);
+            recordDiff(metrics, configs ^ filtered);
             configs = filtered;
         }
 
         if (filtered.empty()) {
-            if (sampleStats) 
-                events->recordHit("filters.breakLoop.%s", filter->name());
+            if (recordStats) current->filterMetrics[i].breakLoop.hit();
             break;
         }
     }
@@ -160,6 +178,7 @@ addFilter(const string& name)
     do {
         newData.reset(new Data(*oldData));
         newData->addFilter(FilterRegistry::makeFilter(name));
+        resolveMetrics(*newData);
     } while (!setData(oldData, newData));
 
     if (events) events->recordHit("filters.addFilter.%s", name);
@@ -178,6 +197,7 @@ removeFilter(const string& name)
     do {
         newData.reset(new Data(*oldData));
         newData->removeFilter(name);
+        resolveMetrics(*newData);
     } while (!setData(oldData, newData));
 
     if (events) events->recordHit("filters.removeFilter.%s", name);
@@ -197,6 +217,7 @@ addConfig(const string& name, const AgentInfo& info)
     do {
         newData.reset(new Data(*oldData));
         index = newData->addConfig(name, info);
+        resolveMetrics(*newData);
     } while (!setData(oldData, newData));
 
     if (events) events->recordHit("filters.addConfig");
@@ -217,6 +238,7 @@ removeConfig(const string& name)
     do {
         newData.reset(new Data(*oldData));
         newData->removeConfig(name);
+        resolveMetrics(*newData);
     } while (!setData(oldData, newData));
 
     if (events) events->recordHit("filters.removeConfig");
@@ -229,6 +251,7 @@ removeConfig(const string& name)
 
 FilterPool::Data::
 Data(const Data& other) :
+    filterMetrics(other.filterMetrics),
     configs(other.configs),
     activeConfigs(other.activeConfigs)
 {
@@ -329,4 +352,29 @@ removeFilter(const string& name)
     filters.pop_back();
 }
 
+void
+FilterPool::Data::
+resolveMetrics(MetricRegistry& registry)
+{
+    filterMetrics.resize(filters.size());
+
+    for (size_t i = 0; i < filters.size(); ++i) {
+        const char* name = filters[i]->name();
+        FilterMetrics& metrics = filterMetrics[i];
+
+        metrics.breakLoop = registry.counter(
+                ML::format("filters.breakLoop.%s", name));
+        metrics.timingKey = ML::format("filters.timingUs.%s", name);
+
+        metrics.filtered.assign(configs.size(), MetricRegistry::Counter());
+        for (size_t cfg = 0; cfg < configs.size(); ++cfg) {
+            if (!configs[cfg].config) continue;
+            metrics.filtered[cfg] = registry.counter(ML::format(
+                            "accounts.%s.filter.static.%s",
+                            configs[cfg].config->account.toString('.').c_str(),
+                            name));
+        }
+    }
+}
+
 } // namepsace RTBKit
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "rtbkit/common/filter.h"
+#include "rtbkit/common/metric_registry.h"
 #include "soa/gc/gc_lock.h"
 
 #include <atomic>
@@ -30,6 +31,7 @@ struct ExchangeConnector;
 struct AgentInfo;
 struct AgentStatus;
 struct AgentStats;
+struct AgentFilterCounters;
 struct AgentConfig;
 
 
@@ -50,7 +52,8 @@ struct FilterPool
             name(std::move(name)),
             config(info.config),
             status(info.status),
-            stats(info.stats)
+            stats(info.stats),
+            filterCounters(info.filterCounters)
         {}
 
         void reset()
@@ -58,12 +61,14 @@ struct FilterPool
             name = "";
             config.reset();
             stats.reset();
+            filterCounters.reset();
         }
 
         std::string name;
         std::shared_ptr<AgentConfig> config;
         std::shared_ptr<AgentStatus> status;
         std::shared_ptr<AgentStats> stats;
+        std::shared_ptr<const AgentFilterCounters> filterCounters;
 
         // Only used in the instances returned from filter.
         BiddableSpots biddableSpots;
@@ -88,6 +93,16 @@ struct FilterPool
 
 private:
 
+    /** Handles of a filter's metrics, resolved when the filters or the
+        configs change so that filter() can record them on every request.
+    */
+    struct FilterMetrics
+    {
+        MetricRegistry::Counter breakLoop;
+        std::string timingKey; // level; every sample counts, not the last
+        std::vector<MetricRegistry::Counter> filtered; // indexed by config
+    };
+
     struct Data
     {
         Data() {}
@@ -102,22 +117,27 @@ private:
         void addFilter(FilterBase* filter);
         void removeFilter(const std::string& name);
 
+        void resolveMetrics(MetricRegistry& registry);
+
         // \todo Use unique_ptr when moving to gcc 4.7
         std::vector<FilterBase*> filters;
+        std::vector<FilterMetrics> filterMetrics; // parallel to filters
 
         std::vector<ConfigEntry> configs;
         CreativeMatrix activeConfigs;
     };
 
     bool setData(Data*&, std::unique_ptr<Data>&);
-    void recordDiff(const Data* data, const FilterBase* f, const ConfigSet& diff);
-    uint64_t recordTime(uint64_t ticks, const FilterBase* filter);
+    void recordDiff(const FilterMetrics& metrics, const ConfigSet& diff);
+    uint64_t recordTime(uint64_t ticks, const FilterMetrics& metrics);
+    void resolveMetrics(Data& data);
 
     std::atomic<Data*> data;
     std::vector< std::shared_ptr<AgentConfig> > configs;
     Datacratic::GcLock gc;
 
     EventRecorder* events;
+    std::unique_ptr<MetricRegistry> metrics;
 };
 
 } // namespace RTBKIT
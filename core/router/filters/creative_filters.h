@@ -176,12 +176,47 @@ private:
 /* CREATIVE EXCHANGE FILTER                                                   */
 /******************************************************************************/
 
-/** \todo Find a way to write an efficient version of this. */
+/** Creatives whose exchange provides CreativeConstraint are compiled into
+    bitmaps per exchange when their config is added, so filtering them is a
+    few lookups and bitmap operations per impression.  Configs that weren't
+    indexed for the request's exchange (the connector has no constraints, or
+    the exchange came up after the config was added) go through the
+    connector's bidRequestCreativeFilter() one creative at a time.
+ */
 struct CreativeExchangeFilter : public IterativeFilter<CreativeExchangeFilter>
 {
     static constexpr const char* name = "CreativeExchange";
     unsigned priority() const { return Priority::CreativeExchange; }
 
+    void addConfig(
+            unsigned cfgIndex, const std::shared_ptr<AgentConfig>& config)
+    {
+        IterativeFilter<CreativeExchangeFilter>::addConfig(cfgIndex, config);
+
+        for (size_t crId = 0; crId < config->creatives.size(); ++crId) {
+            const auto& creative = config->creatives[crId];
+
+            std::lock_guard<ML::Spinlock> guard(creative.lock);
+            for (const auto& entry : creative.providerConstraints) {
+                auto& index = indexes[entry.first];
+                index.configs.set(cfgIndex);
+                index.add(cfgIndex, crId, *entry.second);
+            }
+        }
+    }
+
+    void removeConfig(
+            unsigned cfgIndex, const std::shared_ptr<AgentConfig>& config)
+    {
+        IterativeFilter<CreativeExchangeFilter>::removeConfig(cfgIndex, config);
+
+        for (auto& entry : indexes) {
+            if (!entry.second.configs.test(cfgIndex)) continue;
+            entry.second.configs.reset(cfgIndex);
+            entry.second.remove(cfgIndex);
+        }
+    }
+
     void filter(FilterState& state) const
     {
         // no exchange connector means evertyhing gets filtered out.
@@ -190,12 +225,19 @@ struct CreativeExchangeFilter : public IterativeFilter<CreativeExchangeFilter>
             return;
         }
 
+        const ExchangeIndex* index = nullptr;
+        auto it = indexes.find(state.exchange->exchangeName());
+        if (it != indexes.end()) index = &it->second;
+
         CreativeMatrix creatives;
+        if (index) creatives = index->filter(state.request);
 
         for (size_t cfgId = state.configs().next();
              cfgId < state.configs().size();
              cfgId = state.configs().next(cfgId+1))
         {
+            if (index && index->configs.test(cfgId)) continue;
+
             const auto& config = *configs[cfgId];
 
             for (size_t crId = 0; crId < config.creatives.size(); ++crId) {
@@ -226,6 +268,118 @@ private:
             return std::make_pair(false, nullptr);
         return std::make_pair(true, it->second.get());
     }
+
+    /** Creatives having each value of a given constraint. */
+    struct ConstraintIndex
+    {
+        std::string restriction;
+        CreativeConstraint::Type type;
+        std::unordered_map<int, CreativeMatrix> ints;
+        std::unordered_map<std::string, CreativeMatrix> strings;
+
+        void add(unsigned cfgIndex, unsigned crIndex, const SegmentList& values)
+        {
+            for (int value : values.ints)
+                ints[value].set(crIndex, cfgIndex);
+            for (const auto& value : values.strings)
+                strings[value].set(crIndex, cfgIndex);
+        }
+
+        void remove(unsigned cfgIndex)
+        {
+            for (auto& entry : ints) entry.second.resetConfig(cfgIndex);
+            for (auto& entry : strings) entry.second.resetConfig(cfgIndex);
+        }
+
+        /** Adds to failed the creatives that don't pass the given list. */
+        void filter(const SegmentList& list, CreativeMatrix& failed) const
+        {
+            switch (type) {
+
+            case CreativeConstraint::EXCLUDED:
+                for (int value : list.ints) {
+                    auto it = ints.find(value);
+                    if (it != ints.end()) failed |= it->second;
+                }
+                for (const auto& value : list.strings) {
+                    auto it = strings.find(value);
+                    if (it != strings.end()) failed |= it->second;
+                }
+                break;
+
+            case CreativeConstraint::ALLOWED_IF_LISTED:
+                if (list.empty()) break;
+                // fall through
+
+            case CreativeConstraint::ALLOWED:
+                for (const auto& entry : ints)
+                    if (!list.contains(entry.first)) failed |= entry.second;
+                for (const auto& entry : strings)
+                    if (!list.contains(entry.first)) failed |= entry.second;
+                break;
+            }
+        }
+    };
+
+    /** Everything indexed for an exchange. */
+    struct ExchangeIndex
+    {
+        ConfigSet configs;          ///< Configs filtered through the index
+        CreativeMatrix creatives;   ///< Creatives compatible with the exchange
+        std::vector<ConstraintIndex> constraints;
+
+        void add(
+                unsigned cfgIndex, unsigned crIndex,
+                const CreativeConstraints& crConstraints)
+        {
+            creatives.set(crIndex, cfgIndex);
+
+            for (const auto& constraint : crConstraints)
+                get(constraint).add(cfgIndex, crIndex, constraint.values);
+        }
+
+        void remove(unsigned cfgIndex)
+        {
+            creatives.resetConfig(cfgIndex);
+            for (auto& constraint : constraints) constraint.remove(cfgIndex);
+        }
+
+        CreativeMatrix filter(const BidRequest& request) const
+        {
+            CreativeMatrix failed;
+
+            // A creative has to pass the restrictions of every impression.
+            for (const auto& imp : request.imp) {
+                for (const auto& constraint : constraints) {
+                    constraint.filter(
+                            imp.restrictions.get(constraint.restriction),
+                            failed);
+                }
+            }
+
+            CreativeMatrix result = creatives;
+            result &= failed.negate();
+            return result;
+        }
+
+    private:
+
+        ConstraintIndex& get(const CreativeConstraint& constraint)
+        {
+            for (auto& index : constraints) {
+                if (index.restriction == constraint.restriction
+                        && index.type == constraint.type)
+                    return index;
+            }
+
+            constraints.emplace_back();
+            constraints.back().restriction = constraint.restriction;
+            constraints.back().type = constraint.type;
+            return constraints.back();
+        }
+    };
+
+    std::unordered_map<std::string, ExchangeIndex> indexes;
 };
 
 
@@ -492,9 +492,15 @@ struct SegmentListFilter
     {
         ConfigSet configs;
 
-        segments.forEach([&](int i, std::string str, float) {
-                    configs |= filter(i, str);
-                });
+        for (int i : segments.ints) {
+            auto it = intSet.find(i);
+            if (it != intSet.end()) configs |= it->second;
+        }
+
+        for (const auto& str : segments.strings) {
+            auto it = strSet.find(str);
+            if (it != strSet.end()) configs |= it->second;
+        }
 
         return configs;
     }
@@ -521,6 +527,95 @@ private:
 };
 
 
+/******************************************************************************/
+/* SEGMENT INCLUDE EXCLUDE FILTER                                             */
+/******************************************************************************/
+
+/** Include/exclude filter over segment lists.
+
+    Every segment named by a config is interned into a dense id which indexes
+    the bitmaps of the configs that include and exclude it. Each segment of a
+    request is then looked up once and its two bitmaps are OR-ed into the
+    result, instead of being hashed once for the includes and again for the
+    excludes.
+ */
+struct SegmentIncludeExcludeFilter
+{
+    SegmentIncludeExcludeFilter() : emptyIncludes(true) {}
+
+    void setInclude(unsigned cfgIndex, bool value, const SegmentList& segments)
+    {
+        if (segments.empty()) return;
+
+        forEachId(segments, [&] (Entry& entry) {
+                    entry.includes.set(cfgIndex, value);
+                });
+        emptyIncludes.set(cfgIndex, !value);
+    }
+
+    void setExclude(unsigned cfgIndex, bool value, const SegmentList& segments)
+    {
+        forEachId(segments, [&] (Entry& entry) {
+                    entry.excludes.set(cfgIndex, value);
+                });
+    }
+
+    ConfigSet filter(const SegmentList& segments) const
+    {
+        ConfigSet includes = emptyIncludes;
+        ConfigSet excludes;
+
+        auto onEntry = [&] (const Entry& entry) {
+            includes |= entry.includes;
+            excludes |= entry.excludes;
+        };
+
+        for (int i : segments.ints) {
+            auto it = intIds.find(i);
+            if (it != intIds.end()) onEntry(entries[it->second]);
+        }
+
+        for (const auto& str : segments.strings) {
+            auto it = strIds.find(str);
+            if (it != strIds.end()) onEntry(entries[it->second]);
+        }
+
+        return includes &= excludes.negate();
+    }
+
+private:
+
+    struct Entry
+    {
+        ConfigSet includes;
+        ConfigSet excludes;
+    };
+
+    template<typename Fn>
+    void forEachId(const SegmentList& segments, Fn fn)
+    {
+        for (int i : segments.ints)
+            fn(entries[intern(intIds, i)]);
+        for (const auto& str : segments.strings)
+            fn(entries[intern(strIds, str)]);
+    }
+
+    template<typename K>
+    unsigned intern(std::unordered_map<K, unsigned>& ids, const K& key)
+    {
+        auto res = ids.insert(std::make_pair(key, entries.size()));
+        if (res.second) entries.emplace_back();
+        return res.first->second;
+    }
+
+    std::unordered_map<int, unsigned> intIds;
+    std::unordered_map<std::string, unsigned> strIds;
+    std::vector<Entry> entries;
+
+    ConfigSet emptyIncludes;
+};
+
+
 /******************************************************************************/
 /* INCLUDE EXCLUDE FILTER                                                     */
 /******************************************************************************/
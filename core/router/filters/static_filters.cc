@@ -84,11 +84,7 @@ void
 SegmentsFilter::
 filter(FilterState& state) const
 {
-    unordered_set<string> toCheck = excludeIfNotPresent;
-
     for (const auto& segment : state.request.segments) {
-        toCheck.erase(segment.first);
-
         auto it = data.find(segment.first);
         if (it == data.end()) continue;
 
@@ -97,7 +93,11 @@ filter(FilterState& state) const
         if (state.configs().empty()) return;
     }
 
-    for (const auto& segment : toCheck) {
+    // There are only ever a handful of these so probing the request's
+    // segments is cheaper than copying the set for every request.
+    for (const auto& segment : excludeIfNotPresent) {
+        if (state.request.segments.count(segment)) continue;
+
         auto it = data.find(segment);
         if (it == data.end()) continue;
 
@@ -41,7 +41,7 @@ private:
         typedef ListFilter<std::string> ExchangeFilterT;
         IncludeExcludeFilter<ExchangeFilterT> exchange;
 
-        IncludeExcludeFilter<SegmentListFilter> ie;
+        SegmentIncludeExcludeFilter ie;
         ConfigSet excludeIfNotPresent;
 
         ConfigSet applyExchangeFilter(
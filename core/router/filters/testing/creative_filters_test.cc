@@ -176,3 +176,85 @@ BOOST_AUTO_TEST_CASE( testLanguageFilter )
     check(filter, r1, creatives, 0, {          });
     check(filter, r2, creatives, 0, {          });
 }
+
+
+/******************************************************************************/
+/* EXCHANGE FILTER                                                            */
+/******************************************************************************/
+
+BOOST_AUTO_TEST_CASE( testExchangeFilter )
+{
+    CreativeExchangeFilter filter;
+    CreativeMatrix creatives;
+
+    auto constraint = [] (
+            const string& restriction,
+            CreativeConstraint::Type type,
+            const vector<int>& values)
+    {
+        CreativeConstraint result(restriction, type);
+        result.values = SegmentList(values);
+        return result;
+    };
+
+    auto addCr = [] (AgentConfig& cfg, const CreativeConstraints& constraints) {
+        cfg.creatives.emplace_back();
+        cfg.creatives.back().providerData["bob"] = std::make_shared<int>(0);
+        cfg.creatives.back().providerConstraints["bob"] =
+            std::make_shared<CreativeConstraints>(constraints);
+    };
+
+    AgentConfig c0;
+    addCr(c0, { constraint("attr", CreativeConstraint::EXCLUDED, { 1 }) });
+    addCr(c0, { constraint("vendor", CreativeConstraint::ALLOWED, { 2 }) });
+
+    AgentConfig c1;
+    addCr(c1, { constraint("group", CreativeConstraint::ALLOWED_IF_LISTED, { 3 }) });
+    addCr(c1, {});
+
+    // Not indexed: goes through bidRequestCreativeFilter, which lets anything
+    // with provider data through.
+    AgentConfig c2;
+    c2.creatives.emplace_back();
+    c2.creatives.back().providerData["bob"] = std::make_shared<int>(0);
+    c2.creatives.emplace_back();
+
+    auto restrict = [] (AdSpot& imp, const string& key, const vector<int>& values) {
+        imp.restrictions.add(key, std::make_shared<SegmentList>(values));
+    };
+
+    BidRequest r0;
+    addImp(r0, OpenRTB::AdPosition::ABOVE, { {100, 100} });
+
+    BidRequest r1;
+    addImp(r1, OpenRTB::AdPosition::ABOVE, { {100, 100} });
+    restrict(r1.imp[0], "attr", { 1 });
+    restrict(r1.imp[0], "vendor", { 2 });
+    restrict(r1.imp[0], "group", { 4 });
+
+    // Every impression's restrictions apply to all of them.
+    BidRequest r2;
+    addImp(r2, OpenRTB::AdPosition::ABOVE, { {100, 100} });
+    addImp(r2, OpenRTB::AdPosition::ABOVE, { {100, 100} });
+    restrict(r2.imp[0], "vendor", { 2 });
+    restrict(r2.imp[1], "attr", { 1 });
+    restrict(r2.imp[1], "group", { 3 });
+
+
+    title("exchange-1");
+    addConfig(filter, 0, c0, creatives);
+    addConfig(filter, 1, c1, creatives);
+    addConfig(filter, 2, c2, creatives);
+
+    check(filter, r0, creatives, 0, { {0, 1, 2}, {1}       });
+    check(filter, r1, creatives, 0, { {2},       {0, 1}    });
+    check(filter, r2, creatives, 0, { {1, 2},    {1}       });
+    check(filter, r2, creatives, 1, { {1, 2},    {1}       });
+
+
+    title("exchange-2");
+    removeConfig(filter, 0, c0, creatives);
+
+    check(filter, r0, creatives, 0, { {1, 2}, {1}    });
+    check(filter, r1, creatives, 0, { {2},    {1}    });
+}
@@ -257,6 +257,42 @@ BOOST_AUTO_TEST_CASE(segmentListTest)
     check(filter.filter(seg2),     { 0, 1 });
 }
 
+BOOST_AUTO_TEST_CASE(segmentIncludeExcludeFilterTest)
+{
+    SegmentIncludeExcludeFilter filter;
+
+    auto doCheck = [&] (ConfigSet configs, const initializer_list<size_t>& exp) {
+        ConfigSet mask;
+        for (size_t i = 0; i < 3; ++i) mask.set(i);
+
+        configs &= mask;
+        check(configs, exp);
+    };
+
+    title("segment-ie-1");
+    doCheck(filter.filter(segment(1, "a")), { 0, 1, 2 });
+
+    title("segment-ie-2");
+    filter.setInclude(0, true, segment(1, "a"));
+    filter.setExclude(1, true, segment("b"));
+    filter.setInclude(2, true, segment(2));
+    filter.setExclude(2, true, segment("a"));
+
+    doCheck(filter.filter(segment(1)),      { 0, 1 });
+    doCheck(filter.filter(segment("a")),    { 0, 1 });
+    doCheck(filter.filter(segment("b")),    { });
+    doCheck(filter.filter(segment(2)),      { 1, 2 });
+    doCheck(filter.filter(segment(2, "a")), { 0, 1 });
+    doCheck(filter.filter(segment(3)),      { 1 });
+
+    title("segment-ie-3");
+    filter.setInclude(2, false, segment(2));
+    filter.setExclude(1, false, segment("b"));
+
+    doCheck(filter.filter(segment("b")),    { 1, 2 });
+    doCheck(filter.filter(segment(2, "a")), { 0, 1 });
+}
+
 BOOST_AUTO_TEST_CASE(includeExcludeFilterTest)
 {
     typedef ListFilter<size_t> BaseFilterT;
@@ -0,0 +1,235 @@
+/* latency_histogram.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Lock-free latency histograms for the stages of an auction.
+*/
+
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace RTBKIT {
+
+namespace {
+
+/** Shard used by the calling thread; handed out round robin. */
+unsigned threadShard()
+{
+    static std::atomic<unsigned> nextShard(0);
+    static __thread int shard = -1;
+    if (shard == -1)
+        shard = nextShard.fetch_add(1) % LatencyHistogram::NumShards;
+    return shard;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* LATENCY HISTOGRAM                                                         */
+/*****************************************************************************/
+
+LatencyHistogram::Shard::
+Shard()
+    : max(0)
+{
+    for (auto & c: counts)
+        c.store(0, std::memory_order_relaxed);
+}
+
+LatencyHistogram::
+LatencyHistogram()
+{
+}
+
+unsigned
+LatencyHistogram::
+bucketOf(uint64_t micros)
+{
+    if (micros < SubBuckets)
+        return micros;
+
+    int msb = 63 - __builtin_clzll(micros);
+    if (msb >= MaxBits)
+        return NumBuckets - 1;
+
+    int shift = msb - SubBits;
+    return (msb - SubBits + 1) * SubBuckets
+        + ((micros >> shift) & (SubBuckets - 1));
+}
+
+uint64_t
+LatencyHistogram::
+bucketLimit(unsigned bucket)
+{
+    if (bucket < SubBuckets)
+        return bucket;
+
+    int msb = bucket / SubBuckets + SubBits - 1;
+    uint64_t sub = bucket % SubBuckets;
+    int shift = msb - SubBits;
+    return ((uint64_t(SubBuckets) + sub + 1) << shift) - 1;
+}
+
+void
+LatencyHistogram::
+record(double seconds)
+{
+    if (!(seconds >= 0.0)) return;
+
+    uint64_t micros = llround(seconds * 1000000.0);
+    Shard & shard = shards[threadShard()];
+
+    shard.counts[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t current = shard.max.load(std::memory_order_relaxed);
+    while (micros > current
+           && !shard.max.compare_exchange_weak(current, micros,
+                                               std::memory_order_relaxed))
+        ;
+}
+
+LatencyHistogram::Snapshot::
+Snapshot()
+    : count(0), max(0)
+{
+    std::fill(counts, counts + NumBuckets, 0);
+}
+
+LatencyHistogram::Snapshot
+LatencyHistogram::
+snapshot() const
+{
+    Snapshot result;
+    for (auto & shard: shards) {
+        for (unsigned i = 0;  i < NumBuckets;  ++i) {
+            uint64_t n = shard.counts[i].load(std::memory_order_relaxed);
+            result.counts[i] += n;
+            result.count += n;
+        }
+        result.max = std::max<uint64_t>
+            (result.max, shard.max.load(std::memory_order_relaxed));
+    }
+    return result;
+}
+
+uint64_t
+LatencyHistogram::Snapshot::
+quantile(double q) const
+{
+    if (count == 0) return 0;
+
+    uint64_t rank = std::max<uint64_t>(1, ceil(q * count));
+    uint64_t seen = 0;
+    for (unsigned i = 0;  i < NumBuckets;  ++i) {
+        seen += counts[i];
+        if (seen >= rank)
+            return std::min(bucketLimit(i), max);
+    }
+    return max;
+}
+
+Json::Value
+LatencyHistogram::Snapshot::
+toJson() const
+{
+    Json::Value result;
+    result["count"] = (Json::Value::UInt)count;
+    result["p50"] = quantile(0.5) / 1000.0;
+    result["p99"] = quantile(0.99) / 1000.0;
+    result["p99.9"] = quantile(0.999) / 1000.0;
+    result["max"] = max / 1000.0;
+    return result;
+}
+
+
+/*****************************************************************************/
+/* LATENCY HISTOGRAM SET                                                     */
+/*****************************************************************************/
+
+LatencyHistogramSet::
+LatencyHistogramSet()
+    : numEntries(0)
+{
+}
+
+LatencyHistogram &
+LatencyHistogramSet::
+operator [] (const std::string & key)
+{
+    unsigned n = numEntries.load(std::memory_order_acquire);
+    for (unsigned i = 0;  i < n;  ++i)
+        if (entries[i].key == key)
+            return *entries[i].histogram;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Someone may have added it while we were waiting for the lock
+    n = numEntries.load(std::memory_order_relaxed);
+    for (unsigned i = 0;  i < n;  ++i)
+        if (entries[i].key == key)
+            return *entries[i].histogram;
+
+    if (n == Capacity)
+        return other;
+
+    entries[n].key = key;
+    entries[n].histogram.reset(new LatencyHistogram());
+    numEntries.store(n + 1, std::memory_order_release);
+    return *entries[n].histogram;
+}
+
+Json::Value
+LatencyHistogramSet::
+toJson() const
+{
+    Json::Value result(Json::objectValue);
+
+    unsigned n = numEntries.load(std::memory_order_acquire);
+    for (unsigned i = 0;  i < n;  ++i)
+        result[entries[i].key] = entries[i].histogram->snapshot().toJson();
+
+    auto others = other.snapshot();
+    if (others.count)
+        result["other"] = others.toJson();
+
+    return result;
+}
+
+
+/*****************************************************************************/
+/* AUCTION LATENCY                                                           */
+/*****************************************************************************/
+
+const char *
+AuctionLatency::
+stageName(Stage stage)
+{
+    switch (stage) {
+    case PARSE:         return "parse";
+    case QUEUE:         return "queue";
+    case PREPRO:        return "prepro";
+    case AUGMENTATION:  return "augmentation";
+    case DISPATCH:      return "dispatch";
+    case START_BIDDING: return "startBidding";
+    case RESPONSE:      return "response";
+    default:            return "unknown";
+    }
+}
+
+Json::Value
+AuctionLatency::
+toJson() const
+{
+    Json::Value result;
+    for (unsigned i = 0;  i < NUM_STAGES;  ++i)
+        result["exchanges"][stageName(Stage(i))] = stages[i].toJson();
+    result["agents"] = agents.toJson();
+    result["units"] = "ms";
+    return result;
+}
+
+} // namespace RTBKIT
@@ -0,0 +1,165 @@
+/* latency_histogram.h                                             -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Lock-free latency histograms for the stages of an auction.
+*/
+
+#pragma once
+
+#include "soa/types/date.h"
+#include "soa/jsoncpp/value.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* LATENCY HISTOGRAM                                                         */
+/*****************************************************************************/
+
+/** Log-linear histogram of durations in microseconds, in the spirit of HDR
+    histograms: each power of two is split into 16 linear buckets, which
+    bounds the error of a quantile to about 6%.
+
+    Recording is a relaxed atomic increment into one of a few shards; each
+    thread sticks to its own shard so writers don't share cache lines.  The
+    shards are only merged when a snapshot is asked for.
+*/
+struct LatencyHistogram {
+
+    enum {
+        SubBits = 4,
+        SubBuckets = 1 << SubBits,
+        MaxBits = 40,                                   ///< ~12 days in us
+        NumBuckets = (MaxBits - SubBits + 1) * SubBuckets,
+        NumShards = 8
+    };
+
+    LatencyHistogram();
+
+    /** Record a duration given in seconds.  Negative values are ignored. */
+    void record(double seconds);
+
+    /** Record the time between two dates, if both have been set. */
+    void record(Date from, Date to)
+    {
+        if (from.secondsSinceEpoch() == 0.0 || to.secondsSinceEpoch() == 0.0)
+            return;
+        record(to.secondsSince(from));
+    }
+
+    /** Merged view of all shards. */
+    struct Snapshot {
+        Snapshot();
+
+        uint64_t count;
+        uint64_t max;
+        uint64_t counts[NumBuckets];
+
+        /** Upper bound in microseconds of the given quantile. */
+        uint64_t quantile(double q) const;
+
+        /** count, p50, p99, p99.9 and max, in milliseconds. */
+        Json::Value toJson() const;
+    };
+
+    Snapshot snapshot() const;
+
+    static unsigned bucketOf(uint64_t micros);
+    static uint64_t bucketLimit(unsigned bucket);
+
+private:
+    struct Shard {
+        Shard();
+
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> counts[NumBuckets];
+    } __attribute__((__aligned__(64)));
+
+    Shard shards[NumShards];
+};
+
+
+/*****************************************************************************/
+/* LATENCY HISTOGRAM SET                                                     */
+/*****************************************************************************/
+
+/** Histograms keyed by name (an exchange, an agent...).  Keys are appended
+    to a fixed size table and never removed, so a lookup is a scan of the
+    published entries and doesn't take a lock; only adding a key does.  Keys
+    past the capacity are all accounted under "other".
+*/
+struct LatencyHistogramSet {
+
+    enum { Capacity = 256 };
+
+    LatencyHistogramSet();
+
+    LatencyHistogram & operator [] (const std::string & key);
+
+    /** Object mapping every key to its histogram's snapshot. */
+    Json::Value toJson() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::unique_ptr<LatencyHistogram> histogram;
+    };
+
+    Entry entries[Capacity];
+    std::atomic<unsigned> numEntries;
+    std::mutex lock;
+    LatencyHistogram other;
+};
+
+
+/*****************************************************************************/
+/* AUCTION LATENCY                                                           */
+/*****************************************************************************/
+
+/** Latency of every stage an auction goes through in the router, per
+    exchange, and of the agents' responses, per agent.
+*/
+struct AuctionLatency {
+
+    enum Stage {
+        PARSE,              ///< start -> doneParsing
+        QUEUE,              ///< doneParsing -> inPrepro
+        PREPRO,             ///< inPrepro -> outOfPrepro
+        AUGMENTATION,       ///< outOfPrepro -> doneAugmenting
+        DISPATCH,           ///< doneAugmenting -> inStartBidding
+        START_BIDDING,      ///< start -> inStartBidding
+        RESPONSE,           ///< start -> response handed to the exchange
+        NUM_STAGES
+    };
+
+    static const char * stageName(Stage stage);
+
+    void record(Stage stage, const std::string & exchange,
+                Date from, Date to)
+    {
+        stages[stage][exchange].record(from, to);
+    }
+
+    void recordAgent(const std::string & agent, double seconds)
+    {
+        agents[agent].record(seconds);
+    }
+
+    /** { "exchanges": { stage: { exchange: {...} } },
+          "agents": { agent: {...} } }
+    */
+    Json::Value toJson() const;
+
+private:
+    LatencyHistogramSet stages[NUM_STAGES];
+    LatencyHistogramSet agents;
+};
+
+} // namespace RTBKIT
@@ -6,6 +6,8 @@
 */
 
 #include <set>
+#include <pthread.h>
+#include <sched.h>
 #include "router.h"
 #include "soa/service/zmq_utils.h"
 #include "jml/arch/backtrace.h"
@@ -121,9 +123,11 @@ Router(ServiceBase & parent,
       startBiddingBuffer(65536),
       submittedBuffer(65536),
       auctionGraveyard(65536),
+      metrics(*this),
       augmentationLoop(*this),
       loopMonitor(*this),
       loadStabilizer(loopMonitor),
+      preFilterShedding(false),
       secondsUntilLossAssumed_(secondsUntilLossAssumed),
       globalBidProbability(1.0),
       bidsErrorRate(0.0),
@@ -134,6 +138,7 @@ Router(ServiceBase & parent,
       initialized(false),
       logAuctions(logAuctions),
       logBids(logBids),
+      binaryLogs(false),
       logger(getZmqContext()),
       doDebug(false),
       numAuctions(0), numBids(0), numNonEmptyBids(0),
@@ -163,9 +168,11 @@ Router(std::shared_ptr<ServiceProxies> services,
       startBiddingBuffer(65536),
       submittedBuffer(65536),
       auctionGraveyard(65536),
+      metrics(*this),
       augmentationLoop(*this),
       loopMonitor(*this),
       loadStabilizer(loopMonitor),
+      preFilterShedding(false),
       secondsUntilLossAssumed_(secondsUntilLossAssumed),
       globalBidProbability(1.0),
       bidsErrorRate(0.0),
@@ -176,6 +183,7 @@ Router(std::shared_ptr<ServiceProxies> services,
       initialized(false),
       logAuctions(logAuctions),
       logBids(logBids),
+      binaryLogs(false),
       logger(getZmqContext()),
       doDebug(false),
       numAuctions(0), numBids(0), numNonEmptyBids(0),
@@ -337,6 +345,7 @@ start(boost::function<void ()> onStop)
         };
 
     logger.start();
+    metrics.start();
     augmentationLoop.start();
     runThread.reset(new boost::thread(runfn));
 
@@ -449,6 +458,16 @@ run()
 
     recordHit("routerUp");
 
+    if (loopOptions.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(loopOptions.cpu, &cpus);
+        int res = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (res != 0)
+            cerr << "couldn't pin router loop to cpu " << loopOptions.cpu
+                 << ": " << strerror(res) << endl;
+    }
+
     //double lastDump = ML::wall_time();
 
     struct TimesEntry {
@@ -467,8 +486,39 @@ run()
         uint64_t count;
     };
 
-    std::map<std::string, TimesEntry> times;
+    /* Time spent in each stage of the loop; indexed rather than keyed by
+       name so that recording them doesn't cost a map lookup. */
+    enum Stage {
+        ST_ASLEEP,
+        ST_START_BIDDING,
+        ST_CONFIG,
+        ST_SUBMITTED,
+        ST_CHECKS,
+        ST_MSG_BID,
+        ST_MSG_PONG0,
+        ST_MSG_PONG1,
+        ST_MSG_CONFIG,
+        ST_MSG_OTHER,
+        ST_NUM_STAGES
+    };
+
+    static const char * stageNames[ST_NUM_STAGES] = {
+        "asleep", "doStartBidding", "doConfig", "doSubmitted", "checks",
+        "BID", "PONG0", "PONG1", "CONFIG", "other"
+    };
+
+    TimesEntry times[ST_NUM_STAGES];
 
+    auto messageStage = [] (const vector<string> & message) -> Stage
+        {
+            if (message.size() < 2) return ST_MSG_OTHER;
+            const string & request = message[1];
+            if (request == "BID") return ST_MSG_BID;
+            if (request == "PONG0") return ST_MSG_PONG0;
+            if (request == "PONG1") return ST_MSG_PONG1;
+            if (request == "CONFIG") return ST_MSG_CONFIG;
+            return ST_MSG_OTHER;
+        };
 
     // Attempt to wake up once per millisecond
 
@@ -485,6 +535,15 @@ run()
 
         for (unsigned i = 0;  i < 20 && rc == 0;  ++i)
             rc = zmq_poll(items, 2, 0);
+
+        // Busy poll for a while before giving up the cpu, so that work
+        // arriving after a short lull doesn't pay for a wakeup.
+        if (rc == 0 && loopOptions.spinSeconds > 0.0) {
+            double spinUntil = beforeSleep + loopOptions.spinSeconds;
+            while (rc == 0 && !shutdown_ && getTime() < spinUntil)
+                rc = zmq_poll(items, 2, 0);
+        }
+
         if (rc == 0) {
             ++numTimesCouldSleep;
             checkExpiredAuctions();
@@ -494,7 +553,7 @@ run()
             // context switches.
             Date now = Date::now();
             double timeSinceSleep = lastSleep.secondsUntil(now);
-            double timeToWait = 0.0005 - timeSinceSleep;
+            double timeToWait = loopOptions.sleepInterval - timeSinceSleep;
             if (timeToWait > 0) {
                 ML::sleep(timeToWait);
             }
@@ -513,7 +572,7 @@ run()
             += microsecondsBetween(afterSleep, beforeSleep);
         dutyCycleCurrent.nEvents += 1;
 
-        times["asleep"].add(microsecondsBetween(afterSleep, beforeSleep));
+        times[ST_ASLEEP].add(microsecondsBetween(afterSleep, beforeSleep));
 
         if (rc == -1 && zmq_errno() != EINTR) {
             cerr << "zeromq error: " << zmq_strerror(zmq_errno()) << endl;
@@ -527,7 +586,7 @@ run()
             }
 
             double atEnd = getTime();
-            times["doStartBidding"].add(microsecondsBetween(atEnd, atStart));
+            times[ST_START_BIDDING].add(microsecondsBetween(atEnd, atStart));
         }
 
         {
@@ -538,6 +597,8 @@ run()
                                              agent.first,
                                              *agent.second.config);
                 };
+                if (preFilterShedding)
+                    updatePreFilters();
             }
         }
 
@@ -558,7 +619,7 @@ run()
             }
 
             double atEnd = getTime();
-            times["doConfig"].add(microsecondsBetween(atEnd, atStart));
+            times[ST_CONFIG].add(microsecondsBetween(atEnd, atStart));
         }
 
         {
@@ -568,24 +629,33 @@ run()
                 doSubmitted(auction);
 
             double atEnd = getTime();
-            times["doSubmitted"].add(microsecondsBetween(atEnd, atStart));
+            times[ST_SUBMITTED].add(microsecondsBetween(atEnd, atStart));
         }
 
-        if (items[0].revents & ZMQ_POLLIN) {
+        // Agent messages; drain up to agentBatch of them before going back
+        // to the other sources.
+        for (int n = 0;
+             n < loopOptions.agentBatch && (items[0].revents & ZMQ_POLLIN);
+             ++n) {
             double beforeMessage = getTime();
             // Agent message
             vector<string> message;
             try {
                 message = recvAll(agentEndpoint.getSocketUnsafe());
+                Stage stage = messageStage(message);
                 agentEndpoint.handleMessage(std::move(message));
                 double atEnd = getTime();
-                times[message.at(1)].add(microsecondsBetween(atEnd, beforeMessage));
+                times[stage].add(microsecondsBetween(atEnd, beforeMessage));
             } catch (const std::exception & exc) {
                 cerr << "error handling agent message " << message
                      << ": " << exc.what() << endl;
                 logRouterError("handleAgentMessage", exc.what(),
                                message);
             }
+
+            if (n + 1 < loopOptions.agentBatch
+                && zmq_poll(items, 1, 0) <= 0)
+                break;
         }
 
         if (items[1].revents & ZMQ_POLLIN) {
@@ -637,32 +707,36 @@ run()
             checkDeadAgents();
 
             double total = 0.0;
-            for (auto it = times.begin(); it != times.end();  ++it)
-                total += it->second.time;
+            for (auto & entry: times)
+                total += entry.time;
 
             cerr << "total of " << total << " microseconds and "
                  << totalSleeps << " sleeps" << endl;
 
-            for (auto it = times.begin(); it != times.end();  ++it) {
+            for (unsigned i = 0;  i < ST_NUM_STAGES;  ++i) {
+                TimesEntry & entry = times[i];
+                if (!entry.count) continue;
+
                 cerr << ML::format("%-30s %8lld %10.0f %6.2f%% %8.2fus/call\n",
-                                   it->first.c_str(),
-                                   (unsigned long long)it->second.count,
-                                   it->second.time,
-                                   100.0 * it->second.time / total,
-                                   it->second.time / it->second.count);
+                                   stageNames[i],
+                                   (unsigned long long)entry.count,
+                                   entry.time,
+                                   100.0 * entry.time / total,
+                                   entry.time / entry.count);
 
-                recordEvent(("routerLoop." + it->first).c_str(), ET_LEVEL,
-                        1.0 * it->second.time / (now - last_check) / 1000000.0);
+                recordEvent((string("routerLoop.") + stageNames[i]).c_str(),
+                        ET_LEVEL,
+                        1.0 * entry.time / (now - last_check) / 1000000.0);
 
+                entry = TimesEntry();
             }
 
-            times.clear();
             totalSleeps = 0;
 
             last_check = now;
         }
 
-        times["checks"].add(microsecondsBetween(getTime(), beforeChecks));
+        times[ST_CHECKS].add(microsecondsBetween(getTime(), beforeChecks));
 
         if (now - lastTimestamp >= 1.0) {
             banker->logBidEvents(*this);
@@ -702,6 +776,8 @@ shutdown()
     logger.shutdown();
     banker.reset();
 
+    metrics.shutdown();
+
     monitorClient.shutdown();
     monitorProviderClient.shutdown();
 }
@@ -930,50 +1006,35 @@ checkDeadAgents()
         const std::string & account = info.config->account.toString('.');
 
         Date now = Date::now();
-        double oldest = 0.0;
-        double total = 0.0;
-
-        vector<Id> toExpire;
-
-        // Check for in flight timeouts.  This shouldn't happen, but there
-        // appears to be a way in which we lose track of an inflight auction
-        auto onInFlight = [&] (const Id & id, const Date & date)
-            {
-                double secondsSince = now.secondsSince(date);
-
-                oldest = std::max(oldest, secondsSince);
-                total += secondsSince;
-
-                if (secondsSince > 30.0) {
-
-                    this->recordHit("accounts.%s.lostBids", account);
-
-                    this->sendBidResponse(it->first,
-                                          info,
-                                          BS_LOSTBID,
-                                          this->getCurrentTime(),
-                                          "guaranteed", id);
 
-                    toExpire.push_back(id);
-                }
-            };
-
-        info.forEachInFlight(onInFlight);
+        Id oldestId;
+        Date oldestDate;
+        double oldest = 0.0;
+        if (info.oldestBidInFlight(oldestId, oldestDate))
+            oldest = now.secondsSince(oldestDate);
 
         this->recordLevel(info.numBidsInFlight(),
                           "accounts.%s.inFlight.numInFlight", account);
         this->recordLevel(oldest,
                           "accounts.%s.inFlight.oldestAgeSeconds", account);
-        double averageAge = 0.0;
-        if (info.numBidsInFlight() != 0)
-            averageAge = total / info.numBidsInFlight();
-
-        this->recordLevel(averageAge,
+        this->recordLevel(info.averageAgeInFlight(now),
                           "accounts.%s.inFlight.averageAgeSeconds", account);
 
-        for (auto jt = toExpire.begin(), jend = toExpire.end();  jt != jend;
-             ++jt) {
-            info.expireBidInFlight(*jt);
+        // Check for in flight timeouts.  This shouldn't happen, but there
+        // appears to be a way in which we lose track of an inflight auction.
+        // The bids are in date order so only the expired ones are visited.
+        while (info.oldestBidInFlight(oldestId, oldestDate)
+               && now.secondsSince(oldestDate) > 30.0) {
+
+            this->recordHit("accounts.%s.lostBids", account);
+
+            this->sendBidResponse(it->first,
+                                  info,
+                                  BS_LOSTBID,
+                                  this->getCurrentTime(),
+                                  "guaranteed", oldestId);
+
+            info.expireBidInFlight(oldestId);
         }
 
         double timeSinceHeartbeat
@@ -987,10 +1048,14 @@ checkDeadAgents()
             if (it->second.numBidsInFlight() != 0) {
                 cerr << "agent " << it->first
                      << " has " << it->second.numBidsInFlight()
-                     << " undead auctions: " << endl;
+                     << " undead auctions" << endl;
 
+                // Only the oldest few; listing them all would stall the loop
+                // with thousands in flight.
+                int toPrint = 10;
                 auto onInFlight = [&] (const Id & id, Date date)
                     {
+                        if (toPrint-- <= 0) return;
                         cerr << "  " << id << " --> "
                         << date << " (" << now.secondsSince(date)
                         << "s ago)" << endl;
@@ -1248,36 +1313,37 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
     auto exchangeConnector = auction->exchangeConnector;
 
 
-    auto doFilterStat = [&] (const AgentConfig& config, const char * reason) {
-        if (!traceAuction) return;
+    typedef AgentFilterCounters FC;
 
-        this->recordHit("accounts.%s.filter.%s",
-                config.account.toString('.'),
-                reason);
-    };
+    // The counters are cheap enough to be hit on every auction.
+    auto doFilterStat = [&] (const std::shared_ptr<const FC> & counters,
+                             FC::Reason reason)
+        {
+            if (counters) counters->hit(reason);
+        };
 
-    if (traceAuction) {
-        forEachAgent([&] (const AgentInfoEntry& info) {
-                    ML::atomic_inc(info.stats->intoFilters);
-                    doFilterStat(*info.config, "intoStaticFilters");
-                });
-    }
+    forEachAgent([&] (const AgentInfoEntry& info) {
+                if (traceAuction) ML::atomic_inc(info.stats->intoFilters);
+                doFilterStat(info.filterCounters, FC::INTO_STATIC_FILTERS);
+            });
 
     // Do the actual filtering.
     auto biddableConfigs = filters.filter(*auction->request, exchangeConnector);
 
-    auto checkAgent = [&] (
-            const AgentConfig & config,
-            const AgentStatus & status,
-            AgentStats & stats)
+    auto checkAgent = [&] (const FilterPool::ConfigEntry & entry)
         {
+            const AgentConfig & config = *entry.config;
+            const AgentStatus & status = *entry.status;
+
             if (status.dead || status.lastHeartbeat.secondsSince(now) > 2.0) {
-                doFilterStat(config, "static.agentAppearsDead");
+                doFilterStat(entry.filterCounters,
+                             FC::STATIC_AGENT_APPEARS_DEAD);
                 return false;
             }
 
             if (status.numBidsInFlight >= config.maxInFlight) {
-                doFilterStat(config, "static.earlyTooManyInFlight");
+                doFilterStat(entry.filterCounters,
+                             FC::STATIC_EARLY_TOO_MANY_IN_FLIGHT);
                 return false;
             }
 
@@ -1285,8 +1351,8 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
             if (config.minTimeAvailableMs != 0.0
                 && timeLeftMs < config.minTimeAvailableMs)
             {
-                ML::atomic_inc(stats.notEnoughTime);
-                doFilterStat(config, "static.notEnoughTime");
+                ML::atomic_inc(entry.stats->notEnoughTime);
+                doFilterStat(entry.filterCounters, FC::STATIC_NOT_ENOUGH_TIME);
                 return false;
             }
 
@@ -1295,10 +1361,10 @@ preprocessAuction(const std::shared_ptr<Auction> & auction)
 
     for (const auto& entry : biddableConfigs) {
         if (entry.biddableSpots.empty()) continue;
-        if (!checkAgent(*entry.config, *entry.status, *entry.stats)) continue;
+        if (!checkAgent(entry)) continue;
 
         ML::atomic_inc(entry.stats->passedStaticFilters);
-        doFilterStat(*entry.config, "passedStaticFilters");
+        doFilterStat(entry.filterCounters, FC::PASSED_STATIC_FILTERS);
 
         string rrGroup = entry.config->roundRobinGroup;
         if (rrGroup == "") rrGroup = entry.name;
@@ -1403,13 +1469,65 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
         auction->inStartBidding = now;
 
+        {
+            const std::string & exchange
+                = auction->exchangeConnector
+                ? auction->exchangeConnector->exchangeName()
+                : string("unknown");
+            latency.record(AuctionLatency::PARSE, exchange,
+                           auction->start, auction->doneParsing);
+            latency.record(AuctionLatency::QUEUE, exchange,
+                           auction->doneParsing, auction->inPrepro);
+            latency.record(AuctionLatency::PREPRO, exchange,
+                           auction->inPrepro, auction->outOfPrepro);
+            latency.record(AuctionLatency::AUGMENTATION, exchange,
+                           auction->outOfPrepro, auction->doneAugmenting);
+            latency.record(AuctionLatency::DISPATCH, exchange,
+                           auction->doneAugmenting, now);
+            latency.record(AuctionLatency::START_BIDDING, exchange,
+                           auction->start, now);
+        }
+
         double timeLeftMs = auction->timeAvailable(now) * 1000.0;
         double timeUsedMs = auction->timeUsed(now) * 1000.0;
 
         bool traceAuction = auction->id.hash() % 10 == 0;
 
+        typedef AgentFilterCounters FC;
+
         const auto& augList = augInfo->auction->augmentations;
 
+        /* Agents whose accounts match the same augmentation entries see the
+           same augmentations so each distinct view is only rendered once per
+           auction and then shared between the AUCTION messages.
+        */
+        std::map<std::vector<unsigned>, std::shared_ptr<const std::string> >
+            renderedAugs;
+        std::vector<unsigned> augKey;
+
+        auto renderAugmentations = [&] (const AccountKey & account)
+            {
+                augKey.clear();
+                for (const auto& aug : augList) {
+                    aug.second.matchAccount(account, augKey);
+                    augKey.push_back(-1); // Separates the augmentors
+                }
+
+                auto & rendered = renderedAugs[augKey];
+                if (!rendered) {
+                    Json::Value aggregatedAug;
+                    for (const auto& aug : augList) {
+                        aggregatedAug[aug.first] =
+                            aug.second.filterForAccount(account).toJson();
+                    }
+                    rendered = std::make_shared<const std::string>(
+                            chomp(aggregatedAug.toString()));
+                }
+                return rendered;
+            };
+
+        Blacklist::Lookup blacklistLookup = blacklist.lookup(*auction->request);
+
         /* For each round-robin group, send the request off to exactly one
            element. */
         for (auto it = groupAgents.begin(), end = groupAgents.end();
@@ -1432,6 +1550,12 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                                         reason);
                     };
 
+                auto doFilterCount = [&] (FC::Reason reason)
+                    {
+                        if (info.filterCounters)
+                            info.filterCounters->hit(reason);
+                    };
+
                 auto doFilterMetric = [&] (const char * reason, float val)
                     {
                         if (!traceAuction) return;
@@ -1442,13 +1566,13 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                     };
 
 
-                doFilterStat("intoDynamicFilters");
+                doFilterCount(FC::INTO_DYNAMIC_FILTERS);
 
                 /* Check if we have too many in flight. */
                 if (info.numBidsInFlight() >= info.config->maxInFlight) {
                     ++info.stats->tooManyInFlight;
                     bidder.inFlightProp = PotentialBidder::NULL_PROP;
-                    doFilterStat("dynamic.tooManyInFlight");
+                    doFilterCount(FC::DYNAMIC_TOO_MANY_IN_FLIGHT);
                     continue;
                 }
 
@@ -1491,7 +1615,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
                     ML::atomic_inc(info.stats->notEnoughTime);
                     bidder.inFlightProp = PotentialBidder::NULL_PROP;
-                    doFilterStat("dynamic.notEnoughTime");
+                    doFilterCount(FC::DYNAMIC_NOT_ENOUGH_TIME);
                     doFilterMetric("metric.timeUsedBeforeDynamicFilter",
                                    timeUsedMs);
                     doFilterMetric("metric.timeLeftBeforeDynamicFilter",
@@ -1535,10 +1659,11 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
                 /* Check that there is no blacklist hit on the user. */
                 if (config.hasBlacklist()
-                    && blacklist.matches(*auction->request, bidder.agent,
+                    && !blacklistLookup.empty()
+                    && blacklist.matches(blacklistLookup, bidder.agent,
                                          config)) {
                     ML::atomic_inc(info.stats->userBlacklisted);
-                    doFilterStat("dynamic.userBlacklisted");
+                    doFilterCount(FC::DYNAMIC_USER_BLACKLISTED);
                     continue;
                 }
 
@@ -1546,7 +1671,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                     = info.numBidsInFlight() / max(info.config->maxInFlight, 1);
 
                 ML::atomic_inc(info.stats->passedDynamicFilters);
-                doFilterStat("passedDynamicFilters");
+                doFilterCount(FC::PASSED_DYNAMIC_FILTERS);
             }
 
             // Sort the roundrobin infos to find the best one
@@ -1582,12 +1707,8 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
 
             ++info.stats->auctions;
 
-            Json::Value aggregatedAug;
-            for (const auto& aug : augList) {
-                aggregatedAug[aug.first] =
-                    aug.second.filterForAccount(winner.config->account).toJson();
-            }
-            auction->agentAugmentations[agent] = chomp(aggregatedAug.toString());
+            auction->agentAugmentations.set(
+                    agent, renderAugmentations(winner.config->account));
 
             //auctionInfo.activities.push_back("sent to " + agent);
 
@@ -1595,6 +1716,10 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
             bidInfo.agentConfig = winner.config;
             bidInfo.bidTime = Date::now();
             bidInfo.imp = winner.imp;
+            bidInfo.wcm = auction->exchangeConnector->getWinCostModel(*auction,
+                                                                      *winner.config);
+            bidInfo.wcmStr = bidInfo.wcm.toJsonStr();
+            const std::string wcmStr = bidInfo.wcmStr;
 
             auctionInfo.bidders.insert(make_pair(agent, std::move(bidInfo)));  // create empty bid response
             if (!info.trackBidInFlight(auctionId, bidInfo.bidTime))
@@ -1603,9 +1728,6 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                                agent.c_str(),
                                auctionId.toString().c_str());
 
-            WinCostModel wcm = auction->exchangeConnector->getWinCostModel(*auction,
-                                                                           *winner.config);
-
             //cerr << "sending to agent " << agent << endl;
             //cerr << fName << " sending AUCTION message " << endl;c
             /* Convert to JSON to send it on. */
@@ -1618,7 +1740,7 @@ doStartBidding(const std::shared_ptr<AugmentationInfo> & augInfo)
                              winner.imp.toJsonStr(),
                              toString(timeLeftMs),
                              auction->agentAugmentations[agent],
-                             wcm.toJson());
+                             wcmStr);
 
             //cerr << "done" << endl;
         }
@@ -1675,6 +1797,19 @@ addAuction(std::shared_ptr<Auction> auction, Date lossTimeout)
 }
 
 
+/** Printable form of a binary payload for the logs. */
+static std::string hexDump(const std::string & data)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string result;
+    result.reserve(data.size() * 2);
+    for (unsigned char c: data) {
+        result += digits[c >> 4];
+        result += digits[c & 15];
+    }
+    return result;
+}
+
 static bool failBid(double proportion)
 {
     if (proportion < 0.01)
@@ -1745,11 +1880,9 @@ doBid(const std::vector<std::string> & message)
     Id auctionId(message[2]);
 
     const string & agent = message[0];
-    const string & biddata = message[3];
+    const string & rawBids = message[3];
     const string & model = message[4];
 
-    WinCostModel wcm = WinCostModel::fromJson(model.empty() ? Json::Value() : Json::parse(model));
-
     static const string nullStr("null");
     const string & meta = (message.size() >= 6 ? message[5] : nullStr);
 
@@ -1806,6 +1939,25 @@ doBid(const std::vector<std::string> & message)
 
     int numValidBids = 0;
 
+    /* Agents may send their bids in binary; those are only rendered as
+       JSON for the messages and logs that carry them, which a response that
+       passes on every spot never needs. */
+    Bids bids;
+    bool binaryBids = Bids::isBinary(rawBids);
+    string renderedBids;
+
+    auto biddata = [&] () -> const string &
+        {
+            if (!binaryBids)
+                return rawBids;
+            if (renderedBids.empty()) {
+                Json::FastWriter writer;
+                renderedBids = writer.write(bids.toJson());
+                boost::trim(renderedBids);
+            }
+            return renderedBids;
+        };
+
     auto returnInvalidBid = [&] (int i, const char * reason,
                                  const char * message, ...)
         {
@@ -1831,14 +1983,14 @@ doBid(const std::vector<std::string> & message)
 
             cerr << "invalid bid for agent " << agent << ": "
                  << formatted << endl;
-            cerr << biddata << endl;
+            cerr << biddata() << endl;
 
             this->sendBidResponse
                 (agent, info, BS_INVALID, this->getCurrentTime(),
                  formatted, auctionId,
                  i, Amount(),
                  auctionInfo.auction.get(),
-                 biddata, Json::Value(),
+                 biddata(), Json::Value(),
                  auctionInfo.auction->agentAugmentations[agent]);
         };
 
@@ -1847,15 +1999,28 @@ doBid(const std::vector<std::string> & message)
 
     doProfileEvent(6, "bidInfo");
 
+    /* Agents normally echo back the model that we sent them, in which case
+       we already have it and there's no need to parse it. */
+    WinCostModel wcm;
+    if (model == bidInfo.wcmStr)
+        wcm = std::move(bidInfo.wcm);
+    else if (!model.empty())
+        wcm = WinCostModel::fromJson(Json::parse(model));
+
     int numPassedBids = 0;
 
-    Bids bids;
     try {
-        bids = Bids::fromJson(biddata);
+        if (binaryBids)
+            bids = Bids::fromBinary(rawBids.data(), rawBids.size());
+        else bids = Bids::fromJson(rawBids);
     }
     catch (const std::exception & exc) {
+        // Nothing was decoded, so log what the agent sent rather than the
+        // empty bid list.
+        if (binaryBids)
+            renderedBids = "binary:" + hexDump(rawBids);
         returnInvalidBid(-1, "bidParseError",
-                "couldn't parse bid JSON %s: %s", biddata.c_str(), exc.what());
+                "couldn't parse bid %s: %s", biddata().c_str(), exc.what());
         return;
     }
 
@@ -1880,7 +2045,7 @@ doBid(const std::vector<std::string> & message)
         if (bid.creativeIndex == -1) {
             returnInvalidBid(i, "nullCreativeField",
                     "creative field is null in response %s",
-                    biddata.c_str());
+                    biddata().c_str());
             continue;
         }
 
@@ -1890,7 +2055,7 @@ doBid(const std::vector<std::string> & message)
             returnInvalidBid(i, "outOfRangeCreative",
                     "parsing field 'creative' of %s: creative "
                     "number %d out of range 0-%zd",
-                    biddata.c_str(), bid.creativeIndex,
+                    biddata().c_str(), bid.creativeIndex,
                     config.creatives.size());
             continue;
         }
@@ -1900,7 +2065,7 @@ doBid(const std::vector<std::string> & message)
                     "bid price of %s is outside range of $0-%s parsing bid %s",
                     bid.price.toString().c_str(),
                     maxBidAmount.toString().c_str(),
-                    biddata.c_str());
+                    biddata().c_str());
             continue;
         }
 
@@ -1912,7 +2077,7 @@ doBid(const std::vector<std::string> & message)
             cerr << "auction: " << auctionInfo.auction->requestStr
                 << endl;
             cerr << "config: " << config.toJson() << endl;
-            cerr << "bid: " << biddata << endl;
+            cerr << "bid: " << biddata() << endl;
             cerr << "spot: " << imp[i].toJson() << endl;
             cerr << "spot num: " << spotIndex << endl;
             cerr << "bid num: " << i << endl;
@@ -1954,9 +2119,9 @@ doBid(const std::vector<std::string> & message)
                     this->getCurrentTime(),
                     "guaranteed", auctionId, 0, Amount(),
                     auctionInfo.auction.get(),
-                    biddata, meta, agentAugmentations);
+                    biddata(), meta, agentAugmentations);
             this->logMessage("NOBUDGET", agent, auctionId,
-                    biddata, meta);
+                    biddata(), meta);
             continue;
         }
 
@@ -1979,7 +2144,7 @@ doBid(const std::vector<std::string> & message)
                 config.account,
                 config.test,
                 agent,
-                biddata,
+                biddata(),
                 meta,
                 info.config,
                 config.visitChannels,
@@ -2043,8 +2208,8 @@ doBid(const std::vector<std::string> & message)
                     this->getCurrentTime(),
                     "guaranteed", auctionId, 0, Amount(),
                     auctionInfo.auction.get(),
-                    biddata, meta, agentAugmentations);
-            this->logMessage(msg, agent, auctionId, biddata, meta);
+                    biddata(), meta, agentAugmentations);
+            this->logMessage(msg, agent, auctionId, biddata(), meta);
             continue;
         }
         case Auction::WinLoss::WIN:
@@ -2062,7 +2227,7 @@ doBid(const std::vector<std::string> & message)
     if (numValidBids > 0) {
         if (logBids)
             // Send BID to logger
-            logMessage("BID", agent, auctionId, biddata, meta);
+            logMessage("BID", agent, auctionId, biddata(), meta);
         ML::atomic_add(numNonEmptyBids, 1);
     }
     else if (numPassedBids > 0) {
@@ -2086,6 +2251,7 @@ doBid(const std::vector<std::string> & message)
     recordOutcome(1000.0 * bidTime,
                   "accounts.%s.bidResponseTimeMs",
                   config.account.toString('.'));
+    latency.recordAgent(agent, bidTime);
 
     doProfileEvent(9, "postTiming");
 
@@ -2368,6 +2534,12 @@ onAuctionDone(std::shared_ptr<Auction> auction)
     backtrace();
 #endif
 
+    // Called by the exchange connector just before the response is written
+    if (auction->exchangeConnector)
+        latency.record(AuctionLatency::RESPONSE,
+                       auction->exchangeConnector->exchangeName(),
+                       auction->start, Date::now());
+
     debugAuction(auction->id, "SENT SUBMITTED");
     submittedBuffer.push(auction);
 }
@@ -2395,6 +2567,7 @@ updateAllAgents()
             entry.config = it->second.config;
             entry.stats = it->second.stats;
             entry.status = it->second.status;
+            entry.filterCounters = it->second.filterCounters;
             int i = newInfo->size();
             newInfo->push_back(entry);
 
@@ -2434,6 +2607,8 @@ doConfig(const std::string & agent,
     }
 
     info.config = newConfig;
+    info.filterCounters = std::make_shared<AgentFilterCounters>
+        (metrics, newConfig->account);
     //cerr << "configured " << agent << " strategy : " << info.config->strategy << " campaign "
     //     <<  info.config->campaign << endl;
 
@@ -2446,10 +2621,41 @@ doConfig(const std::string & agent,
 
     info.filterIndex = filters.addConfig(agent, info);
 
+    if (preFilterShedding)
+        updatePreFilters();
+
     // Broadcast that we have a new agent or it has a new configuration
     updateAllAgents();
 }
 
+void
+Router::
+updatePreFilters()
+{
+    forAllExchanges([&] (const std::shared_ptr<ExchangeConnector> & exchange) {
+        auto name = exchange->exchangeName();
+        auto filter = std::make_shared<BidRequestPreFilter>();
+
+        for (auto & agent: agents) {
+            const AgentInfo & info = agent.second;
+            if (!info.configured) continue;
+
+            AgentConfig & config = *info.config;
+            if (!config.exchangeFilter.isIncluded(name)) continue;
+
+            // Only agents that configureAgentOnExchange found compatible
+            {
+                std::lock_guard<ML::Spinlock> guard(config.lock);
+                if (!config.providerData.count(name)) continue;
+            }
+
+            filter->addAgent(config);
+        }
+
+        exchange->setPreFilter(filter);
+    });
+}
+
 void
 Router::
 unconfigure(const std::string & agent, const AgentConfig & config)
@@ -2481,6 +2687,9 @@ configureAgentOnExchange(std::shared_ptr<ExchangeConnector> const & exchange,
         else {
             std::lock_guard<ML::Spinlock> guard(c.lock);
             c.providerData[name] = ccomp.info;
+            if (ccomp.constraints)
+                c.providerConstraints[name] = ccomp.constraints;
+            else c.providerConstraints.erase(name);
             ++numCompatibleCreatives;
         }
     }
@@ -2554,6 +2763,13 @@ getAllAgentInfo() const
     return result;
 }
 
+Json::Value
+Router::
+getLatencyStats() const
+{
+    return latency.toJson();
+}
+
 void
 Router::
 sendPings()
@@ -21,6 +21,7 @@
 #include "soa/service/loop_monitor.h"
 #include "augmentation_loop.h"
 #include "router_types.h"
+#include "latency_histogram.h"
 #include "soa/gc/gc_lock.h"
 #include "jml/utils/ring_buffer.h"
 #include "jml/arch/wakeup_fd.h"
@@ -28,6 +29,7 @@
 #include <unordered_set>
 #include <thread>
 #include "rtbkit/common/exchange_connector.h"
+#include "rtbkit/common/log_record.h"
 #include "rtbkit/core/agent_configuration/blacklist.h"
 #include "rtbkit/core/agent_configuration/agent_configuration_listener.h"
 #include "rtbkit/core/agent_configuration/agent_config.h"
@@ -52,6 +54,7 @@ struct AgentInfoEntry {
     std::shared_ptr<const AgentConfig> config;
     std::shared_ptr<const AgentStatus> status;
     std::shared_ptr<AgentStats> stats;
+    std::shared_ptr<const AgentFilterCounters> filterCounters;
 
     bool valid() const { return config && stats; }
 
@@ -320,6 +323,11 @@ struct Router : public ServiceBase,
     /** Return information about all agents. */
     Json::Value getAllAgentInfo() const;
 
+    /** Return the latency percentiles of each auction stage, per exchange,
+        and of the responses of each agent.
+    */
+    Json::Value getLatencyStats() const;
+
     /** Return information about all agents bidding on the given
         account. */
     Json::Value getAccountInfo(const AccountKey & account) const;
@@ -396,6 +404,11 @@ public:
 
     ML::Wakeup_Fd wakeupMainLoop;
 
+    /** Metrics of the auction hot path; the per-agent handles live in the
+        AgentInfo.
+    */
+    MetricRegistry metrics;
+
     FilterPool filters;
 
     AugmentationLoop augmentationLoop;
@@ -415,6 +428,35 @@ public:
     DutyCycleEntry dutyCycleCurrent;
     std::vector<DutyCycleEntry> dutyCycleHistory;
 
+    /** Tuning of the main loop; must be set before start().  The defaults
+        handle one agent message per wakeup and, when idle, sleep at most
+        once every half millisecond before blocking.
+    */
+    struct LoopOptions {
+        LoopOptions()
+            : agentBatch(1), spinSeconds(0.0), sleepInterval(0.0005), cpu(-1)
+        {
+        }
+
+        int agentBatch;         ///< Max agent messages handled per wakeup
+        double spinSeconds;     ///< Busy poll for this long before blocking
+        double sleepInterval;   ///< Min time between two idle sleeps
+        int cpu;                ///< Core to pin the loop thread to, or -1
+    };
+
+    LoopOptions loopOptions;
+
+    /** Shed the requests that no agent can bid on before randomly shedding
+        the others; see BidRequestPreFilter.  Must be set before start().
+    */
+    bool preFilterShedding;
+
+    /** Rebuild and publish the pre-filter of every exchange. */
+    void updatePreFilters();
+
+    /** Latency histograms of each auction stage; see getLatencyStats(). */
+    AuctionLatency latency;
+
     void run();
 
     void handleAgentMessage(const std::vector<std::string> & message);
@@ -589,8 +631,7 @@ public:
                         const std::string & exception,
                         Args... args)
     {
-        logger.publish("ROUTERERROR", Date::now().print(5),
-                       function, exception, args...);
+        logMessage("ROUTERERROR", function, exception, args...);
         recordHit("error.%s", function);
     }
 
@@ -680,13 +721,19 @@ public:
     /** Log bids */
     bool logBids;
 
+    /** Publish log messages as binary LogRecords instead of text. */
+    bool binaryLogs;
+
     /** Log a given message to the given channel. */
     template<typename... Args>
     void logMessage(const std::string & channel, Args... args)
     {
         using namespace std;
         //cerr << "********* logging message to " << channel << endl;
-        logger.publish(channel, Date::now().print(5), args...);
+        if (binaryLogs)
+            logger.publish(channel,
+                           LogRecord::encode(channel, Date::now(), args...));
+        else logger.publish(channel, Date::now().print(5), logField(args)...);
     }
 
     /** Log a given message to the given channel. */
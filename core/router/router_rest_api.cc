@@ -34,6 +34,8 @@ doGet(const std::string& resource)
 {
     if (header.resource == "/stats")
         sendResponse(router->getStats());
+    else if (header.resource == "/latency")
+        sendResponse(router->getLatencyStats());
     else if (header.resource == "/agents") {
         sendResponse(router->getAllAgentInfo());
     }
@@ -43,7 +43,12 @@ RouterRunner() :
     lossSeconds(15.0),
     logAuctions(false),
     logBids(false),
-    maxBidPrice(200)
+    binaryLogs(false),
+    maxBidPrice(200),
+    loopAgentBatch(1),
+    loopSpinUs(0.0),
+    loopCpu(-1),
+    preFilterShedding(false)
 {
 }
 
@@ -66,8 +71,19 @@ doOptions(int argc, char ** argv,
          "log auction requests")
         ("log-bids", value<bool>(&logBids)->zero_tokens(),
          "log bid responses")
+        ("log-binary", value<bool>(&binaryLogs)->zero_tokens(),
+         "publish logs as binary records")
         ("max-bid-price", value(&maxBidPrice),
-         "maximum bid price accepted by router");
+         "maximum bid price accepted by router")
+        ("loop-agent-batch", value<int>(&loopAgentBatch),
+         "maximum number of agent messages handled per loop wakeup")
+        ("loop-spin-us", value<double>(&loopSpinUs),
+         "microseconds to busy poll for before blocking; disables the "
+         "idle sleep when set")
+        ("loop-cpu", value<int>(&loopCpu),
+         "cpu to pin the router loop thread to")
+        ("prefilter-shedding", value<bool>(&preFilterShedding)->zero_tokens(),
+         "when shedding load, drop requests no agent can bid on first");
 
     options_description all_opt = opts;
     all_opt
@@ -102,6 +118,14 @@ init()
     router = std::make_shared<Router>(proxies, serviceName, lossSeconds,
                                       true, logAuctions, logBids,
                                       USD_CPM(maxBidPrice));
+    router->binaryLogs = binaryLogs;
+    router->loopOptions.agentBatch = loopAgentBatch;
+    router->loopOptions.cpu = loopCpu;
+    router->preFilterShedding = preFilterShedding;
+    if (loopSpinUs > 0.0) {
+        router->loopOptions.spinSeconds = loopSpinUs / 1000000.0;
+        router->loopOptions.sleepInterval = 0.0;
+    }
     router->init();
 
     banker = std::make_shared<SlaveBanker>(proxies->zmqContext,
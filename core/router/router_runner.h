@@ -33,9 +33,16 @@ struct RouterRunner {
 
     bool logAuctions;
     bool logBids;
+    bool binaryLogs;
 
     float maxBidPrice;
 
+    int loopAgentBatch;
+    double loopSpinUs;
+    int loopCpu;
+
+    bool preFilterShedding;
+
     void doOptions(int argc, char ** argv,
                    const boost::program_options::options_description & opts
                    = boost::program_options::options_description());
@@ -98,6 +98,96 @@ toJson() const
     return result;
 }
 
+/*****************************************************************************/
+/* BIDS IN FLIGHT                                                            */
+/*****************************************************************************/
+
+namespace {
+
+int64_t toMs(Date date)
+{
+    return date.secondsSinceEpoch() * 1000.0;
+}
+
+} // file scope
+
+BidsInFlight::
+BidsInFlight()
+    : dateSumMs(0)
+{
+}
+
+BidsInFlight::
+BidsInFlight(const BidsInFlight & other)
+    : dateSumMs(0)
+{
+    *this = other;
+}
+
+BidsInFlight &
+BidsInFlight::
+operator = (const BidsInFlight & other)
+{
+    if (this == &other) return *this;
+
+    // The index points into our own list so it must be rebuilt
+    bids.clear();
+    index.clear();
+    dateSumMs = 0;
+    other.forEach([&] (const Id & id, Date date) { insert(id, date); });
+    return *this;
+}
+
+bool
+BidsInFlight::
+insert(const Id & id, Date date)
+{
+    auto res = index.insert(std::make_pair(id, bids.end()));
+    if (!res.second)
+        return false;
+
+    res.first->second = bids.insert(bids.end(), std::make_pair(id, date));
+    dateSumMs += toMs(date);
+    return true;
+}
+
+bool
+BidsInFlight::
+erase(const Id & id)
+{
+    auto it = index.find(id);
+    if (it == index.end())
+        return false;
+
+    dateSumMs -= toMs(it->second->second);
+    bids.erase(it->second);
+    index.erase(it);
+    return true;
+}
+
+bool
+BidsInFlight::
+oldest(Id & id, Date & date) const
+{
+    if (bids.empty()) return false;
+    id = bids.front().first;
+    date = bids.front().second;
+    return true;
+}
+
+double
+BidsInFlight::
+averageAge(Date now) const
+{
+    if (index.empty()) return 0.0;
+    return now.secondsSinceEpoch() - dateSumMs / 1000.0 / index.size();
+}
+
+
+/*****************************************************************************/
+/* AGENT INFO                                                                */
+/*****************************************************************************/
+
 Json::Value
 AgentInfo::
 toJson(bool includeConfig, bool includeStats) const
@@ -141,6 +231,34 @@ setBidRequestFormat(const std::string & val)
     // TODO
 }
 
+const char *
+AgentFilterCounters::
+reasonName(Reason reason)
+{
+    switch (reason) {
+    case INTO_STATIC_FILTERS:             return "intoStaticFilters";
+    case STATIC_AGENT_APPEARS_DEAD:       return "static.agentAppearsDead";
+    case STATIC_EARLY_TOO_MANY_IN_FLIGHT: return "static.earlyTooManyInFlight";
+    case STATIC_NOT_ENOUGH_TIME:          return "static.notEnoughTime";
+    case PASSED_STATIC_FILTERS:           return "passedStaticFilters";
+    case INTO_DYNAMIC_FILTERS:            return "intoDynamicFilters";
+    case DYNAMIC_TOO_MANY_IN_FLIGHT:      return "dynamic.tooManyInFlight";
+    case DYNAMIC_NOT_ENOUGH_TIME:         return "dynamic.notEnoughTime";
+    case DYNAMIC_USER_BLACKLISTED:        return "dynamic.userBlacklisted";
+    case PASSED_DYNAMIC_FILTERS:          return "passedDynamicFilters";
+    default:
+        throw ML::Exception("unknown filter reason %d", reason);
+    }
+}
+
+AgentFilterCounters::
+AgentFilterCounters(MetricRegistry & registry, const AccountKey & account)
+{
+    string prefix = "accounts." + account.toString('.') + ".filter.";
+    for (unsigned i = 0;  i < NUM_REASONS;  ++i)
+        counters[i] = registry.counter(prefix + reasonName(Reason(i)));
+}
+
 AgentStats::
 AgentStats()
     : auctions(0), bids(0), wins(0), losses(0), tooLate(0),
@@ -11,9 +11,12 @@
 #include "rtbkit/common/bid_request.h"
 #include "rtbkit/common/auction.h"
 #include "jml/stats/distribution.h"
+#include <list>
 #include <set>
+#include <unordered_map>
 #include "rtbkit/common/currency.h"
 #include "rtbkit/common/bids.h"
+#include "rtbkit/common/metric_registry.h"
 
 
 namespace RTBKIT {
@@ -104,6 +107,85 @@ struct AgentStatus {
     size_t numBidsInFlight;
 };
 
+
+/** Counters of the "accounts.<account>.filter.<reason>" keys of an agent for
+    the fixed filter reasons, resolved once when the agent is configured.
+*/
+struct AgentFilterCounters {
+
+    enum Reason {
+        INTO_STATIC_FILTERS,
+        STATIC_AGENT_APPEARS_DEAD,
+        STATIC_EARLY_TOO_MANY_IN_FLIGHT,
+        STATIC_NOT_ENOUGH_TIME,
+        PASSED_STATIC_FILTERS,
+        INTO_DYNAMIC_FILTERS,
+        DYNAMIC_TOO_MANY_IN_FLIGHT,
+        DYNAMIC_NOT_ENOUGH_TIME,
+        DYNAMIC_USER_BLACKLISTED,
+        PASSED_DYNAMIC_FILTERS,
+
+        NUM_REASONS
+    };
+
+    static const char * reasonName(Reason reason);
+
+    AgentFilterCounters(MetricRegistry & registry, const AccountKey & account);
+
+    void hit(Reason reason) const
+    {
+        counters[reason].hit();
+    }
+
+private:
+    MetricRegistry::Counter counters[NUM_REASONS];
+};
+
+/** Auctions an agent is bidding on, ordered by the date they were sent.
+
+    Bids are tracked as they are sent so appending keeps the list ordered by
+    date: insertion and removal are constant time and expiring old bids only
+    costs the number of bids expired, whatever the number in flight.
+*/
+struct BidsInFlight {
+    BidsInFlight();
+    BidsInFlight(const BidsInFlight & other);
+    BidsInFlight & operator = (const BidsInFlight & other);
+
+    size_t size() const { return index.size(); }
+    bool empty() const { return index.empty(); }
+
+    /** Returns false if the auction was already in flight. */
+    bool insert(const Id & id, Date date);
+
+    /** Returns false if the auction wasn't in flight. */
+    bool erase(const Id & id);
+
+    /** Oldest auction in flight; returns false if there are none. */
+    bool oldest(Id & id, Date & date) const;
+
+    /** Average number of seconds the auctions have been in flight. */
+    double averageAge(Date now) const;
+
+    template<typename Fn>
+    void forEach(const Fn & fn) const
+    {
+        for (auto it = bids.begin(), end = bids.end();  it != end;  ++it)
+            fn(it->first, it->second);
+    }
+
+private:
+    struct IdHash {
+        size_t operator () (const Id & id) const { return id.hash(); }
+    };
+
+    typedef std::list<std::pair<Id, Date> > Bids;
+
+    Bids bids;                                          ///< Oldest first
+    std::unordered_map<Id, Bids::iterator, IdHash> index;
+    int64_t dateSumMs;                    ///< For the average without a scan
+};
+
 /// Information about a agent
 struct AgentInfo {
     AgentInfo()
@@ -126,6 +208,7 @@ struct AgentInfo {
     std::shared_ptr<AgentConfig> config;
     std::shared_ptr<AgentStatus> status;
     std::shared_ptr<AgentStats> stats;
+    std::shared_ptr<const AgentFilterCounters> filterCounters;
     double throttleProbability;
 
     /** Address of the zeromq socket for this agent. */
@@ -195,13 +278,11 @@ struct AgentInfo {
         status->dead = false;
     }
 
+    /** Calls fn(id, date) for the auctions in flight, oldest first. */
     template<typename Fn>
     void forEachInFlight(const Fn & fn) const
     {
-        for (auto it = bidsInFlight.begin(), end = bidsInFlight.end();
-             it != end;  ++it) {
-            fn(it->first, it->second);
-        }
+        bidsInFlight.forEach(fn);
     }
 
     size_t numBidsInFlight() const
@@ -211,7 +292,19 @@ struct AgentInfo {
             throw ML::Exception("numBidsInFlight is wrong");
         return status->numBidsInFlight;
     }
-    
+
+    /** Oldest auction in flight; returns false if there are none. */
+    bool oldestBidInFlight(Id & id, Date & date) const
+    {
+        return bidsInFlight.oldest(id, date);
+    }
+
+    /** Average number of seconds the auctions have been in flight. */
+    double averageAgeInFlight(Date now) const
+    {
+        return bidsInFlight.averageAge(now);
+    }
+
     bool expireBidInFlight(const Id & id)
     {
         bool result = bidsInFlight.erase(id);
@@ -222,13 +315,13 @@ struct AgentInfo {
     // Returns true if it was successfully inserted
     bool trackBidInFlight(const Id & id, Date date = Date::now())
     {
-        bool result = bidsInFlight.insert(std::make_pair(id, date)).second;
+        bool result = bidsInFlight.insert(id, date);
         status->numBidsInFlight = bidsInFlight.size();
         return result;
     }
 
 private:
-    std::map<Id, Date> bidsInFlight;  /// Auctions in which we're participating
+    BidsInFlight bidsInFlight;  /// Auctions in which we're participating
     //std::set<std::pair<Id, Id> > awaitingResult;  ///< Auctions which are awaiting a win/loss result
 };
 
@@ -283,6 +376,8 @@ struct BidInfo {
     Date bidTime;
     BiddableSpots imp;
     std::shared_ptr<const AgentConfig> agentConfig;  //< config active at auction
+    WinCostModel wcm;       //< win cost model sent to the agent
+    std::string wcmStr;     //< wire form of wcm, to recognize it when echoed
 };
 
 // Information about an in-flight auction
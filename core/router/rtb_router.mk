@@ -17,6 +17,7 @@ LIBRTB_ROUTER_SOURCES := \
 	augmentation_loop.cc \
 	router.cc \
 	router_types.cc \
+	latency_histogram.cc \
 	router_stack.cc \
 	filter_pool.cc
 
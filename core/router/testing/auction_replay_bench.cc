@@ -0,0 +1,463 @@
+/* auction_replay_bench.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Replays a recorded corpus of bid requests through the router's auction
+   path (parsing, the filter pool and the auction itself) against a set of
+   synthetic agents, and reports the throughput, the latency of each stage
+   and the number of allocations per auction as JSON.
+
+   Everything that could make two runs differ is pinned down: the agents
+   and their bids come from a seeded generator, and the auctions are dated
+   by a virtual clock instead of the wall clock.  The decisions taken are
+   summed up in a digest so that two runs can be checked to have replayed
+   the same thing before their timings are compared.
+*/
+
+#include "rtbkit/core/router/filter_pool.h"
+#include "rtbkit/core/router/router_types.h"
+#include "rtbkit/core/router/latency_histogram.h"
+#include "rtbkit/core/agent_configuration/agent_config.h"
+#include "rtbkit/common/auction.h"
+#include "rtbkit/common/bid_request.h"
+#include "rtbkit/common/exchange_connector.h"
+#include "rtbkit/plugins/bid_request/openrtb_bid_request.h"
+#include "jml/utils/filter_streams.h"
+#include "jml/arch/exception.h"
+#include "rtbkit/common/testing/allocation_counter.h"
+
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/positional_options.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+
+using namespace std;
+using namespace ML;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+
+/*****************************************************************************/
+/* CORPUS                                                                    */
+/*****************************************************************************/
+
+/** A recorded bid request and how to parse it. */
+struct Sample {
+    std::string payload;
+    bool canonical;         ///< Datacratic format rather than OpenRTB
+    std::string exchange;
+};
+
+bool endsWith(const std::string & str, const std::string & suffix)
+{
+    return str.size() >= suffix.size()
+        && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/** Loads one of the corpora found in the tree:
+
+    - .json files hold a single OpenRTB request;
+    - other files hold one request per line, either in the Datacratic format
+      (20000-datacratic-auctions.xz) or as OpenRTB, or whole HTTP requests
+      whose body is an OpenRTB request (rubicon-samples.txt.gz).
+
+    Compressed files are handled by filter_istream.
+*/
+void loadCorpus(const std::string & filename,
+                const std::string & openRtbExchange,
+                std::vector<Sample> & samples)
+{
+    ML::filter_istream stream(filename);
+    if (!stream)
+        throw ML::Exception("couldn't open corpus " + filename);
+
+    auto addOpenRtb = [&] (std::string payload)
+        {
+            samples.push_back({ std::move(payload), false, openRtbExchange });
+        };
+
+    if (endsWith(filename, ".json")) {
+        std::string payload, line;
+        while (getline(stream, line))
+            payload += line + "\n";
+        addOpenRtb(std::move(payload));
+        return;
+    }
+
+    std::string line;
+    while (getline(stream, line)) {
+        if (line.empty()) continue;
+
+        if (line.compare(0, 8, "{\"!!CV\":") == 0) {
+            samples.push_back({ line, true, "" });
+        }
+        else if (line[0] == '{') {
+            addOpenRtb(line);
+        }
+        else if (line.compare(0, 5, "POST ") == 0) {
+            size_t contentLength = 0;
+            while (getline(stream, line)) {
+                if (!line.empty() && line.back() == '\r')
+                    line.resize(line.size() - 1);
+                if (line.empty()) break;
+                if (strncasecmp(line.c_str(), "content-length:", 15) == 0)
+                    contentLength = strtoul(line.c_str() + 15, nullptr, 10);
+            }
+
+            std::string payload(contentLength, '\0');
+            stream.read(&payload[0], contentLength);
+            if (size_t(stream.gcount()) != contentLength)
+                throw ML::Exception("truncated request in " + filename);
+            addOpenRtb(std::move(payload));
+        }
+    }
+}
+
+
+/*****************************************************************************/
+/* REPLAY EXCHANGE CONNECTOR                                                 */
+/*****************************************************************************/
+
+/** Connector standing in for the exchange the requests came from; it has the
+    default compatibility and filtering rules.
+*/
+struct ReplayExchangeConnector : public ExchangeConnector {
+
+    ReplayExchangeConnector(const std::string & name)
+        : ExchangeConnector(name), name(name)
+    {
+    }
+
+    std::string exchangeName() const { return name; }
+
+    void configure(const Json::Value & parameters) {}
+    void enableUntil(Date date) {}
+
+private:
+    std::string name;
+};
+
+
+/*****************************************************************************/
+/* SYNTHETIC AGENTS                                                          */
+/*****************************************************************************/
+
+bool coin(std::mt19937 & rng, double probability)
+{
+    return rng() < probability * rng.max();
+}
+
+/** Agent with a random mix of creative formats and of the commonly used
+    filters.
+*/
+Json::Value agentConfig(unsigned index, std::mt19937 & rng,
+                        const std::vector<std::string> & exchanges)
+{
+    static const int formats[][2] = {
+        { 728, 90 }, { 300, 250 }, { 160, 600 }, { 300, 600 }, { 468, 60 }
+    };
+
+    Json::Value result;
+    result["account"]
+        = AccountKey({ "bench", "agent" + to_string(index) }).toJson();
+
+    // Every agent gets at least the last format
+    for (unsigned i = 0;  i < sizeof(formats) / sizeof(formats[0]);  ++i) {
+        bool last = i + 1 == sizeof(formats) / sizeof(formats[0]);
+        if (!coin(rng, 0.4) && !(last && result["creatives"].isNull()))
+            continue;
+        Json::Value creative;
+        creative["id"] = i;
+        creative["name"] = ML::format("%dx%d", formats[i][0], formats[i][1]);
+        creative["width"] = formats[i][0];
+        creative["height"] = formats[i][1];
+        result["creatives"].append(creative);
+    }
+
+    if (!exchanges.empty() && coin(rng, 0.3))
+        result["exchangeFilter"]["include"]
+            .append(exchanges[rng() % exchanges.size()]);
+    if (coin(rng, 0.3))
+        result["languageFilter"]["include"].append("en");
+    if (coin(rng, 0.2))
+        result["locationFilter"]["include"].append("US:.*");
+    if (coin(rng, 0.2))
+        result["hostFilter"]["exclude"].append("facebook.com");
+
+    return result;
+}
+
+
+/*****************************************************************************/
+/* STAGES                                                                    */
+/*****************************************************************************/
+
+enum Stage {
+    PARSE,
+    FILTER,
+    AUCTION,
+    TOTAL,
+    NUM_STAGES
+};
+
+const char * stageNames[NUM_STAGES] = { "parse", "filter", "auction", "total" };
+
+struct StageStats {
+    StageStats()
+        : allocations(0)
+    {
+    }
+
+    LatencyHistogram latency;
+    uint64_t allocations;
+};
+
+
+/*****************************************************************************/
+/* MAIN                                                                      */
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+    using namespace boost::program_options;
+
+    std::vector<std::string> corpora;
+    std::string openRtbExchange = "openrtb";
+    std::string output;
+    unsigned numAgents = 50;
+    unsigned seed = 1;
+    unsigned passes = 1;
+    unsigned warmup = 1000;
+    double virtualQps = 10000.0;
+
+    options_description options("Options");
+    options.add_options()
+        ("corpus,c", value<std::vector<std::string> >(&corpora),
+         "recorded bid requests to replay; may be repeated")
+        ("openrtb-exchange", value<std::string>(&openRtbExchange),
+         "exchange name given to OpenRTB requests")
+        ("agents,a", value<unsigned>(&numAgents),
+         "number of synthetic agents")
+        ("seed,s", value<unsigned>(&seed),
+         "seed of the agents and of their bids")
+        ("passes,p", value<unsigned>(&passes),
+         "number of times the corpus is replayed")
+        ("warmup,w", value<unsigned>(&warmup),
+         "auctions replayed before measuring")
+        ("virtual-qps", value<double>(&virtualQps),
+         "rate at which the virtual clock hands out auctions")
+        ("output,o", value<std::string>(&output),
+         "file to write the results to instead of stdout")
+        ("help,h", "print this message");
+
+    positional_options_description positional;
+    positional.add("corpus", -1);
+
+    variables_map vm;
+    store(command_line_parser(argc, argv)
+          .options(options).positional(positional).run(), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cerr << options << endl;
+        return 1;
+    }
+
+    if (corpora.empty())
+        corpora.push_back(
+                "rtbkit/core/router/testing/20000-datacratic-auctions.xz");
+
+    std::vector<Sample> samples;
+    for (auto & corpus: corpora)
+        loadCorpus(corpus, openRtbExchange, samples);
+    if (samples.empty())
+        throw ML::Exception("no bid requests in the corpus");
+
+    // One connector per exchange found in the corpus.  The canonical format
+    // carries the exchange in the request itself.
+    std::map<std::string, std::unique_ptr<ReplayExchangeConnector> > connectors;
+    std::vector<std::string> exchanges;
+    for (auto & sample: samples) {
+        if (sample.canonical) {
+            std::unique_ptr<BidRequest> br(
+                    BidRequest::parse("datacratic", sample.payload));
+            sample.exchange = br->exchange;
+        }
+
+        auto & connector = connectors[sample.exchange];
+        if (connector) continue;
+        connector.reset(new ReplayExchangeConnector(sample.exchange));
+        exchanges.push_back(sample.exchange);
+    }
+
+    std::mt19937 rng(seed);
+
+    FilterPool filterPool;
+    FilterPool::initWithDefaultFilters(filterPool);
+
+    for (unsigned i = 0;  i < numAgents;  ++i) {
+        auto config = std::make_shared<AgentConfig>(
+                AgentConfig::createFromJson(agentConfig(i, rng, exchanges)));
+
+        for (auto & entry: connectors) {
+            auto & connector = *entry.second;
+            config->providerData[entry.first]
+                = connector.getCampaignCompatibility(*config, false).info;
+            for (auto & creative: config->creatives) {
+                creative.providerData[entry.first]
+                    = connector.getCreativeCompatibility(creative, false).info;
+            }
+        }
+
+        AgentInfo info;
+        info.config = config;
+        info.configured = true;
+        filterPool.addConfig("agent" + to_string(i), info);
+    }
+
+    StageStats stages[NUM_STAGES];
+    uint64_t numAuctions = 0, numBids = 0, numWins = 0, numBiddable = 0;
+    uint64_t parseErrors = 0, digest = 0;
+
+    Date clock = Date::fromSecondsSinceEpoch(1356998400);
+    double tick = 1.0 / virtualQps;
+
+    auto onAuction = [&] (std::shared_ptr<Auction> auction)
+        {
+            auto & responses = auction->getResponses();
+            for (unsigned spot = 0;  spot < responses.size();  ++spot) {
+                if (responses[spot].empty()) continue;
+                auto & winner = responses[spot].front();
+                if (winner.localStatus != Auction::WinLoss::WIN) continue;
+                ++numWins;
+                digest = digest * 1099511628211ULL
+                    + std::hash<std::string>()(winner.agent)
+                    + winner.price.maxPrice.value;
+            }
+        };
+
+    typedef std::chrono::steady_clock Clock;
+    auto seconds = [] (Clock::time_point from, Clock::time_point to)
+        {
+            return std::chrono::duration<double>(to - from).count();
+        };
+
+    Clock::time_point benchStart;
+    uint64_t total = uint64_t(samples.size()) * passes + warmup;
+
+    for (uint64_t n = 0;  n < total;  ++n) {
+        bool measure = n >= warmup;
+        if (n == warmup)
+            benchStart = Clock::now();
+
+        const Sample & sample = samples[n % samples.size()];
+        auto & connector = *connectors[sample.exchange];
+        clock = clock.plusSeconds(tick);
+
+        uint64_t allocs[NUM_STAGES + 1];
+        Clock::time_point times[NUM_STAGES + 1];
+        allocs[0] = numAllocations();
+        times[0] = Clock::now();
+
+        std::shared_ptr<BidRequest> request;
+        try {
+            if (sample.canonical)
+                request.reset(BidRequest::parse("datacratic", sample.payload));
+            else request.reset(OpenRtbBidRequestParser::parseBidRequest(
+                                       sample.payload,
+                                       sample.exchange, sample.exchange));
+        } catch (const std::exception & exc) {
+            ++parseErrors;
+            continue;
+        }
+        request->timestamp = clock;
+
+        allocs[FILTER] = numAllocations();
+        times[FILTER] = Clock::now();
+
+        auto configs = filterPool.filter(*request, &connector);
+
+        allocs[AUCTION] = numAllocations();
+        times[AUCTION] = Clock::now();
+
+        auto auction = std::make_shared<Auction>(
+                &connector, onAuction, request,
+                sample.payload, sample.canonical ? "datacratic" : "openrtb",
+                clock, clock.plusSeconds(0.1));
+
+        for (auto & entry: configs) {
+            for (auto & spot: entry.biddableSpots) {
+                int creative = spot.second[rng() % spot.second.size()];
+                Auction::Price price(MicroUSD(100 + rng() % 10000),
+                                     rng() % 1000);
+                Auction::Response response(
+                        price, entry.config->creatives[creative].id,
+                        entry.config->account, false, entry.name,
+                        "", "null", entry.config, SegmentList(), creative);
+                if (auction->setResponse(spot.first, response)
+                        == Auction::WinLoss::PENDING)
+                    ++numBids;
+            }
+        }
+        auction->finish();
+
+        allocs[TOTAL] = numAllocations();
+        times[TOTAL] = Clock::now();
+
+        if (!measure) continue;
+
+        ++numAuctions;
+        numBiddable += configs.size();
+        for (unsigned i = 0;  i < TOTAL;  ++i) {
+            stages[i].latency.record(seconds(times[i], times[i + 1]));
+            stages[i].allocations += allocs[i + 1] - allocs[i];
+        }
+        stages[TOTAL].latency.record(seconds(times[0], times[TOTAL]));
+        stages[TOTAL].allocations += allocs[TOTAL] - allocs[0];
+    }
+
+    if (numAuctions == 0)
+        throw ML::Exception("no auctions were measured");
+
+    double elapsed = seconds(benchStart, Clock::now());
+
+    Json::Value result;
+    for (auto & corpus: corpora)
+        result["corpus"].append(corpus);
+    result["samples"] = (Json::Value::UInt)samples.size();
+    result["agents"] = numAgents;
+    result["seed"] = seed;
+    result["passes"] = passes;
+    result["auctions"] = (Json::Value::UInt)numAuctions;
+    result["parseErrors"] = (Json::Value::UInt)parseErrors;
+    result["seconds"] = elapsed;
+    result["auctionsPerSecond"] = numAuctions / elapsed;
+    result["biddableAgentsPerAuction"] = double(numBiddable) / numAuctions;
+    result["bids"] = (Json::Value::UInt)numBids;
+    result["wins"] = (Json::Value::UInt)numWins;
+    result["digest"] = ML::format("%016llx", (unsigned long long)digest);
+
+    for (unsigned i = 0;  i < NUM_STAGES;  ++i) {
+        result["latency"][stageNames[i]]
+            = stages[i].latency.snapshot().toJson();
+        result["allocationsPerAuction"][stageNames[i]]
+            = double(stages[i].allocations) / numAuctions;
+    }
+
+    if (output.empty())
+        cout << result.toStyledString();
+    else {
+        std::ofstream stream(output.c_str());
+        stream << result.toStyledString();
+        if (!stream)
+            throw ML::Exception("couldn't write results to " + output);
+    }
+
+    return 0;
+}
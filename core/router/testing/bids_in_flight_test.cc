@@ -0,0 +1,119 @@
+/* bids_in_flight_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the per agent list of auctions in flight.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/router/router_types.h"
+
+using namespace std;
+using namespace RTBKIT;
+
+namespace {
+
+typedef vector<string> Ids;
+
+/** Auctions in flight, in the order forEach() gives them. */
+Ids inFlight(const BidsInFlight & bids)
+{
+    Ids result;
+    bids.forEach([&] (const Id & id, Date date)
+                 {
+                     result.push_back(id.toString());
+                 });
+    return result;
+}
+
+Date start = Date::fromSecondsSinceEpoch(1368153863);
+
+} // file scope
+
+
+BOOST_AUTO_TEST_CASE( test_bids_in_flight_order )
+{
+    BidsInFlight bids;
+    BOOST_CHECK(bids.empty());
+
+    Id id;
+    Date date;
+    BOOST_CHECK(!bids.oldest(id, date));
+
+    BOOST_CHECK(bids.insert(Id("a"), start));
+    BOOST_CHECK(bids.insert(Id("b"), start.plusSeconds(1)));
+    BOOST_CHECK(bids.insert(Id("c"), start.plusSeconds(2)));
+    BOOST_CHECK(bids.insert(Id("d"), start.plusSeconds(3)));
+    BOOST_CHECK_EQUAL(bids.size(), 4);
+    BOOST_CHECK(inFlight(bids) == Ids({ "a", "b", "c", "d" }));
+
+    // Duplicates are rejected and don't move the original
+    BOOST_CHECK(!bids.insert(Id("b"), start.plusSeconds(4)));
+    BOOST_CHECK_EQUAL(bids.size(), 4);
+    BOOST_CHECK(inFlight(bids) == Ids({ "a", "b", "c", "d" }));
+
+    // Erasing from the middle keeps the others in order
+    BOOST_CHECK(bids.erase(Id("c")));
+    BOOST_CHECK(!bids.erase(Id("c")));
+    BOOST_CHECK(inFlight(bids) == Ids({ "a", "b", "d" }));
+
+    BOOST_CHECK(bids.oldest(id, date));
+    BOOST_CHECK_EQUAL(id, Id("a"));
+    BOOST_CHECK_EQUAL(date, start);
+
+    BOOST_CHECK(bids.erase(Id("a")));
+    BOOST_CHECK(bids.oldest(id, date));
+    BOOST_CHECK_EQUAL(id, Id("b"));
+
+    BOOST_CHECK(bids.erase(Id("b")));
+    BOOST_CHECK(bids.erase(Id("d")));
+    BOOST_CHECK(bids.empty());
+    BOOST_CHECK(!bids.oldest(id, date));
+}
+
+BOOST_AUTO_TEST_CASE( test_bids_in_flight_average_age )
+{
+    BidsInFlight bids;
+    Date now = start.plusSeconds(10);
+    BOOST_CHECK_EQUAL(bids.averageAge(now), 0.0);
+
+    bids.insert(Id("a"), start);                  // 10 seconds old
+    bids.insert(Id("b"), start.plusSeconds(4));   // 6 seconds old
+    bids.insert(Id("c"), start.plusSeconds(8));   // 2 seconds old
+    BOOST_CHECK_CLOSE(bids.averageAge(now), 6.0, 0.01);
+
+    bids.erase(Id("a"));
+    BOOST_CHECK_CLOSE(bids.averageAge(now), 4.0, 0.01);
+
+    // Re-inserting keeps the sum right
+    bids.insert(Id("a"), start.plusSeconds(9));
+    BOOST_CHECK_CLOSE(bids.averageAge(now), 3.0, 0.01);
+}
+
+BOOST_AUTO_TEST_CASE( test_bids_in_flight_copy )
+{
+    BidsInFlight bids;
+    bids.insert(Id("a"), start);
+    bids.insert(Id("b"), start.plusSeconds(1));
+    bids.insert(Id("c"), start.plusSeconds(2));
+
+    // The copy has its own index; erasing from it mustn't touch the
+    // original's list.
+    BidsInFlight copy(bids);
+    BOOST_CHECK(copy.erase(Id("b")));
+    BOOST_CHECK(inFlight(copy) == Ids({ "a", "c" }));
+    BOOST_CHECK(inFlight(bids) == Ids({ "a", "b", "c" }));
+    BOOST_CHECK(copy.insert(Id("d"), start.plusSeconds(3)));
+    BOOST_CHECK_EQUAL(bids.size(), 3);
+
+    BidsInFlight assigned;
+    assigned.insert(Id("x"), start);
+    assigned = bids;
+    BOOST_CHECK(inFlight(assigned) == Ids({ "a", "b", "c" }));
+    BOOST_CHECK(!assigned.erase(Id("x")));
+    BOOST_CHECK(assigned.erase(Id("a")));
+    BOOST_CHECK(inFlight(bids) == Ids({ "a", "b", "c" }));
+    BOOST_CHECK_CLOSE(assigned.averageAge(start.plusSeconds(3)), 1.5, 0.01);
+}
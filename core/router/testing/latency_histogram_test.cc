@@ -0,0 +1,79 @@
+/* latency_histogram_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Test for the auction latency histograms.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/core/router/latency_histogram.h"
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace RTBKIT;
+
+BOOST_AUTO_TEST_CASE( test_latency_histogram_buckets )
+{
+    // Every bucket's limit maps back to that bucket and the next value
+    // starts the following one.
+    for (unsigned i = 0;  i < LatencyHistogram::NumBuckets - 1;  ++i) {
+        uint64_t limit = LatencyHistogram::bucketLimit(i);
+        BOOST_CHECK_EQUAL(LatencyHistogram::bucketOf(limit), i);
+        BOOST_CHECK_EQUAL(LatencyHistogram::bucketOf(limit + 1), i + 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_latency_histogram_quantiles )
+{
+    LatencyHistogram histogram;
+
+    // 1ms to 1000ms, one of each
+    for (unsigned i = 1;  i <= 1000;  ++i)
+        histogram.record(i / 1000.0);
+    histogram.record(-1.0);
+
+    auto snapshot = histogram.snapshot();
+    BOOST_CHECK_EQUAL(snapshot.count, 1000);
+    BOOST_CHECK_EQUAL(snapshot.max, 1000000);
+
+    auto checkQuantile = [&] (double q, double expectedMs)
+        {
+            double ms = snapshot.quantile(q) / 1000.0;
+            BOOST_CHECK_GE(ms, expectedMs);
+            BOOST_CHECK_LE(ms, expectedMs * 1.07);
+        };
+
+    checkQuantile(0.5, 500);
+    checkQuantile(0.99, 990);
+    checkQuantile(0.999, 999);
+}
+
+BOOST_AUTO_TEST_CASE( test_latency_histogram_threads )
+{
+    AuctionLatency latency;
+
+    int nThreads = 8, nRecords = 10000;
+
+    auto doThread = [&] (int thread)
+        {
+            string agent = thread % 2 ? "odd" : "even";
+            for (int i = 0;  i < nRecords;  ++i)
+                latency.recordAgent(agent, 0.001);
+        };
+
+    vector<std::thread> threads;
+    for (int i = 0;  i < nThreads;  ++i)
+        threads.emplace_back(doThread, i);
+    for (auto & t: threads)
+        t.join();
+
+    Json::Value json = latency.toJson();
+    BOOST_CHECK_EQUAL(json["agents"]["odd"]["count"].asInt(),
+                      nThreads / 2 * nRecords);
+    BOOST_CHECK_EQUAL(json["agents"]["even"]["count"].asInt(),
+                      nThreads / 2 * nRecords);
+    BOOST_CHECK_EQUAL(json["agents"]["odd"]["p50"].asDouble(), 1.0);
+}
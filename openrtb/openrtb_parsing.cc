@@ -21,18 +21,16 @@ DefaultDescription()
         {
             //cerr << "got unknown field " << context.printPath() << endl;
 
-            std::function<Json::Value & (int, Json::Value &)> getEntry
-            = [&] (int n, Json::Value & curr) -> Json::Value &
-            {
-                if (n == context.path.size())
-                    return curr;
-                else if (context.path[n].index != -1)
-                    return getEntry(n + 1, curr[context.path[n].index]);
-                else return getEntry(n + 1, curr[context.path[n].fieldName()]);
-            };
+            // Walk down to the entry without going through a recursive
+            // std::function, as this is run for every unknown field.
+            Json::Value * curr = &br->unparseable;
+            for (unsigned n = 0;  n < context.path.size();  ++n) {
+                if (context.path[n].index != -1)
+                    curr = &(*curr)[context.path[n].index];
+                else curr = &(*curr)[context.path[n].fieldName()];
+            }
 
-            getEntry(0, br->unparseable)
-                = context.expectJson();
+            *curr = context.expectJson();
         };
 
     addField("id", &BidRequest::id, "Bid Request ID");
@@ -8,7 +8,7 @@
 
 #include <iterator> // std::back_inserter
 #include <algorithm>// std::copy_if
-#include <boost/range/irange.hpp>
+#include <atomic>
 #include "redis_augmentor.h"
 #include "jml/utils/exc_assert.h"
 using namespace std;
@@ -16,6 +16,258 @@ using namespace std;
 namespace RTBKIT {
 
 
+/*****************************************************************************/
+/* REDIS NEAR CACHE                                                          */
+/*****************************************************************************/
+
+void
+RedisNearCache::
+configure(size_t maxEntries, double ttl)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    this->maxEntries = maxEntries;
+    this->ttl = ttl;
+    while (lru.size() > maxEntries) {
+        entries.erase(lru.back().key);
+        lru.pop_back();
+    }
+}
+
+RedisNearCache::Status
+RedisNearCache::
+lookup(const std::string & key, const OnValue & onValue, Date now)
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        if (it->second->expiry > now) {
+            lru.splice(lru.begin(), lru, it->second);
+            std::string value = it->second->value;
+            guard.unlock();
+            onValue(true, value);
+            return HIT;
+        }
+        lru.erase(it->second);
+        entries.erase(it);
+    }
+
+    auto res = inFlight.insert(make_pair(key, Fetch()));
+    Fetch & fetch = res.first->second;
+    if (!res.second && fetch.deadline < now) {
+        // The fetch was lost; fail its waiters and start a new one
+        std::vector<OnValue> waiting;
+        waiting.swap(fetch.waiting);
+        fetch.deadline = now.plusSeconds(fetchTimeout);
+        fetch.waiting.push_back(onValue);
+        guard.unlock();
+        for (auto & onLost: waiting)
+            onLost(false, string());
+        return MISS;
+    }
+
+    if (res.second)
+        fetch.deadline = now.plusSeconds(fetchTimeout);
+    fetch.waiting.push_back(onValue);
+    return res.second ? MISS : COALESCED;
+}
+
+void
+RedisNearCache::
+complete(const std::string & key, bool ok, const std::string & value, Date now)
+{
+    std::vector<OnValue> waiting;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto it = inFlight.find(key);
+        if (it != inFlight.end()) {
+            waiting.swap(it->second.waiting);
+            inFlight.erase(it);
+        }
+
+        if (ok && maxEntries > 0 && ttl > 0.0) {
+            auto jt = entries.find(key);
+            if (jt != entries.end()) {
+                jt->second->value = value;
+                jt->second->expiry = now.plusSeconds(ttl);
+                lru.splice(lru.begin(), lru, jt->second);
+            }
+            else {
+                lru.push_front(Entry{ key, value, now.plusSeconds(ttl) });
+                entries[key] = lru.begin();
+                if (lru.size() > maxEntries) {
+                    entries.erase(lru.back().key);
+                    lru.pop_back();
+                }
+            }
+        }
+    }
+
+    for (auto & onValue: waiting)
+        onValue(ok, ok ? value : string());
+}
+
+size_t
+RedisNearCache::
+expireInFlight(Date now)
+{
+    std::vector<OnValue> waiting;
+    size_t numExpired = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto it = inFlight.begin();  it != inFlight.end();) {
+            if (it->second.deadline < now) {
+                for (auto & onValue: it->second.waiting)
+                    waiting.emplace_back(std::move(onValue));
+                it = inFlight.erase(it);
+                ++numExpired;
+            }
+            else ++it;
+        }
+    }
+
+    for (auto & onValue: waiting)
+        onValue(false, string());
+    return numExpired;
+}
+
+size_t
+RedisNearCache::
+size() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return lru.size();
+}
+
+
+/*****************************************************************************/
+/* REDIS AUGMENTOR                                                           */
+/*****************************************************************************/
+
+namespace {
+
+/** Stores the given string if it renders verbatim once JSON quoted; anything
+    that would be escaped is left to the JSON path so that keys stay identical
+    to the ones built from the rendered bid request.
+*/
+bool extractPlain(const std::string & str, std::string & out)
+{
+    if (str.empty()) return false;
+    for (char c: str) {
+        if (c < 0x20 || c > 0x7e || c == '\\' || c == '"')
+            return false;
+    }
+    out = str;
+    return true;
+}
+
+bool extractId(const BidRequest & br, std::string & out)
+{
+    return extractPlain(br.auctionId.toString(), out);
+}
+
+bool extractUrl(const BidRequest & br, std::string & out)
+{
+    return !br.url.empty() && extractPlain(br.url.toString(), out);
+}
+
+bool extractIpAddress(const BidRequest & br, std::string & out)
+{
+    return extractPlain(br.ipAddress, out);
+}
+
+bool extractExchange(const BidRequest & br, std::string & out)
+{
+    return extractPlain(br.exchange, out);
+}
+
+bool extractProvider(const BidRequest & br, std::string & out)
+{
+    return extractPlain(br.provider, out);
+}
+
+bool extractProtocolVersion(const BidRequest & br, std::string & out)
+{
+    return extractPlain(br.protocolVersion, out);
+}
+
+bool extractCountryCode(const BidRequest & br, std::string & out)
+{
+    return extractPlain(br.location.countryCode, out);
+}
+
+bool extractRegionCode(const BidRequest & br, std::string & out)
+{
+    return extractPlain(br.location.regionCode, out);
+}
+
+bool extractPostalCode(const BidRequest & br, std::string & out)
+{
+    return extractPlain(br.location.postalCode, out);
+}
+
+RedisAugmentor::FieldExtractor
+getFieldExtractor(const std::string & path)
+{
+    static const std::unordered_map<std::string, RedisAugmentor::FieldExtractor>
+        extractors = {
+            { ".id", &extractId },
+            { ".url", &extractUrl },
+            { ".ipAddress", &extractIpAddress },
+            { ".exchange", &extractExchange },
+            { ".provider", &extractProvider },
+            { ".protocolVersion", &extractProtocolVersion },
+            { ".location.countryCode", &extractCountryCode },
+            { ".location.regionCode", &extractRegionCode },
+            { ".location.postalCode", &extractPostalCode },
+        };
+
+    auto it = extractors.find(path);
+    return it == extractors.end() ? nullptr : it->second;
+}
+
+/** Outstanding Redis keys of a single augmentation request. */
+struct PendingRequest {
+    std::vector<std::pair<string, set<AccountKey> > > jobs;
+    std::vector<string> values;
+    std::atomic<size_t> remaining;
+    std::atomic<bool> failed;
+    AsyncAugmentor::SendResponseCB sendResponse;
+    ML::Timer tm;
+};
+
+} // file scope
+
+std::shared_ptr<const RedisAugmentor::CompiledAgentConfig>
+RedisAugmentor::
+compile(const std::shared_ptr<const AgentConfig> & config)
+{
+    auto result = std::make_shared<CompiledAgentConfig>();
+    result->config = config;
+
+    for (const auto & aug: config->augmentations) {
+        if (aug.name != "redis") continue;
+
+        const auto & aug_l = aug.config.atStr("aug-list");
+        if (!aug_l || aug_l.type() != Json::arrayValue)
+            break;
+
+        for (unsigned i = 0;  i < aug_l.size();  ++i) {
+            KeyExtractor ke;
+            ke.key = aug_l.atIndex(i).asString();
+            if (ke.key.empty()) continue;
+            // prefix root path (.) if absent.
+            ke.path = ke.key[0] == '.' ? ke.key : "." + ke.key;
+            ke.extract = getFieldExtractor(ke.path);
+            result->keys.push_back(ke);
+        }
+        break;
+    }
+
+    return result;
+}
+
 RedisAugmentor::
 ~RedisAugmentor()
 {
@@ -33,8 +285,55 @@ init(int nthreads)
 {
     AsyncAugmentor::init(nthreads);
     /* Manages all the communications with the AgentConfigurationService. */
+    agent_config_.onConfigChange = [=] (std::string agent,
+                                        std::shared_ptr<const AgentConfig> config)
+        {
+            this->onConfigChange(agent, config);
+        };
     agent_config_.init(getServices()->config);
     addSource("RedisAugmentor::agentConfig", agent_config_);
+
+    // Fetches whose callback never comes would otherwise hold back every
+    // later request for their keys.
+    addPeriodic("RedisAugmentor::expireInFlight", 0.1,
+                [=] (uint64_t) {
+                    size_t numExpired = near_cache_.expireInFlight();
+                    if (numExpired)
+                        recordCount(numExpired, "nearCache.expired");
+                });
+}
+
+void
+RedisAugmentor::
+onConfigChange(const std::string & agent,
+               const std::shared_ptr<const AgentConfig> & config)
+{
+    auto compiled = config ? compile(config) : nullptr;
+
+    std::lock_guard<std::mutex> guard(compiled_lock_);
+    if (compiled) compiled_[agent] = compiled;
+    else compiled_.erase(agent);
+}
+
+std::shared_ptr<const RedisAugmentor::CompiledAgentConfig>
+RedisAugmentor::
+getCompiled(const AgentConfigEntry & entry)
+{
+    {
+        std::lock_guard<std::mutex> guard(compiled_lock_);
+        auto it = compiled_.find(entry.name);
+        if (it != compiled_.end() && it->second->config == entry.config)
+            return it->second;
+    }
+
+    /* The listener's callback hasn't run yet for this version of the config
+       so compile it ourselves; the callback will overwrite it with an
+       identical copy. */
+    auto compiled = compile(entry.config);
+
+    std::lock_guard<std::mutex> guard(compiled_lock_);
+    compiled_[entry.name] = compiled;
+    return compiled;
 }
 
 
@@ -42,16 +341,17 @@ void
 RedisAugmentor::
 onRequest(const AugmentationRequest & request, SendResponseCB sendResponse)
 {
-    ML::Timer tm;
-
     recordHit("requests");
 
     // we build an *ordered* map indexed by Redis keys, pointing
-    // at set of account keys. It will be captured by copy by the
-    // Redis lambda call back, and used in order to build the
-    // augmentation list.
+    // at set of account keys. It will be used in order to build the
+    // augmentation list once all the keys have been resolved.
     map<string,set<RTBKIT::AccountKey>> jobs;
-    auto br = request.bidRequest->toJson();
+
+    // Only rendered if one of the keys can't be extracted directly.
+    Json::Value br;
+    bool brRendered = false;
+
     for (const string& agent : request.agents)
     {
         RTBKIT::AgentConfigEntry c  = agent_config_.getAgentEntry(agent);
@@ -65,30 +365,31 @@ onRequest(const AugmentationRequest & request, SendResponseCB sendResponse)
             continue;
         }
 
-        // FIXME avoid converting the thing in Json::Value
-        const auto& aug_c = c.config->toJson(false);
-        const auto& aug_l = aug_c.atStr("augmentations").atStr("redis").atStr("config").atStr("aug-list");
-        if (!aug_l || aug_l.type() != Json::arrayValue || !aug_l.size())
+        auto compiled = getCompiled(c);
+        if (compiled->keys.empty())
         {
             recordHit ("noRedisAugAgentConfig");
             continue ;
         }
-        int n = aug_l.size();
+
         static const string prefix = "RTBkit:aug" ;
-        for (auto i: boost::irange (0,n))
+        for (const auto & ke: compiled->keys)
         {
-            auto key = aug_l.atIndex(i).asString();
-            if (key.empty()) continue;
-            // prefix root path (.) if absent.
-            auto root_key = key[0] == '.' ? key : "."+key;
-            Json::Value v = Json::Path(root_key).make(br);
-            if (!v) continue;
-            auto v_str = v.toString();
-            string vv_str ;
-            copy_if(v_str.begin(), v_str.end(),  back_inserter(vv_str), [](const char& c) {
-                return c!='\n'&&c!='"';
-            });
-            jobs[prefix+":"+key+":"+vv_str].insert (c.config->account);
+            string vv_str;
+            if (!ke.extract || !ke.extract(*request.bidRequest, vv_str))
+            {
+                if (!brRendered) {
+                    br = request.bidRequest->toJson();
+                    brRendered = true;
+                }
+                Json::Value v = Json::Path(ke.path).make(br);
+                if (!v) continue;
+                auto v_str = v.toString();
+                copy_if(v_str.begin(), v_str.end(),  back_inserter(vv_str), [](const char& c) {
+                    return c!='\n'&&c!='"';
+                });
+            }
+            jobs[prefix+":"+ke.key+":"+vv_str].insert (c.config->account);
         }
     }
 
@@ -99,37 +400,89 @@ onRequest(const AugmentationRequest & request, SendResponseCB sendResponse)
         return;
     }
 
-    auto doResponse = [=](const Redis::Results& results) {
-        ExcAssertEqual (results.size(), jobs.size());
+    auto pending = std::make_shared<PendingRequest>();
+    pending->jobs.assign(jobs.begin(), jobs.end());
+    pending->values.resize(jobs.size());
+    pending->remaining = jobs.size();
+    pending->failed = false;
+    pending->sendResponse = sendResponse;
+
+    auto doResponse = [=] ()
+    {
         AugmentationList auglret;
-        if (results)
+        if (!pending->failed)
         {
-            auto i=0;
-            for (const auto& ii: jobs)
+            for (size_t i = 0; i < pending->jobs.size(); ++i)
             {
-                const auto& res = results.at(i).reply().asString();
+                const auto& res = pending->values[i];
                 if (!res.empty())
-                    for (const auto& jj: ii.second)
-                        auglret[jj].data.atStr(ii.first) = res;
-                ++i;
+                    for (const auto& jj: pending->jobs[i].second)
+                        auglret[jj].data.atStr(pending->jobs[i].first) = res;
             }
         }
+        recordOutcome(pending->tm.elapsed_wall() * 1000.0, "redisResponseMs");
+        pending->sendResponse(auglret);
+    };
+
+    // build a vector of commands for the keys that are neither cached nor
+    // already being fetched by another request.
+    vector<string> keys;
+    vector<Redis::Command> cmds;
+    for (size_t i = 0; i < pending->jobs.size(); ++i)
+    {
+        const string & key = pending->jobs[i].first;
+        auto onValue = [=] (bool ok, const string & value)
+            {
+                if (ok) pending->values[i] = value;
+                else pending->failed = true;
+                if (--pending->remaining == 0)
+                    doResponse();
+            };
+
+        switch (near_cache_.lookup(key, onValue)) {
+        case RedisNearCache::HIT:
+            recordHit("nearCache.hit");
+            break;
+        case RedisNearCache::COALESCED:
+            recordHit("nearCache.coalesced");
+            break;
+        case RedisNearCache::MISS:
+            recordHit("nearCache.miss");
+            keys.push_back(key);
+            cmds.emplace_back (Redis::GET(key));
+            break;
+        }
+    }
+
+    if (cmds.empty()) return;
+
+    auto onResults = [=] (const Redis::Results& results) {
+        if (results)
+        {
+            ExcAssertEqual (results.size(), keys.size());
+            for (size_t i = 0; i < keys.size(); ++i)
+                near_cache_.complete(keys[i], true,
+                                     results.at(i).reply().asString());
+        }
         else
         {
-            cerr << "RedisAugmentor::onRequest::lambda(doResponse) error: " << results.error() << endl ;
+            cerr << "RedisAugmentor::onRequest::lambda(onResults) error: " << results.error() << endl ;
             recordHit("redisError."+results.error());
+            for (const auto& key: keys)
+                near_cache_.complete(key, false, string());
         }
-        recordOutcome(tm.elapsed_wall() * 1000.0, "redisResponseMs");
-        sendResponse(auglret);
     };
 
-    // build a vector of commands
-    vector<Redis::Command> cmds;
-    for (auto& ii: jobs)
-        cmds.emplace_back (Redis::GET(ii.first));
-
-    // and post it
-    redis_->queueMulti(cmds, doResponse, 0.004);
-
+    // and post it.  If that fails, nothing will complete the keys we
+    // registered, so fail them here rather than leave them in flight.
+    try {
+        redis_->queueMulti(cmds, onResults, 0.004);
+    } catch (const std::exception & exc) {
+        cerr << "RedisAugmentor::onRequest queueMulti error: " << exc.what()
+             << endl;
+        recordHit("redisQueueError");
+        for (const auto& key: keys)
+            near_cache_.complete(key, false, string());
+    }
 }
 } /* namespace RTBKIT */
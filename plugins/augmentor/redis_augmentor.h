@@ -9,12 +9,91 @@
 #define REDIS_AUGMENTOR_H_
 
 #include <string>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 #include "augmentor_base.h"
 #include "soa/service/redis.h"
 #include "rtbkit/core/agent_configuration/agent_configuration_listener.h"
 
 namespace RTBKIT {
 
+/**
+ *     Redis Near Cache.
+ *
+ *  Bounded LRU cache with a TTL which sits in front of Redis.  It also
+ *  coalesces concurrent lookups of the same key: only the first caller
+ *  issues the GET, the others are called back when it completes.
+ *  Thread safe; callbacks are never invoked while the internal lock is held.
+ */
+struct RedisNearCache {
+
+    /** Called with (ok, value) once the value of a key is known.  ok is false
+        when the Redis fetch failed, in which case value is empty.
+    */
+    typedef std::function<void (bool, const std::string &)> OnValue;
+
+    enum Status {
+        HIT,        ///< value was cached; callback was called synchronously
+        COALESCED,  ///< a fetch is in flight; callback will be called later
+        MISS        ///< caller must fetch the key and call complete()
+    };
+
+    /** A maxEntries or ttl of zero disables caching of values; concurrent
+        lookups are still coalesced.  A fetch that hasn't completed after
+        fetchTimeout seconds is failed, so that its key can be fetched again.
+    */
+    RedisNearCache(size_t maxEntries = 0, double ttl = 0.0,
+                   double fetchTimeout = 1.0)
+        : maxEntries(maxEntries), ttl(ttl), fetchTimeout(fetchTimeout)
+    {
+    }
+
+    void configure(size_t maxEntries, double ttl);
+
+    /** Look up the given key.  The callback is always eventually called,
+        synchronously on a HIT and from complete() otherwise.
+    */
+    Status lookup(const std::string & key, const OnValue & onValue,
+                  Date now = Date::now());
+
+    /** Record the result of a fetch started after a MISS and call back every
+        lookup waiting on the key.  Failed fetches are not cached.
+    */
+    void complete(const std::string & key, bool ok, const std::string & value,
+                  Date now = Date::now());
+
+    /** Fail every fetch that is past its deadline.  Returns the number of
+        keys released.
+    */
+    size_t expireInFlight(Date now = Date::now());
+
+    size_t size() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::string value;
+        Date expiry;
+    };
+    typedef std::list<Entry> Lru;
+
+    struct Fetch {
+        Date deadline;
+        std::vector<OnValue> waiting;
+    };
+
+    size_t maxEntries;
+    double ttl;
+    double fetchTimeout;
+
+    mutable std::mutex lock;
+    Lru lru;                    ///< Most recently used at the front
+    std::unordered_map<std::string, Lru::iterator> entries;
+    std::unordered_map<std::string, Fetch> inFlight;
+};
+
+
 /**
  *     Redis Augmentor.
  */
@@ -62,10 +141,51 @@ public:
 
     void init(int nthreads);
     virtual ~RedisAugmentor() ;
+
+    /** Enables the near cache in front of Redis.  Must be called before
+        init().  Disabled by default, in which case only concurrent lookups
+        of identical keys are coalesced.
+    */
+    void setNearCache(size_t maxEntries, double ttl)
+    {
+        near_cache_.configure(maxEntries, ttl);
+    }
+
+    /** Extracts the value of one aug-list entry from a bid request.  Returns
+        false if the field is absent or needs the generic JSON path lookup.
+    */
+    typedef bool (*FieldExtractor)(const BidRequest &, std::string &);
+
+    /** One aug-list entry of an agent, compiled when its config is seen. */
+    struct KeyExtractor {
+        std::string key;            ///< aug-list entry as configured
+        std::string path;           ///< rooted path used for the JSON lookup
+        FieldExtractor extract;     ///< direct accessor, or null
+    };
+
+    /** The redis augmentation config of an agent compiled for onRequest. */
+    struct CompiledAgentConfig {
+        std::shared_ptr<const AgentConfig> config;
+        std::vector<KeyExtractor> keys;
+    };
+
+    static std::shared_ptr<const CompiledAgentConfig>
+    compile(const std::shared_ptr<const AgentConfig> & config);
+
 private:
     void onRequest(const AugmentationRequest & request, SendResponseCB sendResponse);
+    void onConfigChange(const std::string & agent,
+                        const std::shared_ptr<const AgentConfig> & config);
+    std::shared_ptr<const CompiledAgentConfig>
+    getCompiled(const AgentConfigEntry & entry);
+
     RTBKIT::AgentConfigurationListener agent_config_;
     std::shared_ptr<Redis::AsyncConnection> redis_ ;
+    RedisNearCache near_cache_;
+
+    std::mutex compiled_lock_;
+    std::unordered_map<std::string, std::shared_ptr<const CompiledAgentConfig> >
+        compiled_;
 };
 
 } /* namespace RTBKIT */
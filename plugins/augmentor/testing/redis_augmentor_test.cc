@@ -193,6 +193,7 @@ BOOST_AUTO_TEST_CASE( redisAugmentorTest )
     cerr << "init aug\n";
 
     RedisAugmentor aug("redis-augmentation", "redis-augmentation", proxies, redis);
+    aug.setNearCache(1024, 10.0);
     aug.init(RedisThreads);
     aug.start();
 
@@ -230,3 +231,81 @@ BOOST_AUTO_TEST_CASE( redisAugmentorTest )
 
     proxies->events->dump(cerr);
 }
+
+BOOST_AUTO_TEST_CASE( redisNearCacheTest )
+{
+    RedisNearCache cache(2, 1.0);
+    Date now = Date::now();
+
+    vector<string> values;
+    auto onValue = [&] (bool ok, const string & value) {
+        BOOST_CHECK(ok);
+        values.push_back(value);
+    };
+
+    // Concurrent lookups of the same key are coalesced behind one fetch.
+    BOOST_CHECK_EQUAL(cache.lookup("a", onValue, now), RedisNearCache::MISS);
+    BOOST_CHECK_EQUAL(cache.lookup("a", onValue, now), RedisNearCache::COALESCED);
+    BOOST_CHECK(values.empty());
+    cache.complete("a", true, "1", now);
+    BOOST_CHECK_EQUAL(values.size(), 2);
+    BOOST_CHECK_EQUAL(values[0], "1");
+    BOOST_CHECK_EQUAL(values[1], "1");
+
+    // Subsequent lookups are served from the cache until they expire.
+    BOOST_CHECK_EQUAL(cache.lookup("a", onValue, now), RedisNearCache::HIT);
+    BOOST_CHECK_EQUAL(values.size(), 3);
+    BOOST_CHECK_EQUAL(cache.lookup("a", onValue, now.plusSeconds(2.0)),
+                      RedisNearCache::MISS);
+    cache.complete("a", true, "2", now);
+
+    // Least recently used keys are evicted once the cache is full.
+    BOOST_CHECK_EQUAL(cache.lookup("b", onValue, now), RedisNearCache::MISS);
+    cache.complete("b", true, "", now);
+    BOOST_CHECK_EQUAL(cache.lookup("c", onValue, now), RedisNearCache::MISS);
+    cache.complete("c", true, "3", now);
+    BOOST_CHECK_EQUAL(cache.size(), 2);
+    BOOST_CHECK_EQUAL(cache.lookup("a", onValue, now), RedisNearCache::MISS);
+
+    // Failed fetches are reported to every waiter and never cached.
+    int failures = 0;
+    auto onFailure = [&] (bool ok, const string & value) {
+        BOOST_CHECK(!ok);
+        ++failures;
+    };
+    BOOST_CHECK_EQUAL(cache.lookup("d", onFailure, now), RedisNearCache::MISS);
+    BOOST_CHECK_EQUAL(cache.lookup("d", onFailure, now), RedisNearCache::COALESCED);
+    cache.complete("d", false, "", now);
+    BOOST_CHECK_EQUAL(failures, 2);
+    BOOST_CHECK_EQUAL(cache.lookup("d", onFailure, now), RedisNearCache::MISS);
+}
+
+BOOST_AUTO_TEST_CASE( redisNearCacheFetchTimeoutTest )
+{
+    RedisNearCache cache(2, 1.0, 0.5);
+    Date now = Date::now();
+
+    int failures = 0;
+    auto onFailure = [&] (bool ok, const string & value) {
+        BOOST_CHECK(!ok);
+        ++failures;
+    };
+
+    // A lost fetch is failed by the next lookup past its deadline, which
+    // starts a new fetch for the key.
+    BOOST_CHECK_EQUAL(cache.lookup("a", onFailure, now), RedisNearCache::MISS);
+    BOOST_CHECK_EQUAL(cache.lookup("a", onFailure, now.plusSeconds(0.4)),
+                      RedisNearCache::COALESCED);
+    BOOST_CHECK_EQUAL(cache.lookup("a", onFailure, now.plusSeconds(0.6)),
+                      RedisNearCache::MISS);
+    BOOST_CHECK_EQUAL(failures, 2);
+
+    // Keys nobody asks for again are released by expireInFlight().
+    BOOST_CHECK_EQUAL(cache.lookup("b", onFailure, now), RedisNearCache::MISS);
+    BOOST_CHECK_EQUAL(cache.expireInFlight(now.plusSeconds(0.4)), 0);
+    BOOST_CHECK_EQUAL(cache.expireInFlight(now.plusSeconds(0.6)), 1);
+    BOOST_CHECK_EQUAL(failures, 3);
+    BOOST_CHECK_EQUAL(cache.expireInFlight(now.plusSeconds(1.2)), 1);
+    BOOST_CHECK_EQUAL(failures, 4);
+    BOOST_CHECK_EQUAL(cache.lookup("b", onFailure, now), RedisNearCache::MISS);
+}
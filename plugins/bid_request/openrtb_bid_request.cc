@@ -42,6 +42,7 @@ fromOpenRtb(OpenRTB::BidRequest && req,
 
             // Copy the ad formats in for the moment
             if (spot.banner) {
+                spot.formats.reserve(spot.banner->w.size());
                 for (unsigned i = 0;  i < spot.banner->w.size();  ++i) {
                     spot.formats.push_back(Format(spot.banner->w[i],
                                                  spot.banner->h[i]));
@@ -173,6 +174,7 @@ fromOpenRtb(OpenRTB::BidRequest && req,
             else key = d.name;
 
             vector<string> values;
+            values.reserve(d.segment.size());
             for (auto & v: d.segment) {
                 if (v.id)
                     values.push_back(v.id.toString());
@@ -0,0 +1,140 @@
+/* bid_request_parsing_bench.cc
+   Copyright (c) 2013 Datacratic Inc.  All rights reserved.
+
+   Measures the throughput and the number of allocations per request of the
+   JSON bid request parsers used by the exchange connectors over the bundled
+   sample requests, both on a single core and on every core at once.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/bid_request/openrtb_bid_request.h"
+#include "rtbkit/plugins/bid_request/appnexus_bid_request.h"
+#include "rtbkit/plugins/bid_request/fbx_bid_request.h"
+#include "jml/utils/filter_streams.h"
+#include "jml/arch/timers.h"
+#include "rtbkit/common/testing/allocation_counter.h"
+
+#include <functional>
+#include <thread>
+
+using namespace std;
+using namespace ML;
+using namespace RTBKIT;
+
+typedef std::function<void (ML::Parse_Context &)> Parser;
+
+void parseOpenRtb(ML::Parse_Context & context)
+{
+    std::unique_ptr<BidRequest> br(
+            OpenRtbBidRequestParser::parseBidRequest(
+                    context, "openrtb", "openrtb"));
+}
+
+void parseAppNexus(ML::Parse_Context & context)
+{
+    AppNexusBidRequestParser::parseBidRequest(context, "appnexus", "appnexus");
+}
+
+void parseFbx(ML::Parse_Context & context)
+{
+    std::unique_ptr<BidRequest> br(
+            FbxBidRequestParser::parseBidRequest(context, "fbx", "fbx"));
+}
+
+vector<pair<string, Parser> > samples = {
+    { "rtbkit/plugins/bid_request/testing/openrtb1_req.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/openrtb2_req.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/openrtb_wseat_req.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/openrtb_banner.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/openrtb_expandable_creative.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/openrtb_mobile.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/openrtb_video.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/rubicon_banner1.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/rubicon_banner2.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/rubicon_banner3.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/rubicon_banner4.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/rubicon_desktop.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/rubicon_mobile_app.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/rubicon_mobile_web.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/rubicon_test1.json", parseOpenRtb },
+    { "rtbkit/plugins/bid_request/testing/appnexus_parent_bid_request.json", parseAppNexus },
+    { "rtbkit/plugins/bid_request/testing/fbx1_req.json", parseFbx }
+};
+
+std::string loadFile(const std::string & filename)
+{
+    ML::filter_istream stream(filename);
+
+    string result;
+
+    while (stream) {
+        string line;
+        getline(stream, line);
+        result += line + "\n";
+    }
+
+    return result;
+}
+
+/** Parses the payload the given number of times; returns the number of
+    allocations that were made.
+*/
+uint64_t parseMany(const string & payload, const Parser & parser,
+                   unsigned iterations)
+{
+    uint64_t allocs = 0;
+    for (unsigned i = 0;  i < iterations;  ++i) {
+        uint64_t before = numAllocations();
+        ML::Parse_Context context("Bid Request",
+                                  payload.c_str(), payload.size());
+        parser(context);
+        allocs += numAllocations() - before;
+    }
+    return allocs;
+}
+
+BOOST_AUTO_TEST_CASE( bench_bid_request_parsing )
+{
+    enum { Iterations = 10000 };
+
+    unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    cerr << ML::format("%-36s %10s %10s %10s %12s %10s",
+                       "sample", "us/req", "MB/s", "allocs/req",
+                       "req/s/core", "cores")
+         << endl;
+
+    for (auto & sample: samples) {
+        const string & filename = sample.first;
+        string payload = loadFile(filename);
+
+        ML::Timer timer;
+        // Allocations are counted on this thread only; the counter is per
+        // thread so it doesn't slow down the multi-threaded run below.
+        uint64_t allocs = parseMany(payload, sample.second, Iterations);
+        double elapsed = timer.elapsed_wall();
+
+        vector<std::thread> threads;
+        ML::Timer mtTimer;
+        for (unsigned i = 0;  i < numThreads;  ++i) {
+            threads.emplace_back([&] () {
+                    parseMany(payload, sample.second, Iterations);
+                });
+        }
+        for (auto & th: threads)
+            th.join();
+        double mtElapsed = mtTimer.elapsed_wall();
+
+        cerr << ML::format("%-36s %10.2f %10.1f %10.1f %12.0f %10d",
+                           filename.substr(filename.rfind('/') + 1).c_str(),
+                           elapsed * 1000000.0 / Iterations,
+                           payload.size() * Iterations / elapsed / 1000000.0,
+                           1.0 * allocs / Iterations,
+                           Iterations / mtElapsed,
+                           numThreads)
+             << endl;
+    }
+}
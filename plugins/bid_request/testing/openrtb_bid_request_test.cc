@@ -247,6 +247,37 @@ BOOST_AUTO_TEST_CASE( test_openrtb_round_trip )
         testBidRequestRoundTrip(samples[i], reqs[i]);
 }
 
+BOOST_AUTO_TEST_CASE( test_openrtb_unknown_fields )
+{
+    // Unknown top-level fields end up in unparseable and survive the
+    // conversion to a standard bid request.
+    string reqStr =
+        "{\"id\":\"1\",\"imp\":[{\"id\":\"1\",\"banner\":{\"w\":300,\"h\":250}}],"
+        "\"unknown1\":[1, {\"a\" : \"}\\\"]\"}],"
+        "\"unknown2\": { \"b\" : [ true, null, -1.5e3 ] },"
+        "\"tmax\":50}";
+
+    static DefaultDescription<OpenRTB::BidRequest> desc;
+    OpenRTB::BidRequest req;
+
+    {
+        StreamingJsonParsingContext context;
+        context.init("unknown fields", reqStr.c_str(), reqStr.size());
+        desc.parseJson(&req, context);
+    }
+
+    Json::Value expected = Json::parse(
+        "{\"unknown1\":[1,{\"a\":\"}\\\"]\"}],"
+        "\"unknown2\":{\"b\":[true,null,-1500]}}");
+    BOOST_CHECK_EQUAL(req.unparseable.toString(), expected.toString());
+    BOOST_CHECK_EQUAL(req.tmax.value(), 50);
+
+    std::unique_ptr<BidRequest> br(fromOpenRtb(std::move(req), "openrtb", "openrtb"));
+
+    BOOST_CHECK_EQUAL(br->unparseable.toString(), expected.toString());
+    BOOST_CHECK_EQUAL(br->imp.size(), 1);
+}
+
 BOOST_AUTO_TEST_CASE( benchmark_openrtb_round_trip )
 {
     vector<string> reqs;
@@ -0,0 +1,147 @@
+/* bid_request_table.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Concurrent table of the bid requests an agent hasn't answered yet.
+*/
+
+#include "bid_request_table.h"
+#include <sched.h>
+
+using namespace std;
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* BID REQUEST TABLE                                                         */
+/*****************************************************************************/
+
+BidRequestTable::
+BidRequestTable(size_t capacity) :
+    numOverflow(0)
+{
+    size_t size = MaxProbe;
+    while (size < capacity)
+        size *= 2;
+
+    mask = size - 1;
+    slots.reset(new Slot[size]);
+}
+
+uint64_t
+BidRequestTable::
+loadKey(const Slot & slot)
+{
+    for (;;) {
+        uint64_t key = slot.key.load(std::memory_order_acquire);
+        if (key != BUSY) return key;
+        sched_yield();
+    }
+}
+
+BidRequestTable::Slot *
+BidRequestTable::
+claim(const Id & id, uint64_t key)
+{
+    for (size_t i = 0;  i < MaxProbe;) {
+        Slot & slot = slots[(key + i) & mask];
+
+        uint64_t current = loadKey(slot);
+        if (current == EMPTY)
+            return nullptr;
+        if (current != key) {
+            ++i;
+            continue;
+        }
+
+        // Lost the race; look at the same slot again
+        if (!slot.key.compare_exchange_strong(current, BUSY,
+                                              std::memory_order_acquire))
+            continue;
+
+        if (slot.id == id)
+            return &slot;
+
+        // Same hash, different auction
+        slot.key.store(key, std::memory_order_release);
+        ++i;
+    }
+
+    return nullptr;
+}
+
+bool
+BidRequestTable::
+insert(const Id & id, Date timestamp, const std::string & fromRouter)
+{
+    uint64_t key = keyOf(id);
+
+    if (Slot * slot = claim(id, key)) {
+        slot->key.store(key, std::memory_order_release);
+        return false;
+    }
+
+    if (numOverflow.load(std::memory_order_acquire)) {
+        lock_guard<mutex> guard(overflowLock);
+        if (overflow.count(id)) return false;
+    }
+
+    for (size_t i = 0;  i < MaxProbe;  ++i) {
+        Slot & slot = slots[(key + i) & mask];
+
+        uint64_t current = slot.key.load(std::memory_order_relaxed);
+        if (current != EMPTY && current != DELETED)
+            continue;
+        if (!slot.key.compare_exchange_strong(current, BUSY,
+                                              std::memory_order_acquire))
+            continue;
+
+        slot.id = id;
+        slot.timestamp = timestamp;
+        slot.fromRouter = fromRouter;
+        slot.key.store(key, std::memory_order_release);
+        return true;
+    }
+
+    lock_guard<mutex> guard(overflowLock);
+
+    Entry & entry = overflow[id];
+    entry.timestamp = timestamp;
+    entry.fromRouter = fromRouter;
+    numOverflow.store(overflow.size(), std::memory_order_release);
+
+    return true;
+}
+
+bool
+BidRequestTable::
+take(const Id & id, Date & timestamp, std::string & fromRouter)
+{
+    uint64_t key = keyOf(id);
+
+    if (Slot * slot = claim(id, key)) {
+        timestamp = slot->timestamp;
+        fromRouter.swap(slot->fromRouter);
+        slot->fromRouter.clear();
+        slot->key.store(DELETED, std::memory_order_release);
+        return true;
+    }
+
+    if (!numOverflow.load(std::memory_order_acquire))
+        return false;
+
+    lock_guard<mutex> guard(overflowLock);
+
+    auto it = overflow.find(id);
+    if (it == overflow.end())
+        return false;
+
+    timestamp = it->second.timestamp;
+    fromRouter.swap(it->second.fromRouter);
+    overflow.erase(it);
+    numOverflow.store(overflow.size(), std::memory_order_release);
+
+    return true;
+}
+
+} // namespace RTBKIT
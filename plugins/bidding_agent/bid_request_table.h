@@ -0,0 +1,117 @@
+/* bid_request_table.h                                             -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Concurrent table of the bid requests an agent hasn't answered yet.
+*/
+
+#pragma once
+
+#include "soa/types/id.h"
+#include "soa/types/date.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <string>
+#include <cstdint>
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* BID REQUEST TABLE                                                         */
+/*****************************************************************************/
+
+/** Open addressing hash table keyed on the hash of the auction id.  Inserts
+    and removals claim a slot with a compare and swap on its key, so any
+    thread can use it without taking a lock.  The auction id is kept in the
+    slot so that two ids with the same hash are told apart.
+
+    Probing is bounded: when every slot within MaxProbe of the home slot is
+    taken the entry goes into an overflow map protected by a mutex instead.
+    With a table several times larger than the number of requests in flight
+    that map stays empty and is never locked.
+*/
+struct BidRequestTable {
+
+    enum { MaxProbe = 64 };
+
+    BidRequestTable(size_t capacity = 65536);
+
+    /** Add an entry for the given auction.  Returns false if there is
+        already an entry for that auction id.
+
+        Two concurrent inserts of the same id aren't detected as duplicates.
+    */
+    bool insert(const Id & id, Date timestamp, const std::string & fromRouter);
+
+    /** Remove the entry for the given auction, returning its contents.
+        Returns false if there was no such entry.
+    */
+    bool take(const Id & id, Date & timestamp, std::string & fromRouter);
+
+    /** Remove the entry for the given auction, if any. */
+    void erase(const Id & id)
+    {
+        Date timestamp;
+        std::string fromRouter;
+        take(id, timestamp, fromRouter);
+    }
+
+    /** Number of entries that didn't fit in the table and went into the
+        overflow map.
+    */
+    size_t overflowSize() const
+    {
+        return numOverflow.load(std::memory_order_relaxed);
+    }
+
+private:
+    enum : uint64_t {
+        EMPTY = 0,      ///< Never used; ends a probe sequence
+        DELETED = 1,    ///< Free, but probes must carry on past it
+        BUSY = 2,       ///< Claimed by a thread that's reading or writing it
+        FIRST_KEY = 3
+    };
+
+    struct Slot {
+        Slot() : key(EMPTY) {}
+
+        std::atomic<uint64_t> key;
+        Id id;
+        Date timestamp;
+        std::string fromRouter;
+    };
+
+    struct Entry {
+        Date timestamp;
+        std::string fromRouter;
+    };
+
+    static uint64_t keyOf(const Id & id)
+    {
+        uint64_t key = id.hash();
+        return key < FIRST_KEY ? key + FIRST_KEY : key;
+    }
+
+    /** Loads the key of the slot, waiting for any thread that has it BUSY
+        to be done with it.
+    */
+    static uint64_t loadKey(const Slot & slot);
+
+    /** Returns the slot holding the given id, claimed as BUSY, or null if
+        there is none.  Leaves it to the caller to store a key back.
+    */
+    Slot * claim(const Id & id, uint64_t key);
+
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+
+    std::mutex overflowLock;
+    std::map<Id, Entry> overflow;
+    std::atomic<size_t> numOverflow;
+};
+
+} // namespace RTBKIT
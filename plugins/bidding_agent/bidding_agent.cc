@@ -49,6 +49,19 @@ jsonParse(const std::string & str)
     return Json::parse(str);
 }
 
+/** FastWriter terminates its output with a newline; strip it instead of
+    trimming the whole string.
+*/
+static std::string
+jsonWrite(Json::FastWriter & writer, const Json::Value & val)
+{
+    if (val.isNull()) return "null";
+    std::string result = writer.write(val);
+    if (!result.empty() && result[result.size() - 1] == '\n')
+        result.resize(result.size() - 1);
+    return result;
+}
+
 /******************************************************************************/
 /* ROUTER PROXY                                                               */
 /******************************************************************************/
@@ -62,7 +75,11 @@ BiddingAgent(std::shared_ptr<ServiceProxies> proxies,
       toPostAuctionServices(getZmqContext()),
       toConfigurationAgent(getZmqContext()),
       toRouterChannel(65536),
-      requiresAllCB(true)
+      requiresAllCB(true),
+      binaryBids(false),
+      numWorkers(0),
+      nextWorker(0),
+      stopWorkers(false)
 {
 }
 
@@ -75,7 +92,11 @@ BiddingAgent(ServiceBase& parent,
       toPostAuctionServices(getZmqContext()),
       toConfigurationAgent(getZmqContext()),
       toRouterChannel(65536),
-      requiresAllCB(true)
+      requiresAllCB(true),
+      binaryBids(false),
+      numWorkers(0),
+      nextWorker(0),
+      stopWorkers(false)
 {
 }
 
@@ -146,6 +167,8 @@ init()
     addSource("BiddingAgent::toRouterChannel", toRouterChannel);
 
     MessageLoop::init();
+
+    startWorkers();
 }
 
 void
@@ -154,6 +177,8 @@ shutdown()
 {
     MessageLoop::shutdown();
 
+    stopWorkerThreads();
+
     toConfigurationAgent.shutdown();
     toRouters.shutdown();
     //toPostAuctionService.shutdown();
@@ -357,16 +382,105 @@ checkMessageSize(const std::vector<std::string>& msg, int expectedSize)
             msg.size(), expectedSize, msgStr.c_str());
 }
 
+void
+BiddingAgent::
+startWorkers()
+{
+    stopWorkers = false;
+    for (unsigned i = 0;  i < numWorkers;  ++i) {
+        workers.emplace_back(new Worker());
+        Worker * worker = workers.back().get();
+        worker->thread = std::thread([=] () { this->runWorker(*worker); });
+    }
+}
+
+void
+BiddingAgent::
+stopWorkerThreads()
+{
+    for (auto & worker: workers) {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        stopWorkers = true;
+        worker->cond.notify_one();
+    }
+    for (auto & worker: workers)
+        worker->thread.join();
+    workers.clear();
+}
+
+void
+BiddingAgent::
+runWorker(Worker & worker)
+{
+    std::pair<std::string, std::vector<std::string> > message;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(worker.lock);
+            while (worker.queue.empty() && !stopWorkers)
+                worker.cond.wait(guard);
+            if (stopWorkers) return;
+            message = std::move(worker.queue.front());
+            worker.queue.pop_front();
+        }
+
+        try {
+            processBidRequest(message.first, message.second, onBidRequest,
+                              true);
+        }
+        catch (const std::exception& ex) {
+            // Nothing will bid on the request, so don't leave it registered
+            requests.erase(Id(message.second[2]));
+            recordHit("error");
+            cerr << "Error handling auction message " << ex.what() << endl;
+        }
+    }
+}
+
 void
 BiddingAgent::
 handleBidRequest(const std::string & fromRouter,
                  const std::vector<std::string>& msg, BidRequestCbFn& callback)
 {
+    if (workers.empty()) {
+        processBidRequest(fromRouter, msg, callback, false);
+        return;
+    }
+
     ExcCheck(!requiresAllCB || callback, "Null callback for " + msg[0]);
     if (!callback) return;
 
     checkMessageSize(msg, 9);
 
+    // Register the request before queueing it.  Results such as DROPPEDBID
+    // are handled on this thread and have to find the entry even when the
+    // worker hasn't got to the request yet.
+    bool inserted = requests.insert(Id(msg[2]), Date::now(), fromRouter);
+    ExcCheck(inserted, "seen multiple requests with same ID");
+
+    // Round robin over the workers; each has its own queue so that the
+    // message loop only contends with one of them at a time.
+    Worker & worker = *workers[nextWorker++ % workers.size()];
+    {
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.queue.emplace_back(fromRouter, msg);
+    }
+    worker.cond.notify_one();
+}
+
+void
+BiddingAgent::
+processBidRequest(const std::string & fromRouter,
+                  const std::vector<std::string>& msg, BidRequestCbFn& callback,
+                  bool registered)
+{
+    if (!registered) {
+        ExcCheck(!requiresAllCB || callback, "Null callback for " + msg[0]);
+        if (!callback) return;
+
+        checkMessageSize(msg, 9);
+    }
+
     double timestamp = boost::lexical_cast<double>(msg[1]);
     Id id(msg[2]);
 
@@ -395,12 +509,9 @@ handleBidRequest(const std::string & fromRouter,
 
     recordHit("requests");
 
-    ExcCheck(!requests.count(id), "seen multiple requests with same ID");
-    {
-        lock_guard<mutex> guard (requestsLock);
-
-        requests[id].timestamp = Date::now();
-        requests[id].fromRouter = fromRouter;
+    if (!registered) {
+        bool inserted = requests.insert(id, Date::now(), fromRouter);
+        ExcCheck(inserted, "seen multiple requests with same ID");
     }
 
     callback(timestamp, id, br, bids, timeLeftMs, augmentations, wcm);
@@ -411,7 +522,15 @@ BiddingAgent::
 handleResult(const std::vector<std::string>& msg, ResultCbFn& callback)
 {
     ExcCheck(!requiresAllCB || callback, "Null callback for " + msg[0]);
-    if (!callback) return;
+
+    /** A dropped bid will never be answered so its entry has to go whether
+        or not anyone is listening for the result.
+     */
+    if (!callback) {
+        if (msg[0] == "DROPPEDBID" && msg.size() > 3)
+            requests.erase(Id(msg[3]));
+        return;
+    }
 
     checkMessageSize(msg, 6);
 
@@ -425,10 +544,8 @@ handleResult(const std::vector<std::string>& msg, ResultCbFn& callback)
 
     callback(result);
 
-    if (result.result == BS_DROPPEDBID) {
-        lock_guard<mutex> guard (requestsLock);
+    if (result.result == BS_DROPPEDBID)
         requests.erase(Id(msg[3]));
-    }
 }
 
 void
@@ -467,40 +584,26 @@ void
 BiddingAgent::
 doBid(Id id, const Bids & bids, const Json::Value & jsonMeta, const WinCostModel & wcm)
 {
-    Json::FastWriter jsonWriter;
-
-    string response = jsonWriter.write(bids.toJson());
-    boost::trim(response);
-
-    string meta = jsonWriter.write(jsonMeta);
-    boost::trim(meta);
-
-    string model = jsonWriter.write(wcm.toJson());
-    boost::trim(model);
-
     Date afterSend = Date::now();
     Date beforeSend;
     string fromRouter;
 
-    {
-        lock_guard<mutex> guard (requestsLock);
-
-        auto it = requests.find(id);
-
-        /** If the auction id isn't in the map then we previously received a
-            DROPBID message we should simply forget this bid.
-         */
-        if (it == requests.end()) {
-            cerr << "Ignoring bid (dropped auction id): " << id << endl;
-            return;
-        }
-
-        beforeSend = it->second.timestamp;
-        fromRouter = it->second.fromRouter;
-        requests.erase(it);
+    /** If the auction id isn't in the table then we previously received a
+        DROPBID message we should simply forget this bid.
+     */
+    if (!requests.take(id, beforeSend, fromRouter)) {
+        cerr << "Ignoring bid (dropped auction id): " << id << endl;
+        return;
     }
     if (fromRouter.empty()) return;
 
+    Json::FastWriter jsonWriter;
+    string response = binaryBids
+        ? bids.toBinary()
+        : jsonWrite(jsonWriter, bids.toJson());
+    string meta = jsonWrite(jsonWriter, jsonMeta);
+    string model = wcm.toJsonStr();
+
     recordLevel((afterSend - beforeSend) * 1000.0, "timeTakenMs");
 
     toRouterChannel.push(RouterMessage(
@@ -21,6 +21,7 @@
 #include "soa/service/service_base.h"
 #include "soa/service/zmq_endpoint.h"
 #include "soa/service/typed_message_channel.h"
+#include "rtbkit/plugins/bidding_agent/bid_request_table.h"
 
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
@@ -31,6 +32,10 @@
 #include <vector>
 #include <thread>
 #include <map>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 
 namespace RTBKIT {
@@ -70,9 +75,29 @@ struct BiddingAgent : public ServiceBase, public MessageLoop {
     */
     void strictMode(bool strict) { requiresAllCB = strict; }
 
+    /** Number of threads that parse bid requests and call onBidRequest.  With
+        the default of 0 they are handled on the message loop's thread.  When
+        set, onBidRequest is called concurrently from the workers and must be
+        thread-safe; doBid can be called from any thread.  This should be set
+        before calling init().
+    */
+    void setWorkerThreads(unsigned count) { numWorkers = count; }
+
+    /** Send bids to the router in the compact binary encoding of
+        Bids::toBinary() rather than as JSON, which saves the router from
+        parsing them.  Requires routers that understand it.
+    */
+    void setBinaryBids(bool binary) { binaryBids = binary; }
+
     void init();
     void shutdown();
 
+    /** Handle a message received from the given router.  Called from the
+        message loop; bid requests are handed on to the workers from here.
+    */
+    void handleRouterMessage(const std::string & fromRouter,
+                             const std::vector<std::string>& msg);
+
 
     /**************************************************************************/
     /* AGENT CONTROLS                                                         */
@@ -246,15 +271,27 @@ private:
     ZmqNamedClientBusProxy toConfigurationAgent;
     TypedMessageSink<RouterMessage> toRouterChannel;
 
-    struct RequestStatus {
-        Date timestamp;
-        std::string fromRouter;
+    BidRequestTable requests;
+
+    bool requiresAllCB;
+    bool binaryBids;
+
+    /** Pool of threads handling bid requests; see setWorkerThreads(). */
+    struct Worker {
+        std::mutex lock;
+        std::condition_variable cond;
+        std::deque<std::pair<std::string, std::vector<std::string> > > queue;
+        std::thread thread;
     };
 
-    std::map<Id, RequestStatus> requests;
-    std::mutex requestsLock; // Protects concurrent writes to requests
+    unsigned numWorkers;
+    unsigned nextWorker;
+    std::atomic<bool> stopWorkers;
+    std::vector<std::unique_ptr<Worker> > workers;
 
-    bool requiresAllCB;
+    void startWorkers();
+    void stopWorkerThreads();
+    void runWorker(Worker & worker);
 
 
     /** Ensures that we can set the config and send it atomically. Prevents a
@@ -271,11 +308,16 @@ private:
 
     // void doHeartbeat();
 
-    void handleRouterMessage(const std::string & fromRouter,
-                             const std::vector<std::string>& msg);
     void handleError(const std::vector<std::string>& msg, ErrorCbFn& callback);
     void handleBidRequest(const std::string & fromRouter,
             const std::vector<std::string>& msg, BidRequestCbFn& callback);
+    /** Parse a bid request and call the callback.  registered tells if the
+        request was already added to the table when it was queued for a
+        worker.
+    */
+    void processBidRequest(const std::string & fromRouter,
+            const std::vector<std::string>& msg, BidRequestCbFn& callback,
+            bool registered);
     void handleWin(
             const std::vector<std::string>& msg, ResultCbFn& callback);
     void handleResult(
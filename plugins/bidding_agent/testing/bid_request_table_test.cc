@@ -0,0 +1,154 @@
+/* bid_request_table_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the bidding agent's table of in-flight bid requests.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/plugins/bidding_agent/bid_request_table.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/lexical_cast.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+using namespace std;
+using namespace RTBKIT;
+
+namespace {
+
+Id auctionId(int i)
+{
+    return Id("auction-" + boost::lexical_cast<string>(i));
+}
+
+} // file scope
+
+
+BOOST_AUTO_TEST_CASE( test_insert_take_erase )
+{
+    BidRequestTable table;
+    Date now = Date::now();
+
+    BOOST_CHECK(table.insert(auctionId(1), now, "router1"));
+    BOOST_CHECK(table.insert(auctionId(2), now.plusSeconds(1), "router2"));
+
+    Date timestamp;
+    string fromRouter;
+
+    BOOST_CHECK(!table.take(auctionId(3), timestamp, fromRouter));
+
+    BOOST_CHECK(table.take(auctionId(2), timestamp, fromRouter));
+    BOOST_CHECK_EQUAL(fromRouter, "router2");
+    BOOST_CHECK_EQUAL(timestamp, now.plusSeconds(1));
+
+    // Only taken once
+    BOOST_CHECK(!table.take(auctionId(2), timestamp, fromRouter));
+
+    table.erase(auctionId(1));
+    BOOST_CHECK(!table.take(auctionId(1), timestamp, fromRouter));
+
+    // Slots are reused once freed
+    BOOST_CHECK(table.insert(auctionId(1), now, "router3"));
+    BOOST_CHECK(table.take(auctionId(1), timestamp, fromRouter));
+    BOOST_CHECK_EQUAL(fromRouter, "router3");
+}
+
+BOOST_AUTO_TEST_CASE( test_duplicate_ids )
+{
+    BidRequestTable table;
+    Date now = Date::now();
+
+    BOOST_CHECK(table.insert(auctionId(1), now, "router1"));
+    BOOST_CHECK(!table.insert(auctionId(1), now, "router2"));
+
+    Date timestamp;
+    string fromRouter;
+    BOOST_CHECK(table.take(auctionId(1), timestamp, fromRouter));
+    BOOST_CHECK_EQUAL(fromRouter, "router1");
+
+    BOOST_CHECK(table.insert(auctionId(1), now, "router2"));
+}
+
+BOOST_AUTO_TEST_CASE( test_full_table )
+{
+    // Smallest possible table, so that most of these have to overflow
+    BidRequestTable table(1);
+    Date now = Date::now();
+    enum { N = 1000 };
+
+    for (int i = 0;  i < N;  ++i)
+        BOOST_CHECK(table.insert(auctionId(i), now, "router" +
+                                 boost::lexical_cast<string>(i)));
+    BOOST_CHECK_EQUAL(table.overflowSize(), N - BidRequestTable::MaxProbe);
+
+    // Duplicates are found in the overflow too
+    BOOST_CHECK(!table.insert(auctionId(N - 1), now, "router"));
+
+    Date timestamp;
+    string fromRouter;
+    for (int i = 0;  i < N;  ++i) {
+        BOOST_CHECK(table.take(auctionId(i), timestamp, fromRouter));
+        BOOST_CHECK_EQUAL(fromRouter, "router" + boost::lexical_cast<string>(i));
+    }
+
+    BOOST_CHECK_EQUAL(table.overflowSize(), 0);
+    BOOST_CHECK(!table.take(auctionId(0), timestamp, fromRouter));
+}
+
+BOOST_AUTO_TEST_CASE( test_concurrent_insert_take )
+{
+    enum { NumThreads = 8, PerThread = 20000 };
+
+    // More requests in flight than slots, so the overflow map gets used
+    BidRequestTable table(1);
+    std::atomic<int> errors(0);
+
+    auto runThread = [&] (int thread)
+        {
+            Date timestamp;
+            string fromRouter;
+
+            for (int i = 0;  i < PerThread;  ++i) {
+                int n = thread * PerThread + i;
+                string router = boost::lexical_cast<string>(n);
+
+                if (!table.insert(auctionId(n), Date::now(), router))
+                    ++errors;
+
+                // Keep a few in flight before taking them back
+                if (i < 16) continue;
+
+                int m = n - 16;
+                if (!table.take(auctionId(m), timestamp, fromRouter)
+                    || fromRouter != boost::lexical_cast<string>(m))
+                    ++errors;
+            }
+
+            for (int i = PerThread - 16;  i < PerThread;  ++i) {
+                int n = thread * PerThread + i;
+                if (!table.take(auctionId(n), timestamp, fromRouter)
+                    || fromRouter != boost::lexical_cast<string>(n))
+                    ++errors;
+            }
+        };
+
+    vector<thread> threads;
+    for (int i = 0;  i < NumThreads;  ++i)
+        threads.emplace_back(runThread, i);
+    for (auto & th : threads)
+        th.join();
+
+    BOOST_CHECK_EQUAL(errors, 0);
+    BOOST_CHECK_EQUAL(table.overflowSize(), 0);
+
+    Date timestamp;
+    string fromRouter;
+    int left = 0;
+    for (int n = 0;  n < NumThreads * PerThread;  ++n)
+        left += table.take(auctionId(n), timestamp, fromRouter);
+    BOOST_CHECK_EQUAL(left, 0);
+}
@@ -0,0 +1,4 @@
+# bidding_agent_testing.mk
+
+$(eval $(call test,bid_request_table_test,bidding_agent,boost))
+$(eval $(call test,bidding_agent_worker_test,bidding_agent,boost))
@@ -0,0 +1,94 @@
+/* bidding_agent_worker_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the bidding agent's worker threads.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/plugins/bidding_agent/bidding_agent.h"
+
+#include <boost/test/unit_test.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+using namespace Datacratic;
+using namespace RTBKIT;
+
+namespace {
+
+vector<string> auctionMessage(const Id & id)
+{
+    BidRequest br;
+    br.auctionId = id;
+
+    return { "AUCTION", to_string(Date::now().secondsSinceEpoch()),
+             id.toString(), "datacratic", br.toJsonStr(),
+             "[{\"spot\":0,\"creatives\":[0]}]", "50", "{}", "null" };
+}
+
+vector<string> droppedBidMessage(const Id & id)
+{
+    return { "DROPPEDBID", to_string(Date::now().secondsSinceEpoch()),
+             "guaranteed", id.toString(), "0", "0USD/1M" };
+}
+
+} // file scope
+
+
+BOOST_AUTO_TEST_CASE( test_dropped_bid_before_worker )
+{
+    auto proxies = std::make_shared<ServiceProxies>();
+    BiddingAgent agent(proxies, "bidding_agent_worker_test");
+    agent.strictMode(false);
+    agent.setWorkerThreads(1);
+
+    std::mutex lock;
+    std::condition_variable cond;
+    bool release = false;
+    vector<Id> seen;
+
+    // Hold the worker until told to go, so that the requests stay queued
+    agent.onBidRequest = [&] (double timestamp, Id id,
+                              std::shared_ptr<BidRequest> br,
+                              const Bids & bids, double timeLeftMs,
+                              Json::Value augmentations,
+                              WinCostModel const & wcm)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while (!release)
+                cond.wait(guard);
+            seen.push_back(id);
+            cond.notify_all();
+        };
+
+    agent.init();
+
+    agent.handleRouterMessage("router", auctionMessage(Id(1)));
+    agent.handleRouterMessage("router", auctionMessage(Id(2)));
+
+    // Queued requests are already registered, so duplicates are caught
+    BOOST_CHECK_THROW(agent.handleRouterMessage("router", auctionMessage(Id(2))),
+                      std::exception);
+
+    // The bid is dropped before a worker got to the request.  Its entry must
+    // go, which lets the same auction id be registered again.
+    agent.handleRouterMessage("router", droppedBidMessage(Id(2)));
+    BOOST_CHECK_NO_THROW(agent.handleRouterMessage("router",
+                                                   auctionMessage(Id(2))));
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        release = true;
+        cond.notify_all();
+        while (seen.size() < 3)
+            cond.wait(guard);
+    }
+
+    BOOST_CHECK_EQUAL(seen[0], Id(1));
+    BOOST_CHECK_EQUAL(seen[1], Id(2));
+    BOOST_CHECK_EQUAL(seen[2], Id(2));
+}
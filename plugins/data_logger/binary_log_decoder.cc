@@ -0,0 +1,68 @@
+/* binary_log_decoder.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Renders binary log files written by the data logger in the text format,
+   one tab separated message per line.
+*/
+
+#include "binary_log_file.h"
+#include "rtbkit/common/log_record.h"
+
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/positional_options.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <iostream>
+#include <set>
+
+using namespace std;
+using namespace boost::program_options;
+using namespace RTBKIT;
+
+int main(int argc, char ** argv)
+{
+    vector<string> files;
+    vector<string> channels;
+
+    options_description all_opt;
+    all_opt.add_options()
+        ("file,f", value<vector<string> >(&files),
+         "binary log files to decode")
+        ("channel,c", value<vector<string> >(&channels),
+         "only output these channels")
+        ("help,h", "print this message");
+
+    positional_options_description pos;
+    pos.add("file", -1);
+
+    variables_map vm;
+    store(command_line_parser(argc, argv)
+          .options(all_opt)
+          .positional(pos)
+          .run(),
+          vm);
+    notify(vm);
+
+    if (vm.count("help") || files.empty()) {
+        cerr << all_opt << endl;
+        exit(1);
+    }
+
+    set<string> only(channels.begin(), channels.end());
+
+    for (auto & file: files) {
+        BinaryLogReader reader(file);
+        reader.forEachRecord([&] (const char * data, size_t size)
+            {
+                LogRecord record = LogRecord::decode(data, size);
+                if (!only.empty() && !only.count(record.channelName))
+                    return;
+
+                auto parts = record.toText();
+                for (unsigned i = 0;  i < parts.size();  ++i)
+                    cout << (i ? "\t" : "") << parts[i];
+                cout << "\n";
+            });
+    }
+}
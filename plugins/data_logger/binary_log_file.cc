@@ -0,0 +1,252 @@
+/* binary_log_file.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Compressed, block indexed files of binary log records.
+*/
+
+#include "binary_log_file.h"
+#include "rtbkit/common/log_record.h"
+#include "jml/arch/exception.h"
+
+#include <zlib.h>
+#include <cstring>
+
+using namespace std;
+
+namespace RTBKIT {
+
+namespace {
+
+const char FileMagic[8] = { 'R', 'T', 'B', 'L', 'O', 'G', '0', '1' };
+const char IndexMagic[8] = { 'R', 'T', 'B', 'I', 'D', 'X', '0', '1' };
+
+struct BlockHeader {
+    uint32_t rawSize;
+    uint32_t compressedSize;
+    uint32_t numRecords;
+    int64_t firstTimestamp;
+} __attribute__((__packed__));
+
+struct Footer {
+    uint64_t indexOffset;
+    uint32_t numBlocks;
+    char magic[8];
+} __attribute__((__packed__));
+
+/** Timestamp of an encoded record; see LogRecord for the layout. */
+int64_t recordTimestamp(const char * record, size_t size)
+{
+    size_t pos = 3;
+    if (size > 2 && record[2] == LC_OTHER) {
+        uint64_t len = 0;
+        for (int shift = 0;  pos < size;  shift += 7) {
+            uint8_t c = record[pos++];
+            len |= uint64_t(c & 0x7f) << shift;
+            if (!(c & 0x80)) break;
+        }
+        pos += len;
+    }
+
+    int64_t result = 0;
+    if (pos + sizeof(result) <= size)
+        memcpy(&result, record + pos, sizeof(result));
+    return result;
+}
+
+} // file scope
+
+
+/*****************************************************************************/
+/* BINARY LOG WRITER                                                         */
+/*****************************************************************************/
+
+BinaryLogWriter::
+BinaryLogWriter(const std::string & filename, size_t blockSize)
+    : stream(filename.c_str(), ios::binary | ios::trunc),
+      blockSize(blockSize),
+      blockRecords(0),
+      blockFirstTimestamp(0)
+{
+    if (!stream)
+        throw ML::Exception("couldn't open binary log file " + filename);
+    stream.write(FileMagic, sizeof(FileMagic));
+    block.reserve(blockSize + blockSize / 8);
+}
+
+BinaryLogWriter::
+~BinaryLogWriter()
+{
+    close();
+}
+
+void
+BinaryLogWriter::
+write(const char * record, size_t size)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!stream.is_open())
+        throw ML::Exception("write to closed binary log file");
+
+    if (blockRecords == 0)
+        blockFirstTimestamp = recordTimestamp(record, size);
+
+    uint64_t len = size;
+    while (len >= 0x80) {
+        block.push_back(char((len & 0x7f) | 0x80));
+        len >>= 7;
+    }
+    block.push_back(char(len));
+    block.append(record, size);
+    ++blockRecords;
+
+    if (block.size() >= blockSize)
+        flushBlock();
+}
+
+void
+BinaryLogWriter::
+flushBlock()
+{
+    if (blockRecords == 0) return;
+
+    uLongf compressedSize = compressBound(block.size());
+    compressed.resize(compressedSize);
+    int res = compress2((Bytef *)&compressed[0], &compressedSize,
+                        (const Bytef *)block.data(), block.size(),
+                        Z_BEST_SPEED);
+    if (res != Z_OK)
+        throw ML::Exception("couldn't compress binary log block: %d", res);
+
+    BinaryLogFile::BlockInfo info;
+    info.offset = stream.tellp();
+    info.numRecords = blockRecords;
+    info.firstTimestamp = blockFirstTimestamp;
+    index.push_back(info);
+
+    BlockHeader header;
+    header.rawSize = block.size();
+    header.compressedSize = compressedSize;
+    header.numRecords = blockRecords;
+    header.firstTimestamp = blockFirstTimestamp;
+    stream.write((const char *)&header, sizeof(header));
+    stream.write(compressed.data(), compressedSize);
+
+    block.clear();
+    blockRecords = 0;
+}
+
+void
+BinaryLogWriter::
+close()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!stream.is_open()) return;
+
+    flushBlock();
+
+    Footer footer;
+    footer.indexOffset = stream.tellp();
+    footer.numBlocks = index.size();
+    memcpy(footer.magic, IndexMagic, sizeof(IndexMagic));
+
+    for (auto & info: index) {
+        stream.write((const char *)&info.offset, sizeof(info.offset));
+        stream.write((const char *)&info.numRecords, sizeof(info.numRecords));
+        stream.write((const char *)&info.firstTimestamp,
+                     sizeof(info.firstTimestamp));
+    }
+    stream.write((const char *)&footer, sizeof(footer));
+    stream.close();
+}
+
+
+/*****************************************************************************/
+/* BINARY LOG READER                                                         */
+/*****************************************************************************/
+
+BinaryLogReader::
+BinaryLogReader(const std::string & filename)
+    : stream(filename.c_str(), ios::binary)
+{
+    if (!stream)
+        throw ML::Exception("couldn't open binary log file " + filename);
+
+    char magic[sizeof(FileMagic)];
+    stream.read(magic, sizeof(magic));
+    if (!stream || memcmp(magic, FileMagic, sizeof(magic)))
+        throw ML::Exception(filename + " is not a binary log file");
+
+    Footer footer;
+    stream.seekg(-(int)sizeof(footer), ios::end);
+    stream.read((char *)&footer, sizeof(footer));
+    if (!stream || memcmp(footer.magic, IndexMagic, sizeof(IndexMagic)))
+        throw ML::Exception(filename + " has no block index; was it closed?");
+
+    stream.seekg(footer.indexOffset);
+    index.resize(footer.numBlocks);
+    for (auto & info: index) {
+        stream.read((char *)&info.offset, sizeof(info.offset));
+        stream.read((char *)&info.numRecords, sizeof(info.numRecords));
+        stream.read((char *)&info.firstTimestamp, sizeof(info.firstTimestamp));
+    }
+    if (!stream)
+        throw ML::Exception(filename + " has a truncated block index");
+}
+
+void
+BinaryLogReader::
+readBlock(size_t blockNum, const OnRecord & onRecord)
+{
+    BlockHeader header;
+    stream.seekg(index.at(blockNum).offset);
+    stream.read((char *)&header, sizeof(header));
+
+    std::string compressed(header.compressedSize, '\0');
+    stream.read(&compressed[0], header.compressedSize);
+    if (!stream)
+        throw ML::Exception("truncated binary log block %zd", blockNum);
+
+    std::string raw(header.rawSize, '\0');
+    uLongf rawSize = header.rawSize;
+    int res = uncompress((Bytef *)&raw[0], &rawSize,
+                         (const Bytef *)compressed.data(), compressed.size());
+    if (res != Z_OK || rawSize != header.rawSize)
+        throw ML::Exception("couldn't decompress binary log block %zd",
+                            blockNum);
+
+    const char * p = raw.data();
+    const char * end = p + raw.size();
+    for (uint32_t i = 0;  i < header.numRecords;  ++i) {
+        uint64_t len = 0;
+        for (int shift = 0;  p < end;  shift += 7) {
+            uint8_t c = *p++;
+            len |= uint64_t(c & 0x7f) << shift;
+            if (!(c & 0x80)) break;
+        }
+        if (len > uint64_t(end - p))
+            throw ML::Exception("corrupt binary log block %zd", blockNum);
+        onRecord(p, len);
+        p += len;
+    }
+}
+
+void
+BinaryLogReader::
+forEachRecord(const OnRecord & onRecord, Date start, Date end)
+{
+    for (size_t i = 0;  i < index.size();  ++i) {
+        // Blocks are in time order, so a block can only hold records before
+        // start if the next one starts before it.
+        if (i + 1 < index.size()
+            && index[i + 1].firstTimestamp
+               < start.secondsSinceEpoch() * 1000000.0)
+            continue;
+        if (index[i].firstTimestamp > end.secondsSinceEpoch() * 1000000.0)
+            break;
+        readBlock(i, onRecord);
+    }
+}
+
+} // namespace RTBKIT
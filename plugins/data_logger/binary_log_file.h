@@ -0,0 +1,112 @@
+/* binary_log_file.h                                               -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Compressed, block indexed files of binary log records.
+*/
+
+#pragma once
+
+#include "soa/types/date.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+namespace RTBKIT {
+
+using namespace Datacratic;
+
+
+/*****************************************************************************/
+/* BINARY LOG FILE                                                           */
+/*****************************************************************************/
+
+/** File layout:
+
+    - 8 byte magic
+    - blocks, each with a header (raw size, compressed size, number of
+      records, timestamp of the first record) followed by the zlib
+      compressed records, each prefixed with its size as a varint
+    - the block index: offset, number of records and first timestamp of
+      every block
+    - a footer with the offset of the index, the number of blocks and an
+      8 byte magic
+
+    The index allows a reader to seek to the blocks covering a time range
+    without decompressing the whole file.
+*/
+struct BinaryLogFile {
+
+    struct BlockInfo {
+        uint64_t offset;
+        uint32_t numRecords;
+        int64_t firstTimestamp;   ///< microseconds since the epoch
+    };
+};
+
+
+/*****************************************************************************/
+/* BINARY LOG WRITER                                                         */
+/*****************************************************************************/
+
+struct BinaryLogWriter {
+
+    BinaryLogWriter(const std::string & filename,
+                    size_t blockSize = 1024 * 1024);
+    ~BinaryLogWriter();
+
+    /** Append an encoded LogRecord.  The record is copied straight into the
+        current block.
+    */
+    void write(const char * record, size_t size);
+
+    /** Flush the current block and write the index.  Further writes throw. */
+    void close();
+
+private:
+    void flushBlock();
+
+    std::mutex lock;
+    std::ofstream stream;
+    size_t blockSize;
+    std::string block;
+    uint32_t blockRecords;
+    int64_t blockFirstTimestamp;
+    std::vector<BinaryLogFile::BlockInfo> index;
+    std::string compressed;
+};
+
+
+/*****************************************************************************/
+/* BINARY LOG READER                                                         */
+/*****************************************************************************/
+
+struct BinaryLogReader {
+
+    BinaryLogReader(const std::string & filename);
+
+    const std::vector<BinaryLogFile::BlockInfo> & blocks() const
+    {
+        return index;
+    }
+
+    typedef std::function<void (const char * record, size_t size)> OnRecord;
+
+    /** Call the callback for every record of the given block. */
+    void readBlock(size_t blockNum, const OnRecord & onRecord);
+
+    /** Call the callback for every record in the blocks that may hold records
+        between the two dates.
+    */
+    void forEachRecord(const OnRecord & onRecord,
+                       Date start = Date::negativeInfinity(),
+                       Date end = Date::positiveInfinity());
+
+private:
+    std::ifstream stream;
+    std::vector<BinaryLogFile::BlockInfo> index;
+};
+
+} // namespace RTBKIT
@@ -8,6 +8,7 @@
 
 
 #include "data_logger.h"
+#include "rtbkit/common/log_record.h"
 
 
 using namespace std;
@@ -42,12 +43,7 @@ init()
     multipleSubscriber.init(getServices()->config);
     multipleSubscriber.messageHandler
         = [&] (vector<zmq::message_t> && msg) {
-        // forward to logger class
-        vector<string> s;
-        s.reserve(msg.size());
-        for (auto & m: msg)
-            s.push_back(m.toString());
-        this->logMessageNoTimestamp(s);
+        this->handleMessage(std::move(msg));
     };
     loopMonitor_.init();
     loopMonitor_.addMessageLoop("logger", &messageLoop);
@@ -55,6 +51,43 @@ init()
     //                      multipleSubscriber);
 }
 
+void
+DataLogger::
+handleMessage(vector<zmq::message_t> && msg)
+{
+    // Binary records come as the channel followed by the record
+    if (msg.size() == 2
+        && LogRecord::isRecord((const char *)msg[1].data(), msg[1].size())) {
+        if (binaryWriter_)
+            binaryWriter_->write((const char *)msg[1].data(), msg[1].size());
+
+        try {
+            auto record = LogRecord::decode((const char *)msg[1].data(),
+                                            msg[1].size());
+            this->logMessageNoTimestamp(record.toText());
+        } catch (const std::exception & exc) {
+            recordHit("errorDecodingRecord");
+            cerr << "error decoding binary log record: " << exc.what()
+                 << endl;
+        }
+        return;
+    }
+
+    // forward to logger class
+    vector<string> s;
+    s.reserve(msg.size());
+    for (auto & m: msg)
+        s.push_back(m.toString());
+    this->logMessageNoTimestamp(s);
+}
+
+void
+DataLogger::
+logBinaryTo(const std::string & filename)
+{
+    binaryWriter_.reset(new BinaryLogWriter(filename));
+}
+
 void
 DataLogger::
 start(std::function<void ()> onStop)
@@ -75,7 +108,9 @@ shutdown()
     monitorProviderClient.shutdown();
     Logger::shutdown();
     multipleSubscriber.shutdown();
-    
+    if (binaryWriter_)
+        binaryWriter_->close();
+
 }
 
 void
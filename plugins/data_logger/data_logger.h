@@ -16,6 +16,7 @@
 #include "soa/service/zmq_named_pub_sub.h"
 #include "soa/service/loop_monitor.h"
 #include "rtbkit/core/monitor/monitor_provider.h"
+#include "binary_log_file.h"
 
 #include "soa/logger/logger.h"
 
@@ -38,6 +39,14 @@ struct DataLogger : public Datacratic::ServiceBase,
     void connectAllServiceProviders(const std::string & serviceClass,
                                     const std::string & epName);
 
+    /** Also write the binary records published by the router and post
+        auction loop as-is to the given block indexed file.  Must be called
+        before start().  Binary records are always rendered back into the
+        text format as well, and go through the logger outputs like any
+        other message.
+    */
+    void logBinaryTo(const std::string & filename);
+
     void unsafeDisableMonitor() {
         monitorProviderClient.inhibit_ = true;
     }
@@ -58,6 +67,11 @@ struct DataLogger : public Datacratic::ServiceBase,
 
     bool monitor_;
     LoopMonitor loopMonitor_;
+
+private:
+    void handleMessage(std::vector<zmq::message_t> && msg);
+
+    std::unique_ptr<BinaryLogWriter> binaryWriter_;
 };
 
 } // namespace RTKBIT
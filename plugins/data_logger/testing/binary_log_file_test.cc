@@ -0,0 +1,160 @@
+/* binary_log_file_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the block indexed binary log files.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+#include "rtbkit/plugins/data_logger/binary_log_file.h"
+#include "rtbkit/common/log_record.h"
+#include "jml/arch/exception.h"
+#include <unistd.h>
+#include <cstdio>
+
+using namespace std;
+using namespace RTBKIT;
+
+namespace {
+
+struct TempFile {
+    TempFile()
+        : filename("/tmp/binary_log_file_test-"
+                   + to_string(getpid()) + ".rtblog")
+    {
+    }
+
+    ~TempFile()
+    {
+        unlink(filename.c_str());
+    }
+
+    string filename;
+};
+
+Date start = Date::fromSecondsSinceEpoch(1368153863);
+
+/** Writes numRecords records one second apart, in blocks small enough to
+    hold only a few of them each.
+*/
+void writeRecords(const string & filename, int numRecords)
+{
+    BinaryLogWriter writer(filename, 256);
+    for (int i = 0;  i < numRecords;  ++i) {
+        string record = LogRecord::encode("BID", start.plusSeconds(i),
+                                          "agent", i, string(50, 'x'));
+        writer.write(record.c_str(), record.size());
+    }
+    writer.close();
+}
+
+/** Number of the record, as given to writeRecords(). */
+int recordNum(const char * data, size_t size)
+{
+    LogRecord record = LogRecord::decode(data, size);
+    return stoi(record.fields.at(1).second);
+}
+
+} // file scope
+
+
+BOOST_AUTO_TEST_CASE( test_binary_log_file_round_trip )
+{
+    TempFile file;
+    enum { NumRecords = 100 };
+    writeRecords(file.filename, NumRecords);
+
+    BinaryLogReader reader(file.filename);
+    auto & blocks = reader.blocks();
+    BOOST_REQUIRE_GT(blocks.size(), 1);
+
+    size_t total = 0;
+    for (size_t i = 0;  i < blocks.size();  ++i) {
+        total += blocks[i].numRecords;
+        if (i > 0)
+            BOOST_CHECK_GT(blocks[i].firstTimestamp,
+                           blocks[i - 1].firstTimestamp);
+    }
+    BOOST_CHECK_EQUAL(total, NumRecords);
+    BOOST_CHECK_EQUAL(blocks[0].firstTimestamp,
+                      int64_t(start.secondsSinceEpoch()) * 1000000);
+
+    // Every record comes back once, in order and unchanged
+    vector<int> seen;
+    reader.forEachRecord([&] (const char * data, size_t size)
+                         {
+                             LogRecord record = LogRecord::decode(data, size);
+                             BOOST_CHECK_EQUAL(record.channelName, "BID");
+                             BOOST_CHECK_EQUAL(record.fields.at(2).second,
+                                               string(50, 'x'));
+                             seen.push_back(recordNum(data, size));
+                         });
+    BOOST_REQUIRE_EQUAL(seen.size(), NumRecords);
+    for (int i = 0;  i < NumRecords;  ++i)
+        BOOST_CHECK_EQUAL(seen[i], i);
+
+    // A single block
+    vector<int> inBlock;
+    reader.readBlock(1, [&] (const char * data, size_t size)
+                     {
+                         inBlock.push_back(recordNum(data, size));
+                     });
+    BOOST_CHECK_EQUAL(inBlock.size(), blocks[1].numRecords);
+    BOOST_CHECK_EQUAL(inBlock.at(0), blocks[0].numRecords);
+}
+
+BOOST_AUTO_TEST_CASE( test_binary_log_file_time_range )
+{
+    TempFile file;
+    enum { NumRecords = 100 };
+    writeRecords(file.filename, NumRecords);
+
+    BinaryLogReader reader(file.filename);
+
+    // Only the blocks that may hold records in the range are read, and
+    // together they cover all of it.
+    int first = 40, last = 59;
+    vector<int> seen;
+    reader.forEachRecord([&] (const char * data, size_t size)
+                         {
+                             seen.push_back(recordNum(data, size));
+                         },
+                         start.plusSeconds(first), start.plusSeconds(last));
+
+    BOOST_REQUIRE(!seen.empty());
+    BOOST_CHECK_LE(seen.front(), first);
+    BOOST_CHECK_GE(seen.back(), last);
+    BOOST_CHECK_LT(seen.size(), NumRecords);
+    for (size_t i = 1;  i < seen.size();  ++i)
+        BOOST_CHECK_EQUAL(seen[i], seen[i - 1] + 1);
+
+    // Nothing before the file starts
+    seen.clear();
+    reader.forEachRecord([&] (const char * data, size_t size)
+                         {
+                             seen.push_back(recordNum(data, size));
+                         },
+                         start.plusSeconds(-100), start.plusSeconds(-1));
+    BOOST_CHECK(seen.empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_binary_log_file_unclosed )
+{
+    TempFile file;
+
+    BinaryLogWriter writer(file.filename);
+    string record = LogRecord::encode("BID", start, "agent");
+    writer.write(record.c_str(), record.size());
+
+    // The index is only written on close
+    BOOST_CHECK_THROW(BinaryLogReader reader(file.filename), ML::Exception);
+
+    writer.close();
+    BOOST_CHECK_THROW(writer.write(record.c_str(), record.size()),
+                      ML::Exception);
+
+    BinaryLogReader reader(file.filename);
+    BOOST_CHECK_EQUAL(reader.blocks().size(), 1);
+}
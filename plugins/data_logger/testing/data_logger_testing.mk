@@ -0,0 +1,3 @@
+# data_logger_testing.mk
+
+$(eval $(call test,binary_log_file_test,data_logger rtb,boost))
@@ -54,6 +54,7 @@ AdXExchangeConnector::
 AdXExchangeConnector(ServiceBase & owner, const std::string & name)
     : HttpExchangeConnector(name, owner)
 {
+    initMetrics();
 }
 
 AdXExchangeConnector::
@@ -64,6 +65,19 @@ AdXExchangeConnector(const std::string & name,
     // useless?
     this->auctionResource = "/auctions";
     this->auctionVerb = "POST";
+    initMetrics();
+}
+
+void
+AdXExchangeConnector::
+initMetrics()
+{
+    attributeExcluded = metrics.counter("attribute_excluded");
+    sensitiveCategoryExcluded = metrics.counter("sensitive_category_excluded");
+    vendorTypeNotAllowed = metrics.counter("vendor_type_not_allowed");
+    adgroupNotAllowed = metrics.counter("adgroup_not_allowed");
+    restrictedCategoryNotAllowed
+        = metrics.counter("restricted_category_not_allowed");
 }
 
 // using GoogleBidRequest = ::BidRequest ;
@@ -73,6 +87,74 @@ typedef ::BidResponse GoogleBidResponse ;
 
 namespace {
 
+/**
+ *    The request is parsed into a message kept per thread: protobuf keeps
+ *    the strings and repeated fields of a cleared message allocated, so
+ *    after the first few requests parsing no longer allocates.  Like the
+ *    handler free lists, the message lives as long as the thread.
+ */
+__thread GoogleBidRequest * threadBidRequest = 0;
+
+GoogleBidRequest &
+getThreadBidRequest()
+{
+    if (!threadBidRequest)
+        threadBidRequest = new GoogleBidRequest();
+    return *threadBidRequest;
+}
+
+/** Hex encodes the given bytes. */
+std::string
+binaryToHexStr(const std::string & str)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    std::string result(str.size() * 2, '0');
+    for (size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = str[i];
+        result[2 * i] = digits[c >> 4];
+        result[2 * i + 1] = digits[c & 0xf];
+    }
+    return result;
+}
+
+/** Formats the bytes of an address as decimal numbers separated by the
+    given character, followed by the given suffix.
+*/
+std::string
+formatIp(const std::string & ip, char separator, const char * suffix = "")
+{
+    char buffer[32];
+    char * p = buffer;
+
+    for (size_t i = 0; i < ip.size(); ++i) {
+        unsigned char c = ip[i];
+        if (i > 0) *p++ = separator;
+        if (c >= 100) *p++ = '0' + c / 100;
+        if (c >= 10) *p++ = '0' + c / 10 % 10;
+        *p++ = '0' + c % 10;
+    }
+    while (*suffix) *p++ = *suffix++;
+
+    return std::string(buffer, p);
+}
+
+/** Adds the values of a repeated integer field as the segments of the given
+    source, without going through a temporary vector.
+*/
+template<typename Repeated>
+void
+addIntSegments(SegmentsBySource & segments, const std::string & source,
+               const Repeated & values)
+{
+    auto segs = std::make_shared<SegmentList>();
+    segs->ints.reserve(values.size());
+    for (auto i: boost::irange(0, values.size()))
+        segs->ints.push_back(values.Get(i));
+    segs->sort();
+    segments.addSegment(source, segs);
+}
+
 /**
  *    void ParseGbrMobile ()
  *
@@ -291,35 +373,24 @@ ParseGbrAdSlot (const GoogleBidRequest& gbr, BidRequest& br)
 
         // Parse restrictions ;
         {
-            vector<int> tmp ;
-            for (auto i: boost::irange(0,slot.allowed_vendor_type_size()))
-                tmp.push_back(slot.allowed_vendor_type(i));
-            spot.restrictions.addInts("allowed_vendor_type", tmp);
-
-            tmp.clear();
-            for (auto i: boost::irange(0,slot.excluded_attribute_size()))
-                tmp.push_back(slot.excluded_attribute(i));
-            spot.restrictions.addInts("excluded_attribute", tmp);
-
-            tmp.clear();
-            for (auto i: boost::irange(0,slot.excluded_sensitive_category_size()))
-                tmp.push_back(slot.excluded_sensitive_category(i));
-            spot.restrictions.addInts("excluded_sensitive_category", tmp);
-
-            vector<std::string> adg_ids;
+            auto& restrictions = spot.restrictions;
+            addIntSegments(restrictions, "allowed_vendor_type",
+                           slot.allowed_vendor_type());
+            addIntSegments(restrictions, "excluded_attribute",
+                           slot.excluded_attribute());
+            addIntSegments(restrictions, "excluded_sensitive_category",
+                           slot.excluded_sensitive_category());
+
+            auto adg_ids = std::make_shared<SegmentList>();
             for (auto i: boost::irange(0,slot.matching_ad_data_size())){
-                if(slot.matching_ad_data(i).has_adgroup_id()){
-                    adg_ids.push_back(
-                        boost::lexical_cast<std::string>(
-                            slot.matching_ad_data(i).adgroup_id()));
-                }
+                if(slot.matching_ad_data(i).has_adgroup_id())
+                    adg_ids->add(to_string(slot.matching_ad_data(i).adgroup_id()));
             }
-            spot.restrictions.addStrings("allowed_adgroup", adg_ids);
+            adg_ids->sort();
+            restrictions.addSegment("allowed_adgroup", adg_ids);
 
-            tmp.clear();
-            for (auto i: boost::irange(0,slot.allowed_restricted_category_size()))
-                tmp.push_back(slot.allowed_restricted_category(i));
-            spot.restrictions.addInts("allowed_restricted_category", tmp);
+            addIntSegments(restrictions, "allowed_restricted_category",
+                           slot.allowed_restricted_category());
         }
 
         if (slot.has_slot_visibility())
@@ -363,8 +434,8 @@ parseBidRequest(HttpAuctionHandler & connection,
     }
 
     // Try and parse the protocol buffer payload
-    GoogleBidRequest gbr;
-    if (!gbr.ParseFromString (payload))
+    GoogleBidRequest& gbr = getThreadBidRequest();
+    if (!gbr.ParseFromArray (payload.data(), payload.size()))
     {
         connection.sendErrorResponse("couldn't decode BidRequest message");
         return std::shared_ptr<BidRequest> ();
@@ -385,18 +456,8 @@ parseBidRequest(HttpAuctionHandler & connection,
 
     auto& br = *res ;
 
-    // TODO: check reuse
-    auto binary_to_hexstr = [] (const std::string& str)
-    {
-        std::ostringstream os;
-        os << std::hex << std::setfill('0');
-        const unsigned char* pc = reinterpret_cast<const unsigned char*>(str.c_str()) ;
-        for (auto i=0 ; i<str.size(); i++,pc++) os << std::setw(2) << int(*pc) ;
-        return os.str() ;
-    };
-
     // TODO couldn't get Id() to represent correctly [required bytes id = 2;]
-    br.auctionId = Id (binary_to_hexstr(gbr.id()));
+    br.auctionId = Id (binaryToHexStr(gbr.id()));
     // AdX is a second price auction type.
 
     br.timestamp = Date::now();
@@ -426,45 +487,13 @@ parseBidRequest(HttpAuctionHandler & connection,
 
         if (3==gbr.ip().length())
         {
-            struct Ip
-            {
-                unsigned char a;
-                unsigned char b;
-                unsigned char c;
-
-                operator std::string() const
-                {
-                    return std::to_string(uint32_t(a)) + "."
-                           + std::to_string(uint32_t(b)) + "."
-                           + std::to_string(uint32_t(c)) + ".0";
-                }
-            } ip = *reinterpret_cast<const Ip*>(gbr.ip().data());
-            device.ip = ip;
+            device.ip = formatIp(gbr.ip(), '.', ".0");
         }
         else if (6==gbr.ip().size())
         {
             // TODO: proto says that 3 bytes will be transmitted
             // for IPv4 and 6 bytes for IPv6...
-            struct Ip
-            {
-                unsigned char a;
-                unsigned char b;
-                unsigned char c;
-                unsigned char d;
-                unsigned char e;
-                unsigned char f;
-
-                operator std::string() const
-                {
-                    return std::to_string(uint32_t(a)) + ":"
-                           + std::to_string(uint32_t(b)) + ":"
-                           + std::to_string(uint32_t(c)) + ":"
-                           + std::to_string(uint32_t(d)) + ":"
-                           + std::to_string(uint32_t(e)) + ":"
-                           + std::to_string(uint32_t(f));
-                }
-            } ip = *reinterpret_cast<const Ip*>(gbr.ip().data());
-            device.ip = ip;
+            device.ip = formatIp(gbr.ip(), ':');
         }
     }
 
@@ -485,7 +514,7 @@ parseBidRequest(HttpAuctionHandler & connection,
 
     if (gbr.has_hosted_match_data())
     {
-        br.user->buyeruid = Id(binary_to_hexstr(gbr.hosted_match_data()));
+        br.user->buyeruid = Id(binaryToHexStr(gbr.hosted_match_data()));
     }
 
     if (gbr.has_cookie_age_seconds())
@@ -540,35 +569,19 @@ parseBidRequest(HttpAuctionHandler & connection,
     // detected verticals:
     if (gbr.detected_vertical_size() > 0)
     {
-        vector<pair<int,float>> segs;
+        auto segs = std::make_shared<SegmentList>();
+        segs->ints.reserve(gbr.detected_vertical_size());
         for (auto i: boost::irange(0,gbr.detected_vertical_size()))
-            segs.emplace_back(make_pair(gbr.detected_vertical(i).id(),
-                                        gbr.detected_vertical(i).weight()));
-        br.segments.addWeightedInts("AdxDetectedVerticals", segs);
+            segs->add(gbr.detected_vertical(i).id(),
+                      gbr.detected_vertical(i).weight());
+        segs->sort();
+        br.segments.addSegment("AdxDetectedVerticals", segs);
     }
     // auto str = res->toJsonStr();
     // cerr << "RTBKIT::BidRequest: " << str << endl ;
     return res ;
 }
 
-namespace {
-/**
- *   with dict = {{"K1","V1"}, {"K2","V2"}, ...}
- *   return a copy of the input string, in which all the
- *   occurrences of the string "${Ki}" are replaced
- *   by the string "Vi"
- */
-string
-myFormat (const string& in, unordered_map<string,string>& dict)
-{
-    auto format_dict = [&](smatch const& what) {
-        return dict[what[1].str()];
-    };
-    static sregex envar = "${" >> (s1 = +_w) >> "}";
-    auto rc = regex_replace(in, envar, format_dict);
-    return rc;
-}
-}
 /**
  *  prepare a Google BidResponse.
  *  Will handle
@@ -589,6 +602,11 @@ getResponse(const HttpAuctionHandler & connection,
 
     auto en = exchangeName();
 
+    // Reused across the spots
+    const string auctionId = auction.id.toString();
+    CreativeMacros macros;
+    string buffer;
+
     // Create a spot for each of the bid responses
     for (auto spotNum: boost::irange(0UL, current->responses.size()))
     {
@@ -618,20 +636,27 @@ getResponse(const HttpAuctionHandler & connection,
 
         // 1. take care of the agent defined macros,
         // passed along with every bid response, as a
-        // stringified JSON object (a la Python)
-        unordered_map<string,string> dict;
-        auto 	vals = Json::parse (resp.meta);
-        for (auto name: vals.getMemberNames())
-            dict[name] = vals.atStr(name).asString();
+        // stringified JSON object (a la Python).  Only
+        // parsed if the creative actually uses them.
+        macros.clear();
+        if (crinfo->needs_meta_) {
+            auto vals = Json::parse (resp.meta);
+            for (auto name: vals.getMemberNames())
+                macros.set(name, vals.atStr(name).asString());
+        }
 
         // 2. enrich the above dictionary, with
         // ExchangeConnector specific variables
-        dict["AUCTION_ID"] = auction.id.toString();
+        macros.set("AUCTION_ID", auctionId);
 
         // 3. populate, substituting whenever necessary
         ad->set_buyer_creative_id(crinfo->buyer_creative_id_);
-        ad->set_html_snippet(myFormat(crinfo->html_snippet_,dict));
-        ad->add_click_through_url(myFormat(crinfo->click_through_url_,dict));
+        buffer.clear();
+        crinfo->html_snippet_template_.render(buffer, macros);
+        ad->set_html_snippet(buffer);
+        buffer.clear();
+        crinfo->click_through_url_template_.render(buffer, macros);
+        ad->add_click_through_url(buffer);
         ad->set_width(creative.format.width);
         ad->set_height(creative.format.height);
         for(auto& vt : crinfo->vendor_type_)
@@ -819,8 +844,49 @@ getCreativeCompatibility(const Creative & creative,
     }
 
     if (result.isCompatible) {
+        // Split the markup into literals and macros once and for all
+        crinfo->html_snippet_template_.compile(crinfo->html_snippet_);
+        crinfo->click_through_url_template_
+            .compile(crinfo->click_through_url_);
+        const vector<string> builtins = { "AUCTION_ID" };
+        crinfo->needs_meta_
+            = crinfo->html_snippet_template_.usesMacrosOtherThan(builtins)
+            || crinfo->click_through_url_template_.usesMacrosOtherThan(builtins);
+
         // Cache the information
         result.info = crinfo;
+
+        // Describe what bidRequestCreativeFilter checks so that the router
+        // can index it instead of calling it for every request.
+        auto constraints = std::make_shared<CreativeConstraints>();
+        auto addConstraint = [&] (const std::string & restriction,
+                                  CreativeConstraint::Type type,
+                                  const std::unordered_set<int32_t> & values)
+            {
+                if (values.empty()) return;
+                constraints->emplace_back(restriction, type);
+                for (auto value: values)
+                    constraints->back().values.add(value);
+                constraints->back().values.sort();
+            };
+
+        addConstraint("excluded_attribute", CreativeConstraint::EXCLUDED,
+                      crinfo->attribute_);
+        addConstraint("excluded_sensitive_category",
+                      CreativeConstraint::EXCLUDED, crinfo->category_);
+        addConstraint("allowed_vendor_type", CreativeConstraint::ALLOWED,
+                      crinfo->vendor_type_);
+        addConstraint("allowed_restricted_category",
+                      CreativeConstraint::ALLOWED,
+                      crinfo->restricted_category_);
+
+        if (!crinfo->adgroup_id_.empty()) {
+            constraints->emplace_back("allowed_adgroup",
+                                      CreativeConstraint::ALLOWED_IF_LISTED);
+            constraints->back().values.add(crinfo->adgroup_id_);
+        }
+
+        result.constraints = constraints;
     }
 
     return result;
@@ -847,7 +913,7 @@ bidRequestCreativeFilter(const BidRequest & request,
         for (auto atr: crinfo->attribute_)
             if (excluded_attribute_seg.contains(atr))
             {
-                this->recordHit ("attribute_excluded");
+                attributeExcluded.hit();
                 return false ;
             }
 
@@ -856,7 +922,7 @@ bidRequestCreativeFilter(const BidRequest & request,
         for (auto atr: crinfo->category_)
             if (excluded_sensitive_category_seg.contains(atr))
             {
-                this->recordHit ("sensitive_category_excluded");
+                sensitiveCategoryExcluded.hit();
                 return false ;
             }
 
@@ -865,7 +931,7 @@ bidRequestCreativeFilter(const BidRequest & request,
         for (auto atr: crinfo->vendor_type_)
             if (!allowed_vendor_type_seg.contains(atr))
             {
-                this->recordHit ("vendor_type_not_allowed");
+                vendorTypeNotAllowed.hit();
                 return false ;
             }
 
@@ -875,7 +941,7 @@ bidRequestCreativeFilter(const BidRequest & request,
                  && !allowed_adgroup_seg.empty()
                  && !crinfo->adgroup_id_.empty())
         {
-            this->recordHit ("adgroup_not_allowed");
+            adgroupNotAllowed.hit();
             return false ;
         }
 
@@ -889,7 +955,7 @@ bidRequestCreativeFilter(const BidRequest & request,
                   && !crinfo->restricted_category_.empty())
                 )
             {
-                this->recordHit ("restricted_category_not_allowed");
+                restrictedCategoryNotAllowed.hit();
                 return false ;
             }
     }
@@ -12,6 +12,7 @@
 #include <unordered_set>
 
 #include "rtbkit/plugins/exchange/http_exchange_connector.h"
+#include "rtbkit/plugins/exchange/creative_template.h"
 
 namespace RTBKIT {
 
@@ -103,6 +104,10 @@ struct AdXExchangeConnector: public HttpExchangeConnector {
         std::unordered_set<int32_t> attribute_;     ///< Attribute
         std::unordered_set<int32_t> 
                         restricted_category_;       ///< Restricted category
+
+        CreativeTemplate html_snippet_template_;    ///< Compiled snippet
+        CreativeTemplate click_through_url_template_; ///< Compiled click url
+        bool needs_meta_;   ///< Do the templates use the bid's meta macros?
     };
 
     virtual bool
@@ -115,6 +120,15 @@ struct AdXExchangeConnector: public HttpExchangeConnector {
                              bool includeReasons) const;
 
 private:
+    void initMetrics();
+
+    /** Reasons for which bidRequestCreativeFilter() rejects a creative. */
+    MetricRegistry::Counter attributeExcluded;
+    MetricRegistry::Counter sensitiveCategoryExcluded;
+    MetricRegistry::Counter vendorTypeNotAllowed;
+    MetricRegistry::Counter adgroupNotAllowed;
+    MetricRegistry::Counter restrictedCategoryNotAllowed;
+
     /**
      * see class comments
      */
@@ -25,6 +25,7 @@ AppNexusExchangeConnector::
 AppNexusExchangeConnector(ServiceBase & owner, const std::string & name)
     : HttpExchangeConnector(name, owner)
 {
+    attributeExcluded = metrics.counter("attribute_excluded");
 }
 
 AppNexusExchangeConnector::
@@ -32,6 +33,7 @@ AppNexusExchangeConnector(const std::string & name,
                           std::shared_ptr<ServiceProxies> proxies)
     : HttpExchangeConnector(name, proxies)
 {
+    attributeExcluded = metrics.counter("attribute_excluded");
 }
 
 std::shared_ptr<BidRequest>
@@ -268,7 +270,7 @@ bidRequestCreativeFilter(const BidRequest & request,
     for (auto atr: crinfo->attrs_)
         if (excluded_attribute_seg.contains(atr))
         {
-            this->recordHit ("attribute_excluded");
+            attributeExcluded.hit();
             return false ;
         }
 
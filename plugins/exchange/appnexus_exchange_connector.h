@@ -84,6 +84,8 @@ struct AppNexusExchangeConnector : public HttpExchangeConnector {
     getCreativeCompatibility(const Creative & creative,
                              bool includeReasons) const;
 
+private:
+    MetricRegistry::Counter attributeExcluded;
 };
 
 
@@ -0,0 +1,130 @@
+/* creative_template.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Creative markup with macros, compiled once and rendered per response.
+*/
+
+#include "creative_template.h"
+
+#include <cstring>
+#include <cctype>
+
+using namespace std;
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* CREATIVE MACROS                                                           */
+/*****************************************************************************/
+
+void
+CreativeMacros::
+set(const std::string & name, const std::string & value)
+{
+    for (auto & entry: values) {
+        if (entry.first == name) {
+            entry.second = value;
+            return;
+        }
+    }
+    values.emplace_back(name, value);
+}
+
+const std::string *
+CreativeMacros::
+find(const char * name, size_t length) const
+{
+    for (auto & entry: values) {
+        if (entry.first.size() == length
+            && memcmp(entry.first.data(), name, length) == 0)
+            return &entry.second;
+    }
+    return 0;
+}
+
+
+/*****************************************************************************/
+/* CREATIVE TEMPLATE                                                         */
+/*****************************************************************************/
+
+void
+CreativeTemplate::
+compile(const std::string & text)
+{
+    text_ = text;
+    segments.clear();
+
+    auto isNameChar = [] (char c)
+        {
+            return isalnum((unsigned char)c) || c == '_';
+        };
+
+    size_t literalStart = 0;
+    size_t pos = 0;
+
+    while ((pos = text_.find("${", pos)) != string::npos) {
+        size_t nameStart = pos + 2;
+        size_t nameEnd = nameStart;
+        while (nameEnd < text_.size() && isNameChar(text_[nameEnd]))
+            ++nameEnd;
+
+        if (nameEnd == nameStart
+            || nameEnd == text_.size() || text_[nameEnd] != '}') {
+            // Not a macro; it stays in the literal text
+            pos = nameStart;
+            continue;
+        }
+
+        if (pos > literalStart)
+            segments.push_back({ uint32_t(literalStart),
+                                 uint32_t(pos - literalStart), false });
+        segments.push_back({ uint32_t(nameStart),
+                             uint32_t(nameEnd - nameStart), true });
+
+        pos = literalStart = nameEnd + 1;
+    }
+
+    if (literalStart < text_.size())
+        segments.push_back({ uint32_t(literalStart),
+                             uint32_t(text_.size() - literalStart), false });
+}
+
+void
+CreativeTemplate::
+render(std::string & out, const CreativeMacros & macros) const
+{
+    for (auto & segment: segments) {
+        const char * start = text_.data() + segment.start;
+        if (!segment.isMacro) {
+            out.append(start, segment.length);
+            continue;
+        }
+
+        const std::string * value = macros.find(start, segment.length);
+        if (value)
+            out.append(*value);
+    }
+}
+
+bool
+CreativeTemplate::
+usesMacrosOtherThan(const std::vector<std::string> & names) const
+{
+    for (auto & segment: segments) {
+        if (!segment.isMacro) continue;
+
+        bool known = false;
+        for (auto & name: names) {
+            if (name.size() == segment.length
+                && text_.compare(segment.start, segment.length, name) == 0) {
+                known = true;
+                break;
+            }
+        }
+        if (!known) return true;
+    }
+    return false;
+}
+
+} // namespace RTBKIT
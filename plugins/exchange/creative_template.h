@@ -0,0 +1,96 @@
+/* creative_template.h                                             -*- C++ -*-
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Creative markup with macros, compiled once and rendered per response.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+namespace RTBKIT {
+
+
+/*****************************************************************************/
+/* CREATIVE MACROS                                                           */
+/*****************************************************************************/
+
+/** Values of the macros for one response.  There are only ever a handful of
+    them so they are kept in a flat list.
+*/
+struct CreativeMacros {
+
+    void clear()
+    {
+        values.clear();
+    }
+
+    /** Set the value of a macro, replacing any previous value. */
+    void set(const std::string & name, const std::string & value);
+
+    /** Value of the given macro, or null if it isn't set. */
+    const std::string * find(const char * name, size_t length) const;
+
+private:
+    std::vector<std::pair<std::string, std::string> > values;
+};
+
+
+/*****************************************************************************/
+/* CREATIVE TEMPLATE                                                         */
+/*****************************************************************************/
+
+/** Text in which every occurrence of ${NAME}, NAME being made of letters,
+    digits and underscores, is replaced by the value of the macro NAME.
+    Macros without a value are replaced by nothing.
+
+    The text is split into literal and macro segments when it is compiled,
+    which happens when the agent configuration is loaded, so that rendering
+    is a single pass over the segments.
+*/
+struct CreativeTemplate {
+
+    CreativeTemplate()
+    {
+    }
+
+    CreativeTemplate(const std::string & text)
+    {
+        compile(text);
+    }
+
+    void compile(const std::string & text);
+
+    /** Append the text with every macro substituted to out. */
+    void render(std::string & out, const CreativeMacros & macros) const;
+
+    std::string render(const CreativeMacros & macros) const
+    {
+        std::string result;
+        render(result, macros);
+        return result;
+    }
+
+    /** Does the template use any macro other than the given ones? */
+    bool usesMacrosOtherThan(const std::vector<std::string> & names) const;
+
+    const std::string & text() const
+    {
+        return text_;
+    }
+
+private:
+    struct Segment {
+        uint32_t start;     ///< Offset in the text; for a macro, of its name
+        uint32_t length;
+        bool isMacro;
+    };
+
+    std::string text_;
+    std::vector<Segment> segments;
+};
+
+} // namespace RTBKIT
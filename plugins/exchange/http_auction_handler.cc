@@ -131,12 +131,110 @@ parse(const std::string & filename,
 /* HTTP AUCTION HANDLER                                                      */
 /*****************************************************************************/
 
+namespace {
+
+/** Free list of handler sized blocks.  There are a handful per thread, one
+    for each handler size seen; blocks freed on another thread than the one
+    which allocated them simply join that thread's list.
+*/
+struct HandlerFreeList {
+    size_t size;
+    unsigned count;
+    void * head;
+};
+
+enum {
+    NumFreeLists = 4,
+    MaxFreeBlocks = 1024
+};
+
+/** The free lists of a thread.  They are given back to the allocator when
+    the thread exits, so that short lived threads don't leak their blocks.
+*/
+struct HandlerFreeLists {
+    HandlerFreeLists()
+        : exited(false)
+    {
+        for (auto & list: lists)
+            list = HandlerFreeList { 0, 0, 0 };
+    }
+
+    ~HandlerFreeLists()
+    {
+        for (auto & list: lists) {
+            while (list.head) {
+                void * mem = list.head;
+                list.head = *(void **)mem;
+                ::operator delete(mem);
+            }
+            list = HandlerFreeList { 0, 0, 0 };
+        }
+
+        // Handlers deleted later on during the thread's exit bypass the lists
+        exited = true;
+    }
+
+    HandlerFreeList lists[NumFreeLists];
+    bool exited;
+};
+
+thread_local HandlerFreeLists freeLists;
+
+HandlerFreeList * findFreeList(size_t size, bool create)
+{
+    if (freeLists.exited)
+        return 0;
+
+    for (auto & list: freeLists.lists) {
+        if (list.size == size)
+            return &list;
+        if (list.size == 0) {
+            if (!create) return 0;
+            list.size = size;
+            return &list;
+        }
+    }
+    return 0;
+}
+
+} // file scope
+
+void *
+HttpAuctionHandler::
+operator new(size_t size)
+{
+    HandlerFreeList * list = findFreeList(size, false);
+    if (list && list->head) {
+        void * mem = list->head;
+        list->head = *(void **)mem;
+        --list->count;
+        return mem;
+    }
+    return ::operator new(size);
+}
+
+void
+HttpAuctionHandler::
+operator delete(void * mem, size_t size)
+{
+    if (!mem) return;
+    HandlerFreeList * list = findFreeList(size, true);
+    if (list && list->count < MaxFreeBlocks) {
+        *(void **)mem = list->head;
+        list->head = mem;
+        ++list->count;
+        return;
+    }
+    ::operator delete(mem);
+}
+
 long HttpAuctionHandler::created = 0;
 long HttpAuctionHandler::destroyed = 0;
 
 HttpAuctionHandler::
 HttpAuctionHandler()
-    : hasTimer(false), disconnected(false), servingRequest(false)
+    : hasTimer(false), disconnected(false), servingRequest(false),
+      connectionRequests(0), connectionEndRecorded(false)
 {
     atomic_add(created, 1);
 }
@@ -169,6 +267,10 @@ onGotTransport()
         throw Exception("HttpAuctionHandler needs to be owned by an "
                         "HttpExchangeConnector");
 
+    // First handler on a new connection
+    if (connectionStart == Date())
+        connectionStart = Date::now();
+
     HttpConnectionHandler::onGotTransport();
 
     startReading();
@@ -179,6 +281,7 @@ HttpAuctionHandler::
 handleDisconnect()
 {
     doEvent("auctionDisconnection");
+    recordConnectionEnd();
 
     disconnected = true;
 
@@ -286,6 +389,8 @@ handleHttpPayload(const HttpHeader & header,
     //cerr << payload << endl;
     //cerr << endpoint->auctionVerb << " " << endpoint->auctionResource << endl;
 
+    endpoint->onIngestThread();
+
     if (header.resource != endpoint->auctionResource
         || header.verb != endpoint->auctionVerb) {
         endpoint->handleUnknownRequest(*this, header, payload);
@@ -320,8 +425,20 @@ handleHttpPayload(const HttpHeader & header,
     
     double acceptProbability = endpoint->acceptAuctionProbability;
 
-    if (acceptProbability < 1.0
-        && random() % 1000000 > 1000000 * acceptProbability) {
+    // When shedding with a pre-filter, the requests that no agent can bid
+    // on go first; that needs the parsed request so the random drop is
+    // deferred until then.
+    std::shared_ptr<const BidRequestPreFilter> preFilter;
+    if (acceptProbability < 1.0)
+        preFilter = endpoint->getPreFilter();
+
+    auto randomDrop = [&] ()
+        {
+            return acceptProbability < 1.0
+                && random() % 1000000 > 1000000 * acceptProbability;
+        };
+
+    if (!preFilter && randomDrop()) {
         // early drop...
         doEvent("auctionEarlyDrop.randomEarlyDrop");
         dropAuction("random early drop");
@@ -393,6 +510,19 @@ handleHttpPayload(const HttpHeader & header,
             return;
         }
 
+        if (preFilter) {
+            if (!preFilter->accept(*bidRequest)) {
+                doEvent("auctionEarlyDrop.preFilter");
+                dropAuction("no agent can bid");
+                return;
+            }
+            if (randomDrop()) {
+                doEvent("auctionEarlyDrop.randomEarlyDrop");
+                dropAuction("random early drop");
+                return;
+            }
+        }
+
         auction.reset(new Auction(endpoint,
                                   handleAuction, bidRequest,
                                   bidRequest->toJsonStr(),
@@ -531,13 +661,7 @@ sendResponse()
                           Date::now().secondsSince(this->firstData) * 1000.0,
                           "ms");
 
-            if (random() % 1000 == 0) {
-                this->transport().closeWhenHandlerFinished();
-            }
-            else {
-                this->transport().associateWhenHandlerFinished
-                (this->makeNewHandlerShared(), "sendFinished");
-            }
+            this->onResponseSent();
         };
 
     addActivityS("beforeSend");
@@ -550,19 +674,45 @@ sendResponse()
     putResponseOnWire(response, onSendFinished);
 }
 
+void
+HttpAuctionHandler::
+onResponseSent()
+{
+    ++connectionRequests;
+
+    if (endpoint->shouldCloseConnection(connectionRequests, connectionStart)) {
+        recordConnectionEnd();
+        transport().closeWhenHandlerFinished();
+        return;
+    }
+
+    // The next handler on this connection carries on its accounting
+    auto handler = endpoint->makeNewHandlerShared();
+    handler->connectionRequests = connectionRequests;
+    handler->connectionStart = connectionStart;
+    transport().associateWhenHandlerFinished(handler, "sendFinished");
+}
+
+void
+HttpAuctionHandler::
+recordConnectionEnd()
+{
+    if (connectionEndRecorded)
+        return;
+    connectionEndRecorded = true;
+
+    doEvent("connectionRequests", ET_OUTCOME, connectionRequests, "requests");
+    doEvent("connectionAgeMs", ET_OUTCOME,
+            Date::now().secondsSince(connectionStart) * 1000.0, "ms");
+}
+
 void
 HttpAuctionHandler::
 dropAuction(const std::string & reason)
 {
     auto onSendFinished = [=] ()
         {
-            if (random() % 1000 == 0) {
-                this->transport().closeWhenHandlerFinished();
-            }
-            else {
-                this->transport().associateWhenHandlerFinished
-                (this->makeNewHandlerShared(), "sendFinished");
-            }
+            this->onResponseSent();
         };
 
     putResponseOnWire(endpoint->getDroppedAuctionResponse(*this, reason),
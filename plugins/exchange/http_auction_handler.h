@@ -60,6 +60,13 @@ struct HttpAuctionHandler
     HttpAuctionHandler();
     ~HttpAuctionHandler();
 
+    /** A handler is created for every request, so their memory is recycled
+        through small per thread free lists instead of going back to the
+        allocator.  Derived handlers use the list for their own size.
+    */
+    static void * operator new(size_t size);
+    static void operator delete(void * mem, size_t size);
+
     /** We got our transport. */
     void onGotTransport();
 
@@ -71,6 +78,13 @@ struct HttpAuctionHandler
     bool disconnected;
     bool servingRequest;  ///< Are we currently, actively serving a request?
 
+    /** Accounting for the connection, handed from one handler to the next
+        as the connection is kept alive.
+    */
+    int connectionRequests;     ///< Responses sent on the connection so far
+    Date connectionStart;       ///< When the connection was accepted
+    bool connectionEndRecorded; ///< recordConnectionEnd() already ran
+
     virtual void handleHttpPayload(const HttpHeader & header,
                                    const std::string & payload);
 
@@ -111,6 +125,18 @@ struct HttpAuctionHandler
     */
     virtual void sendResponse();
 
+    /** Called once a response is on the wire.  Closes the connection if
+        the endpoint's connection policy says so, or hands it over to a new
+        handler for the next request otherwise.
+    */
+    void onResponseSent();
+
+    /** Record the per connection metrics when it goes away.  Only the
+        first call records anything, as a disconnection can follow the
+        close done by onResponseSent().
+    */
+    void recordConnectionEnd();
+
     /** Return a stringified JSON of the response for our auction.  Default
         implementation calls getResponse() and stringifies the result.
 
@@ -16,6 +16,9 @@
 #include "jml/arch/timers.h"
 #include "rtbkit/core/router/router.h"
 #include <set>
+#include <algorithm>
+#include <pthread.h>
+#include <cstring>
 
 #include <boost/foreach.hpp>
 
@@ -63,6 +66,8 @@ postConstructorInit()
     auctionResource = "/";
 
     numServingRequest = 0;
+    nextIngestCpu = 0;
+    ingestId = nextIngestId.fetch_add(1);
 
     // Link up events
     onTransportOpen = [=] (TransportBase *)
@@ -105,6 +110,21 @@ configure(const Json::Value & parameters)
 
     if (parameters.isMember("realTimePolling"))
         realTimePolling(parameters["realTimePolling"].asBool());
+
+    getParam(parameters, connectionPolicy.maxRequests,
+             "connectionMaxRequests");
+    getParam(parameters, connectionPolicy.maxAgeSeconds,
+             "connectionMaxAgeSeconds");
+    getParam(parameters, connectionPolicy.maxConnections,
+             "connectionMaxConnections");
+    getParam(parameters, connectionPolicy.closeProbability,
+             "connectionCloseProbability");
+
+    if (parameters.isMember("ingestCpus")) {
+        ingestCpus.clear();
+        for (auto & cpu: parameters["ingestCpus"])
+            ingestCpus.push_back(cpu.asInt());
+    }
 }
 
 void
@@ -207,6 +227,50 @@ finishedWithHandler(std::shared_ptr<HttpAuctionHandler> handler)
     handlers.erase(handler);
 }
 
+bool
+HttpExchangeConnector::
+shouldCloseConnection(int numRequests, Date connectionStart) const
+{
+    const ConnectionPolicy & policy = connectionPolicy;
+
+    if (policy.maxRequests > 0 && numRequests >= policy.maxRequests)
+        return true;
+    if (policy.maxAgeSeconds > 0.0
+        && Date::now().secondsSince(connectionStart) >= policy.maxAgeSeconds)
+        return true;
+    if (policy.maxConnections > 0 && numConnections() > policy.maxConnections)
+        return true;
+
+    return policy.closeProbability > 0.0
+        && random() % 1000000 < 1000000 * policy.closeProbability;
+}
+
+std::atomic<uint64_t> HttpExchangeConnector::nextIngestId(0);
+
+void
+HttpExchangeConnector::
+onIngestThread()
+{
+    // A thread can serve several connectors, so it remembers which ones it
+    // was seen by.  Ids rather than addresses, which can be reused.
+    static thread_local std::vector<uint64_t> seen;
+    if (std::find(seen.begin(), seen.end(), ingestId) != seen.end())
+        return;
+    seen.push_back(ingestId);
+
+    unsigned index = nextIngestCpu.fetch_add(1);
+    if (index >= ingestCpus.size()) return;
+
+    int cpu = ingestCpus[index];
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int res = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (res != 0)
+        cerr << "couldn't pin " << exchangeName() << " ingest thread to cpu "
+             << cpu << ": " << strerror(res) << endl;
+}
+
 Json::Value
 HttpExchangeConnector::
 getServiceStatus() const
@@ -14,6 +14,7 @@
 #include "soa/service/stats_events.h"
 #include "rtbkit/common/auction.h"
 #include <limits>
+#include <atomic>
 #include "rtbkit/common/exchange_connector.h"
 #include <boost/algorithm/string.hpp>
 
@@ -70,6 +71,41 @@ struct HttpExchangeConnector
                        int realTimePriority = -1,
                        bool realTimePolling = false);
 
+    /** Pin the endpoint threads to the given CPUs, one per thread in the
+        order in which they first serve a connection.  Threads past the end
+        of the list aren't pinned.  Must be called before start().
+    */
+    void pinIngestThreads(const std::vector<int> & cpus)
+    {
+        ingestCpus = cpus;
+    }
+
+    /** When to close a persistent connection from an exchange after a
+        response has been sent.  A limit of zero or less is disabled.
+    */
+    struct ConnectionPolicy {
+        ConnectionPolicy()
+            : maxRequests(0), maxAgeSeconds(0.0), maxConnections(0),
+              closeProbability(0.001)
+        {
+        }
+
+        int maxRequests;            ///< Close after that many responses
+        double maxAgeSeconds;       ///< Close once the connection is older
+        int maxConnections;         ///< Close while we have more than that
+        double closeProbability;    ///< Close at random with this probability
+    };
+
+    void setConnectionPolicy(const ConnectionPolicy & policy)
+    {
+        connectionPolicy = policy;
+    }
+
+    /** Should a connection which has served the given number of requests
+        since it was accepted be closed now?
+    */
+    bool shouldCloseConnection(int numRequests, Date connectionStart) const;
+
     /** Start the exchange connector running */
     virtual void start();
 
@@ -268,6 +304,8 @@ protected:
     int backlog;
     std::string auctionResource;
     std::string auctionVerb;
+    std::vector<int> ingestCpus;
+    ConnectionPolicy connectionPolicy;
 
     /// The ping time to known hosts in milliseconds
     std::unordered_map<std::string, float> pingTimesByHostMs;
@@ -284,6 +322,14 @@ private:
     std::set<std::shared_ptr<HttpAuctionHandler> > handlers;
     void finishedWithHandler(std::shared_ptr<HttpAuctionHandler> handler);
 
+    /** Called by the handlers on the endpoint thread serving a request; pins
+        that thread the first time this connector sees it.
+    */
+    void onIngestThread();
+    std::atomic<unsigned> nextIngestCpu;
+    uint64_t ingestId;          ///< Identifies the connector to its threads
+    static std::atomic<uint64_t> nextIngestId;
+
     /** Common code from all constructors. */
     void postConstructorInit();
 };
@@ -35,6 +35,7 @@ MoPubExchangeConnector(ServiceBase & owner, const std::string & name)
     : OpenRTBExchangeConnector(owner, name) {
     this->auctionResource = "/auctions";
     this->auctionVerb = "POST";
+    initMetrics();
 }
 
 MoPubExchangeConnector::
@@ -43,6 +44,15 @@ MoPubExchangeConnector(const std::string & name,
     : OpenRTBExchangeConnector(name, proxies) {
     this->auctionResource = "/auctions";
     this->auctionVerb = "POST";
+    initMetrics();
+}
+
+void
+MoPubExchangeConnector::
+initMetrics() {
+    blockedCategory = metrics.counter("blockedCategory");
+    blockedType = metrics.counter("blockedType");
+    blockedAttr = metrics.counter("blockedAttr");
 }
 
 ExchangeConnector::ExchangeCompatibility
@@ -318,7 +328,7 @@ bidRequestCreativeFilter(const BidRequest & request,
     const auto& blocked_categories = request.restrictions.get("blockedCategories");
     for (const auto& cat: crinfo->cat)
         if (blocked_categories.contains(cat)) {
-            this->recordHit ("blockedCategory");
+            blockedCategory.hit();
             return false;
         }
 
@@ -327,13 +337,13 @@ bidRequestCreativeFilter(const BidRequest & request,
         const auto& blocked_types = spot.restrictions.get("blockedTypes");
         for (const auto& t: crinfo->type)
             if (blocked_types.contains(t)) {
-                this->recordHit ("blockedType");
+                blockedType.hit();
                 return false;
             }
         const auto& blocked_attr = spot.restrictions.get("blockedAttrs");
         for (const auto& a: crinfo->attr)
             if (blocked_attr.contains(a)) {
-                this->recordHit ("blockedAttr");
+                blockedAttr.hit();
                 return false;
             }
     }
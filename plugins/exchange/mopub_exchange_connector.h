@@ -94,6 +94,12 @@ struct MoPubExchangeConnector: public OpenRTBExchangeConnector {
     virtual void setSeatBid(Auction const & auction,
                             int spotNum,
                             OpenRTB::BidResponse & response) const;
+
+    void initMetrics();
+
+    MetricRegistry::Counter blockedCategory;
+    MetricRegistry::Counter blockedType;
+    MetricRegistry::Counter blockedAttr;
 };
 
 
@@ -77,6 +77,36 @@ namespace RTBKIT {
 BOOST_STATIC_ASSERT(hasFromJson<Datacratic::Id>::value == true);
 BOOST_STATIC_ASSERT(hasFromJson<int>::value == false);
 
+namespace {
+
+/** Output stream appending to a string, which keeps its capacity when it is
+    cleared; used to print responses without reallocating every time.
+*/
+struct ResponseBuffer : public std::streambuf {
+
+    ResponseBuffer()
+        : stream(this)
+    {
+    }
+
+    std::string str;
+    std::ostream stream;
+
+    virtual int overflow(int c)
+    {
+        if (c != EOF) str.push_back(c);
+        return c;
+    }
+
+    virtual std::streamsize xsputn(const char * s, std::streamsize n)
+    {
+        str.append(s, n);
+        return n;
+    }
+};
+
+} // file scope
+
 /*****************************************************************************/
 /* OPENRTB EXCHANGE CONNECTOR                                                */
 /*****************************************************************************/
@@ -175,11 +205,18 @@ getResponse(const HttpAuctionHandler & connection,
         return HttpResponse(204, "none", "");
 
     static Datacratic::DefaultDescription<OpenRTB::BidResponse> desc;
-    std::ostringstream stream;
-    StreamJsonPrintingContext context(stream);
+
+    // Kept per thread so that the buffer is reused from one response to
+    // the next.
+    static __thread ResponseBuffer * buffer = 0;
+    if (!buffer)
+        buffer = new ResponseBuffer();
+    buffer->str.clear();
+
+    StreamJsonPrintingContext context(buffer->stream);
     desc.printJsonTyped(&response, context);
 
-    return HttpResponse(200, "application/json", stream.str());
+    return HttpResponse(200, "application/json", buffer->str);
 }
 
 Json::Value
@@ -0,0 +1,64 @@
+/* creative_template_test.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Tests for the creative macro templates.
+*/
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+
+#include "rtbkit/plugins/exchange/creative_template.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace RTBKIT;
+
+
+BOOST_AUTO_TEST_CASE( test_creative_template_render )
+{
+    CreativeMacros macros;
+    macros.set("AUCTION_ID", "1234");
+    macros.set("click", "http://x.com/?a=b");
+
+    BOOST_CHECK_EQUAL(CreativeTemplate("").render(macros), "");
+    BOOST_CHECK_EQUAL(CreativeTemplate("no macros").render(macros),
+                      "no macros");
+    BOOST_CHECK_EQUAL(CreativeTemplate("${AUCTION_ID}").render(macros),
+                      "1234");
+    BOOST_CHECK_EQUAL(CreativeTemplate("<a href=\"${click}\">${AUCTION_ID}</a>")
+                      .render(macros),
+                      "<a href=\"http://x.com/?a=b\">1234</a>");
+
+    // Macros without a value disappear
+    BOOST_CHECK_EQUAL(CreativeTemplate("a${unknown}b").render(macros), "ab");
+
+    // Anything that isn't a well formed macro is kept as is
+    BOOST_CHECK_EQUAL(CreativeTemplate("${}${ AUCTION_ID}${AUCTION_ID")
+                      .render(macros),
+                      "${}${ AUCTION_ID}${AUCTION_ID");
+    BOOST_CHECK_EQUAL(CreativeTemplate("${${AUCTION_ID}}").render(macros),
+                      "${1234}");
+    BOOST_CHECK_EQUAL(CreativeTemplate("%%WINNING_PRICE%%$").render(macros),
+                      "%%WINNING_PRICE%%$");
+
+    // Setting a macro again replaces its value
+    macros.set("AUCTION_ID", "5678");
+    BOOST_CHECK_EQUAL(CreativeTemplate("${AUCTION_ID}").render(macros),
+                      "5678");
+
+    // Rendering appends
+    string out = "x";
+    CreativeTemplate("${AUCTION_ID}").render(out, macros);
+    BOOST_CHECK_EQUAL(out, "x5678");
+}
+
+BOOST_AUTO_TEST_CASE( test_creative_template_macros_used )
+{
+    CreativeTemplate t("${AUCTION_ID} ${price}");
+
+    BOOST_CHECK(t.usesMacrosOtherThan({}));
+    BOOST_CHECK(t.usesMacrosOtherThan({ "AUCTION_ID" }));
+    BOOST_CHECK(!t.usesMacrosOtherThan({ "AUCTION_ID", "price" }));
+    BOOST_CHECK(!CreativeTemplate("${}").usesMacrosOtherThan({}));
+}
@@ -186,3 +186,42 @@ BOOST_FIXTURE_TEST_CASE( test_merge, AugmentationFixture )
 
 }
 
+
+
+BOOST_FIXTURE_TEST_CASE( test_match, AugmentationFixture )
+{
+    AugmentationList list;
+    list[accBBA] = { {tag1}, data1 };
+    list[accBC];
+    list[accA] = { {tag1}, data1 };
+    list[AccountKey()] = { {tag0}, data0 };
+    list[accBB] = { {tag2}, data2 };
+
+    typedef vector<AccountKey> Keys;
+
+    auto match = [&] (const AccountKey& account) {
+        vector<unsigned> indexes;
+        list.matchAccount(account, indexes);
+
+        Keys accounts;
+        for (unsigned i : indexes)
+            accounts.push_back((list.begin() + i)->first);
+        return accounts;
+    };
+
+    BOOST_CHECK(match(AccountKey()) == Keys({ AccountKey() }));
+    BOOST_CHECK(match(accA) == Keys({ accA, AccountKey() }));
+    BOOST_CHECK(match(accBC) == Keys({ accBC, AccountKey() }));
+    BOOST_CHECK(match({ "B" }) == Keys({ AccountKey() }));
+    BOOST_CHECK(match({ "B", "B", "A", "Z" })
+            == Keys({ accBBA, accBB, AccountKey() }));
+
+    // Accounts with the same matches must get the same filtered view.
+    AccountKey accAZ({ "A", "Z" });
+    BOOST_CHECK(match(accAZ) == Keys({ accA, AccountKey() }));
+    check(list, accAZ, { tag0, tag1 }, { data0, data1 });
+
+    BOOST_CHECK(list.find({ "B" }) == list.end());
+    BOOST_CHECK(!list.insert(make_pair(accBB, Augmentation())).second);
+    BOOST_CHECK_EQUAL(list.size(), 5u);
+}
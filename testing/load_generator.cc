@@ -0,0 +1,679 @@
+/* load_generator.cc
+   Copyright (c) 2013 Datacratic.  All rights reserved.
+
+   Open loop HTTP load generator for exchange connectors.
+
+   Requests are sent on a fixed schedule at the target rate whether or not
+   the previous ones were answered, and their latency is measured from the
+   time they were due to be sent rather than from the time they were sent.
+   A server that falls behind therefore shows up in the latency histogram
+   instead of silently slowing the generator down (coordinated omission).
+
+   Each thread owns a share of the rate and a set of keep-alive connections
+   which it drives with epoll.  A request that finds all of its thread's
+   connections busy waits for one to free up, and is counted as timed out if
+   it waits longer than the timeout.
+*/
+
+#include "rtbkit/core/router/latency_histogram.h"
+#include "rtbkit/common/testing/bid_request_synth.h"
+#include "soa/jsoncpp/value.h"
+#include "jml/arch/exception.h"
+#include "jml/utils/filter_streams.h"
+
+#include <boost/program_options/cmdline.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/positional_options.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <strings.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace RTBKIT;
+
+typedef std::chrono::steady_clock Clock;
+
+
+/*****************************************************************************/
+/* PAYLOADS                                                                  */
+/*****************************************************************************/
+
+/** Body of a request and the headers that go with it. */
+struct Payload {
+    std::string headers;    ///< "Name: value\r\n" lines
+    std::string body;
+};
+
+bool endsWith(const std::string & str, const std::string & suffix)
+{
+    return str.size() >= suffix.size()
+        && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/** Loads recorded requests:
+
+    - .json files hold a single JSON request;
+    - other files hold one JSON request per line, or whole HTTP requests
+      (rubicon-samples.txt.gz).  Those are replayed with their own headers
+      and may have binary bodies, which is how AdX traffic is replayed.
+*/
+void loadCorpus(const std::string & filename,
+                const std::string & headers,
+                std::vector<Payload> & payloads)
+{
+    ML::filter_istream stream(filename);
+    if (!stream)
+        throw ML::Exception("couldn't open corpus " + filename);
+
+    if (endsWith(filename, ".json")) {
+        std::string body, line;
+        while (getline(stream, line))
+            body += line + "\n";
+        payloads.push_back({ headers, body });
+        return;
+    }
+
+    std::string line;
+    while (getline(stream, line)) {
+        if (line.empty()) continue;
+
+        if (line[0] == '{') {
+            payloads.push_back({ headers, line });
+            continue;
+        }
+
+        if (line.compare(0, 5, "POST ") != 0) continue;
+
+        // Keep the captured headers except those describing the connection
+        Payload payload;
+        size_t contentLength = 0;
+        while (getline(stream, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.resize(line.size() - 1);
+            if (line.empty()) break;
+
+            if (strncasecmp(line.c_str(), "content-length:", 15) == 0)
+                contentLength = strtoul(line.c_str() + 15, nullptr, 10);
+            else if (strncasecmp(line.c_str(), "host:", 5) != 0
+                     && strncasecmp(line.c_str(), "connection:", 11) != 0)
+                payload.headers += line + "\r\n";
+        }
+
+        payload.body.resize(contentLength);
+        stream.read(&payload.body[0], contentLength);
+        if (size_t(stream.gcount()) != contentLength)
+            throw ML::Exception("truncated request in " + filename);
+        payloads.push_back(std::move(payload));
+    }
+}
+
+/** Generates requests from a model recorded by BidRequestSynth. */
+void synthesize(const std::string & model, unsigned count,
+                const std::string & headers,
+                std::vector<Payload> & payloads)
+{
+    std::ifstream stream(model.c_str());
+    if (!stream)
+        throw ML::Exception("couldn't open bid request model " + model);
+
+    BidRequestSynth synth;
+    synth.load(stream);
+
+    for (unsigned i = 0;  i < count;  ++i)
+        payloads.push_back({ headers, synth.generate(i).toString() });
+}
+
+
+/*****************************************************************************/
+/* STATS                                                                     */
+/*****************************************************************************/
+
+/** Counters of a thread; read by the main thread to report progress. */
+struct Stats {
+    Stats()
+        : sent(0), responses(0), bids(0), noBids(0), errors(0), timeouts(0),
+          unsent(0), connects(0)
+    {
+    }
+
+    std::atomic<uint64_t> sent;
+    std::atomic<uint64_t> responses;
+    std::atomic<uint64_t> bids;         ///< 200 responses
+    std::atomic<uint64_t> noBids;       ///< 204 responses
+    std::atomic<uint64_t> errors;       ///< other statuses and broken sockets
+    std::atomic<uint64_t> timeouts;     ///< sent but not answered in time
+    std::atomic<uint64_t> unsent;       ///< no connection before the timeout
+    std::atomic<uint64_t> connects;
+} __attribute__((__aligned__(64)));
+
+
+/*****************************************************************************/
+/* WORKER                                                                    */
+/*****************************************************************************/
+
+struct Worker {
+
+    Worker(const sockaddr_in & address,
+           const std::vector<std::string> & requests,
+           unsigned numConnections,
+           double interval, Clock::time_point start, Clock::time_point end,
+           double timeout, unsigned offset,
+           LatencyHistogram & latency, Stats & stats)
+        : address(address), requests(requests),
+          interval(interval), start(start), end(end), timeout(timeout),
+          nextRequest(offset), latency(latency), stats(stats),
+          connections(numConnections)
+    {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd == -1)
+            throw ML::Exception(errno, "epoll_create1");
+    }
+
+    ~Worker()
+    {
+        for (auto & connection: connections)
+            if (connection.fd != -1) ::close(connection.fd);
+        ::close(epollFd);
+    }
+
+    void run()
+    {
+        for (auto & connection: connections)
+            connect(connection);
+
+        uint64_t numScheduled = 0;
+        epoll_event events[64];
+
+        for (;;) {
+            Clock::time_point now = Clock::now();
+
+            // Everything that was due by now joins the queue
+            Clock::time_point due;
+            while ((due = scheduled(numScheduled)) <= now && due < end) {
+                waiting.push_back(due);
+                ++numScheduled;
+            }
+
+            expire(now);
+            dispatch();
+
+            bool busy = !waiting.empty();
+            for (auto & connection: connections)
+                busy = busy || connection.state == Connection::BUSY;
+            if (due >= end && !busy)
+                break;
+
+            // Wake up at least every millisecond to notice timeouts; spin
+            // when the next request is due sooner than that.
+            int waitMs = 1;
+            if (due < end && due - now < std::chrono::milliseconds(1))
+                waitMs = 0;
+
+            int n = epoll_wait(epollFd, events, 64, waitMs);
+            if (n == -1 && errno != EINTR)
+                throw ML::Exception(errno, "epoll_wait");
+
+            for (int i = 0;  i < n;  ++i) {
+                Connection & connection
+                    = connections[events[i].data.u32];
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    fail(connection);
+                else {
+                    if (events[i].events & EPOLLOUT)
+                        onWritable(connection);
+                    if (events[i].events & EPOLLIN)
+                        onReadable(connection);
+                }
+            }
+        }
+    }
+
+private:
+    struct Connection {
+        Connection()
+            : fd(-1), state(CLOSED), request(nullptr), written(0)
+        {
+        }
+
+        enum State {
+            CLOSED,
+            CONNECTING,
+            IDLE,
+            BUSY
+        };
+
+        int fd;
+        State state;
+        const std::string * request;
+        size_t written;
+        std::string response;
+        Clock::time_point due;      ///< When the current request was due
+    };
+
+    Clock::time_point scheduled(uint64_t n) const
+    {
+        auto offset = std::chrono::duration<double>(interval * n);
+        return start + std::chrono::duration_cast<Clock::duration>(offset);
+    }
+
+    double secondsSince(Clock::time_point from, Clock::time_point to) const
+    {
+        return std::chrono::duration<double>(to - from).count();
+    }
+
+    void connect(Connection & connection)
+    {
+        connection.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (connection.fd == -1)
+            throw ML::Exception(errno, "socket");
+
+        int flag = 1;
+        setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY,
+                   &flag, sizeof(flag));
+
+        int res = ::connect(connection.fd, (const sockaddr *)&address,
+                            sizeof(address));
+        if (res == -1 && errno != EINPROGRESS)
+            throw ML::Exception(errno, "connect");
+
+        connection.state = Connection::CONNECTING;
+        ++stats.connects;
+
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT;
+        event.data.u32 = &connection - &connections[0];
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, connection.fd, &event) == -1)
+            throw ML::Exception(errno, "epoll_ctl");
+    }
+
+    void reconnect(Connection & connection)
+    {
+        ::close(connection.fd);
+        connection.fd = -1;
+        connection.state = Connection::CLOSED;
+        connection.response.clear();
+        connect(connection);
+    }
+
+    void watchWrites(Connection & connection, bool watch)
+    {
+        epoll_event event;
+        event.events = EPOLLIN | (watch ? EPOLLOUT : 0);
+        event.data.u32 = &connection - &connections[0];
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+
+    /** Count the requests that have waited too long as timed out. */
+    void expire(Clock::time_point now)
+    {
+        while (!waiting.empty()
+               && secondsSince(waiting.front(), now) > timeout) {
+            waiting.pop_front();
+            ++stats.unsent;
+        }
+
+        for (auto & connection: connections) {
+            if (connection.state != Connection::BUSY) continue;
+            if (secondsSince(connection.due, now) <= timeout) continue;
+
+            // The response could still come; the connection can't be
+            // reused until it does, so it's replaced.
+            ++stats.timeouts;
+            reconnect(connection);
+        }
+    }
+
+    void dispatch()
+    {
+        for (auto & connection: connections) {
+            if (waiting.empty()) return;
+            if (connection.state != Connection::IDLE) continue;
+
+            connection.state = Connection::BUSY;
+            connection.due = waiting.front();
+            connection.request = &requests[nextRequest++ % requests.size()];
+            connection.written = 0;
+            waiting.pop_front();
+
+            ++stats.sent;
+            onWritable(connection);
+        }
+    }
+
+    void onWritable(Connection & connection)
+    {
+        if (connection.state == Connection::CONNECTING) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &len);
+            if (error)
+                throw ML::Exception(error, "connect");
+
+            connection.state = Connection::IDLE;
+            watchWrites(connection, false);
+            return;
+        }
+
+        if (connection.state != Connection::BUSY) return;
+
+        const std::string & request = *connection.request;
+        while (connection.written < request.size()) {
+            ssize_t res = ::send(connection.fd,
+                                 request.data() + connection.written,
+                                 request.size() - connection.written,
+                                 MSG_NOSIGNAL);
+            if (res == -1) {
+                if (errno == EAGAIN) {
+                    watchWrites(connection, true);
+                    return;
+                }
+                fail(connection);
+                return;
+            }
+            connection.written += res;
+        }
+
+        watchWrites(connection, false);
+    }
+
+    void onReadable(Connection & connection)
+    {
+        char buffer[16384];
+        for (;;) {
+            ssize_t res = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (res == 0) {
+                fail(connection);
+                return;
+            }
+            if (res == -1) {
+                if (errno == EAGAIN) break;
+                fail(connection);
+                return;
+            }
+            connection.response.append(buffer, res);
+        }
+
+        if (connection.state != Connection::BUSY) {
+            // Nothing was asked; whatever this is, the connection is unusable
+            fail(connection);
+            return;
+        }
+
+        parseResponse(connection);
+    }
+
+    /** Record the response once it has been fully received. */
+    void parseResponse(Connection & connection)
+    {
+        const std::string & response = connection.response;
+
+        size_t headerEnd = response.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) return;
+
+        int status = 0;
+        if (response.compare(0, 5, "HTTP/") == 0) {
+            size_t pos = response.find(' ');
+            if (pos != std::string::npos)
+                status = atoi(response.c_str() + pos + 1);
+        }
+
+        size_t contentLength = 0;
+        bool close = false;
+        size_t pos = response.find("\r\n") + 2;
+        while (pos < headerEnd) {
+            size_t eol = response.find("\r\n", pos);
+            const char * line = response.c_str() + pos;
+            if (strncasecmp(line, "content-length:", 15) == 0)
+                contentLength = strtoul(line + 15, nullptr, 10);
+            else if (strncasecmp(line, "connection: close", 17) == 0)
+                close = true;
+            pos = eol + 2;
+        }
+
+        if (response.size() < headerEnd + 4 + contentLength) return;
+
+        Clock::time_point now = Clock::now();
+        latency.record(secondsSince(connection.due, now));
+        ++stats.responses;
+
+        if (status == 200) ++stats.bids;
+        else if (status == 204) ++stats.noBids;
+        else ++stats.errors;
+
+        connection.response.clear();
+        connection.state = Connection::IDLE;
+
+        if (close) reconnect(connection);
+    }
+
+    void fail(Connection & connection)
+    {
+        if (connection.state == Connection::BUSY)
+            ++stats.errors;
+        reconnect(connection);
+    }
+
+    sockaddr_in address;
+    const std::vector<std::string> & requests;
+    double interval;
+    Clock::time_point start;
+    Clock::time_point end;
+    double timeout;
+    uint64_t nextRequest;
+    LatencyHistogram & latency;
+    Stats & stats;
+
+    int epollFd;
+    std::vector<Connection> connections;
+    std::deque<Clock::time_point> waiting;
+};
+
+
+/*****************************************************************************/
+/* MAIN                                                                      */
+/*****************************************************************************/
+
+int main(int argc, char ** argv)
+{
+    using namespace boost::program_options;
+
+    std::string host = "127.0.0.1";
+    int port = 0;
+    std::string path = "/auctions";
+    std::vector<std::string> corpora;
+    std::string synthModel;
+    unsigned synthCount = 10000;
+    std::string contentType = "application/json";
+    std::vector<std::string> extraHeaders;
+    double rate = 1000.0;
+    double duration = 10.0;
+    unsigned numThreads = 1;
+    unsigned numConnections = 16;
+    double timeoutMs = 100.0;
+    std::string output;
+
+    options_description options("Options");
+    options.add_options()
+        ("host", value(&host), "host of the exchange connector")
+        ("port,p", value(&port), "port of the exchange connector")
+        ("path", value(&path), "path the requests are posted to")
+        ("corpus,c", value(&corpora),
+         "recorded requests to send; may be repeated")
+        ("synth-model", value(&synthModel),
+         "BidRequestSynth model to generate requests from")
+        ("synth-count", value(&synthCount),
+         "number of distinct requests to generate from the model")
+        ("content-type", value(&contentType),
+         "content type of requests that weren't captured with their headers")
+        ("header", value(&extraHeaders),
+         "extra header for those requests, eg x-openrtb-version: 2.1")
+        ("rate,r", value(&rate), "requests per second")
+        ("duration,d", value(&duration), "seconds to run for")
+        ("threads,t", value(&numThreads), "number of sending threads")
+        ("connections,n", value(&numConnections),
+         "keep-alive connections per thread")
+        ("timeout-ms", value(&timeoutMs),
+         "time after which a request is counted as timed out")
+        ("output,o", value(&output),
+         "file to write the results to instead of stdout")
+        ("help,h", "print this message");
+
+    variables_map vm;
+    store(command_line_parser(argc, argv).options(options).run(), vm);
+    notify(vm);
+
+    if (vm.count("help")) {
+        cerr << options << endl;
+        return 1;
+    }
+
+    if (port == 0) {
+        cerr << "'port' parameter is required" << endl;
+        return 1;
+    }
+
+    std::string headers = "Content-Type: " + contentType + "\r\n";
+    for (auto & header: extraHeaders)
+        headers += header + "\r\n";
+
+    std::vector<Payload> payloads;
+    for (auto & corpus: corpora)
+        loadCorpus(corpus, headers, payloads);
+    if (!synthModel.empty())
+        synthesize(synthModel, synthCount, headers, payloads);
+    if (payloads.empty()) {
+        cerr << "either 'corpus' or 'synth-model' is required" << endl;
+        return 1;
+    }
+
+    // Requests are rendered once; sending one is then just a write.
+    std::vector<std::string> requests;
+    for (auto & payload: payloads) {
+        requests.push_back(
+                "POST " + path + " HTTP/1.1\r\n"
+                + "Host: " + host + ":" + to_string(port) + "\r\n"
+                + payload.headers
+                + "Content-Length: " + to_string(payload.body.size()) + "\r\n"
+                + "\r\n"
+                + payload.body);
+    }
+
+    addrinfo hints, * info;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    int res = getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &info);
+    if (res != 0)
+        throw ML::Exception("couldn't resolve %s: %s",
+                            host.c_str(), gai_strerror(res));
+    sockaddr_in address = *(sockaddr_in *)info->ai_addr;
+    freeaddrinfo(info);
+
+    LatencyHistogram latency;
+    std::vector<Stats> stats(numThreads);
+
+    // Threads share the schedule: thread i sends requests i, i + n, ...
+    double interval = numThreads / rate;
+    Clock::time_point start = Clock::now() + std::chrono::milliseconds(100);
+    Clock::time_point end = start
+        + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(duration));
+
+    std::vector<std::unique_ptr<Worker> > workers;
+    std::vector<std::thread> threads;
+    for (unsigned i = 0;  i < numThreads;  ++i) {
+        Clock::time_point threadStart = start
+            + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(i / rate));
+        workers.emplace_back(new Worker(address, requests, numConnections,
+                                        interval, threadStart, end,
+                                        timeoutMs / 1000.0,
+                                        i * requests.size() / numThreads,
+                                        latency, stats[i]));
+    }
+
+    for (auto & worker: workers)
+        threads.emplace_back([&worker] () { worker->run(); });
+
+    auto total = [&] (std::atomic<uint64_t> Stats::* field)
+        {
+            uint64_t result = 0;
+            for (auto & s: stats)
+                result += (s.*field).load(std::memory_order_relaxed);
+            return result;
+        };
+
+    // Progress, once a second, until the schedule is over
+    uint64_t lastResponses = 0;
+    while (Clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t responses = total(&Stats::responses);
+        cerr << "responses/s: " << responses - lastResponses
+             << "  timeouts: " << total(&Stats::timeouts)
+             << "  unsent: " << total(&Stats::unsent)
+             << "  errors: " << total(&Stats::errors) << endl;
+        lastResponses = responses;
+    }
+
+    for (auto & thread: threads)
+        thread.join();
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t scheduled = total(&Stats::sent) + total(&Stats::unsent);
+    uint64_t responses = total(&Stats::responses);
+
+    Json::Value result;
+    result["targetRate"] = rate;
+    result["duration"] = duration;
+    result["threads"] = numThreads;
+    result["connectionsPerThread"] = numConnections;
+    result["timeoutMs"] = timeoutMs;
+    result["scheduled"] = (Json::Value::UInt)scheduled;
+    result["sent"] = (Json::Value::UInt)total(&Stats::sent);
+    result["responses"] = (Json::Value::UInt)responses;
+    result["responseRate"] = responses / elapsed;
+    result["bids"] = (Json::Value::UInt)total(&Stats::bids);
+    result["noBids"] = (Json::Value::UInt)total(&Stats::noBids);
+    result["errors"] = (Json::Value::UInt)total(&Stats::errors);
+    result["timeouts"] = (Json::Value::UInt)total(&Stats::timeouts);
+    result["unsent"] = (Json::Value::UInt)total(&Stats::unsent);
+    result["connects"] = (Json::Value::UInt)total(&Stats::connects);
+    if (responses)
+        result["noBidRate"] = double(total(&Stats::noBids)) / responses;
+    if (scheduled)
+        result["timeoutRate"]
+            = double(total(&Stats::timeouts) + total(&Stats::unsent))
+            / scheduled;
+    result["latency"] = latency.snapshot().toJson();
+
+    if (output.empty())
+        cout << result.toStyledString();
+    else {
+        std::ofstream stream(output.c_str());
+        stream << result.toStyledString();
+        if (!stream)
+            throw ML::Exception("couldn't write results to " + output);
+    }
+
+    return 0;
+}
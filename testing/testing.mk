@@ -20,3 +20,4 @@ $(eval $(call test,win_cost_model_test,openrtb_exchange bidding_agent integratio
 $(eval $(call program,mock_exchange_runner,integration_test_utils boost_program_options utils))
 $(eval $(call program,json_feeder,curlpp boost_program_options utils))
 $(eval $(call program,json_listener,boost_program_options services utils))
+$(eval $(call program,load_generator,rtb_router bid_request_synth boost_program_options utils))
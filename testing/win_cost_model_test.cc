@@ -87,3 +87,23 @@ BOOST_AUTO_TEST_CASE( win_cost_model_test )
     BOOST_CHECK_EQUAL(events["router.cummulatedAuthorizedPrice"], count * 505);
 }
 
+
+BOOST_AUTO_TEST_CASE( win_cost_model_rename_test )
+{
+    WinCostModel::registerModel("test-rename", linearWinCostModel);
+
+    Json::Value data;
+    data["m"] = 0.5;
+    data["b"] = MicroUSD(5.0).toJson();
+
+    WinCostModel model("test-rename", data);
+    Bid bid;
+    BOOST_CHECK_EQUAL(model.evaluate(bid, MicroUSD(1000.0)), MicroUSD(505.0));
+
+    // Assigning the name after construction must switch to the new model
+    model.name = "none";
+    BOOST_CHECK_EQUAL(model.evaluate(bid, MicroUSD(1000.0)), MicroUSD(1000.0));
+
+    model.name = "unknown";
+    BOOST_CHECK_THROW(model.evaluate(bid, MicroUSD(1000.0)), std::exception);
+}